@@ -264,20 +264,13 @@ void move_enemy(enemy_t* en, vec2 amount) {
 }
 
 void particle_spawn(r_particles* system, r_particle* particle) {
-  float x = fmod(rand(), system->size[0]);
-  float y = fmod(rand(), system->size[1]);
-
-  particle->position[0] = x;
-  particle->position[1] = y;
+  // The system's own generator replays the same effect from the same seed
+  particle->position[0] = s_rand_range(&system->rng, 0.f, system->size[0]);
+  particle->position[1] = s_rand_range(&system->rng, 0.f, system->size[1]);
   particle->layer       = system->particle_layer;
 
-  int dir_x = 0, dir_y = 0;
-
-  dir_x = rnd_range(-2, 2);
-  dir_y = rnd_range(-2, 0);
-
-  particle->direction[0] = dir_x;
-  particle->direction[1] = dir_y;
+  particle->direction[0] = s_rand_range(&system->rng, -2.f, 2.f);
+  particle->direction[1] = s_rand_range(&system->rng, -2.f, 0.f);
 }
 
 void particle_animate(r_particles* system, r_particle* particle) {
@@ -298,6 +291,8 @@ void create_emitter(vec2 position, vec2 dir) {
     if (r_particles_finished(emitter)) {
       r_particles_reset(emitter);
       r_particles_set_position(emitter, position);
+      // A new seed for each burst, otherwise the slot replays the last one
+      r_particles_set_seed(emitter, (uint64_t)rand());
       r_particles_start(emitter);
       break;
     }
@@ -2401,12 +2396,15 @@ void draw_game(time_s delta) {
     }
   }
 
+  // update all of the particle effects at once, finished ones are skipped
+  if (game_state == GAME_PLAY || game_state == GAME_LOSE)
+    r_particles_update_many(render_ctx, level.emitters, MAX_PARTICLE_EMITTERS,
+                            delta);
+
   // draw particle effects
   for (int i = 0; i < MAX_PARTICLE_EMITTERS; ++i) {
     r_particles* emitter = &level.emitters[i];
     if (!r_particles_finished(emitter)) {
-      if (game_state == GAME_PLAY || game_state == GAME_LOSE)
-        r_particles_update(emitter, delta);
       r_particles_draw(render_ctx, emitter, particle_shader);
     }
   }
@@ -0,0 +1,41 @@
+#version 330
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec2 in_texc;
+
+// Per sprite attributes (r_instance)
+layout(location = 2) in mat4 in_model;
+layout(location = 6) in vec4 in_coords;
+layout(location = 7) in vec4 in_color;
+layout(location = 8) in vec2 in_flip;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+out vec2 pass_texcoord;
+out vec4 pass_color;
+
+void main() {
+  vec2 mod_coord = in_texc;
+
+  if (in_flip.x > 0.5) {
+    mod_coord.x = 1.0 - mod_coord.x;
+  }
+
+  if (in_flip.y > 0.5) {
+    mod_coord.y = 1.0 - mod_coord.y;
+  }
+
+  vec2 tex_size = vec2(in_coords.w - in_coords.y, in_coords.z - in_coords.x);
+
+  vec2 offset = in_coords.xy;
+
+  // sprite ordering based on how far down on the screen it is
+  vec4 mod_pos = vec4(in_pos, 1.0f);
+  mod_pos.z += (180.f - mod_pos.y) * 0.01f;
+
+  pass_texcoord = offset + (tex_size *  mod_coord);
+  pass_color = in_color;
+
+  gl_Position = projection * view * in_model * mod_pos;
+}
@@ -0,0 +1,53 @@
+#version 330
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec2 in_texc;
+
+// Per sprite attributes (r_instance_packed)
+layout(location = 2) in vec4 in_rect;
+layout(location = 3) in vec4 in_coords;
+layout(location = 4) in vec4 in_color;
+layout(location = 5) in uint in_rotation;
+layout(location = 6) in uvec2 in_misc;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform float layer_mod;
+
+out vec2 pass_texcoord;
+out vec4 pass_color;
+
+void main() {
+  vec2 mod_coord = in_texc;
+
+  if ((in_misc.y & 1u) != 0u) {
+    mod_coord.x = 1.0 - mod_coord.x;
+  }
+
+  if ((in_misc.y & 2u) != 0u) {
+    mod_coord.y = 1.0 - mod_coord.y;
+  }
+
+  vec2 tex_size = vec2(in_coords.w - in_coords.y, in_coords.z - in_coords.x);
+
+  vec2 offset = in_coords.xy;
+
+  // sprite ordering based on how far down on the screen it is
+  vec4 mod_pos = vec4(in_pos, 1.0f);
+  mod_pos.z += (180.f - mod_pos.y) * 0.01f;
+
+  float angle = float(in_rotation) * (6.28318530718 / 65536.0);
+  float c = cos(angle);
+  float s = sin(angle);
+
+  vec2 scaled = mod_pos.xy * in_rect.zw;
+  vec2 world = vec2(scaled.x * c - scaled.y * s, scaled.x * s + scaled.y * c);
+
+  mod_pos.xy = world + in_rect.xy;
+  mod_pos.z += float(in_misc.x) * layer_mod;
+
+  pass_texcoord = offset + (tex_size *  mod_coord);
+  pass_color = in_color;
+
+  gl_Position = projection * view * mod_pos;
+}
@@ -0,0 +1,58 @@
+#version 330
+
+// The state of each particle, written back out with transform feedback
+layout(location = 2) in vec4 in_motion;
+layout(location = 3) in float in_life;
+
+uniform float delta;
+uniform float life;
+uniform vec2 area;
+uniform vec2 velocity;
+
+// The particles from spawn_first (wrapping at capacity) to spawn over
+uniform int spawn_first;
+uniform int spawn_count;
+uniform int capacity;
+
+// emitted - the particles spawned before this update, with the seed each
+// spawn gets its own random numbers
+uniform int emitted;
+uniform int seed;
+
+out vec4 out_motion;
+out float out_life;
+
+uint hash(uint x) {
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+// [0, 1)
+float random(uint x) {
+  return float(hash(x) >> 8) * (1.0 / 16777216.0);
+}
+
+void main() {
+  out_motion = in_motion;
+  out_life = in_life;
+
+  int offset = gl_VertexID - spawn_first;
+  if (offset < 0) {
+    offset += capacity;
+  }
+
+  if (offset < spawn_count) {
+    uint key = hash(uint(seed) ^ hash(uint(emitted) + uint(offset)));
+
+    out_motion = vec4(random(key) * area.x, random(key + 1u) * area.y,
+                      velocity);
+    out_life = life;
+  }
+
+  out_life -= delta;
+  out_motion.xy += out_motion.zw * delta;
+}
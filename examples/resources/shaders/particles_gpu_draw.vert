@@ -0,0 +1,83 @@
+#version 330
+#define MAX_FRAMES 32
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec2 in_texc;
+
+// The state of each particle (per instance)
+layout(location = 2) in vec4 in_motion;
+layout(location = 3) in float in_life;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+uniform vec2 origin;
+uniform vec2 size;
+uniform float depth;
+uniform float life;
+uniform vec4 color;
+
+// 0 = colored only, 1 = textured
+uniform int use_tex = 0;
+
+// frame_rate - the length of each frame, 0 if each frame ends at frame_ends
+uniform vec4 frame_coords[MAX_FRAMES];
+uniform float frame_ends[MAX_FRAMES];
+uniform int frame_count = 1;
+uniform float frame_rate = 0;
+uniform int frame_loop = 0;
+
+out vec2 pass_texcoord;
+out vec4 pass_color;
+flat out int pass_usetex;
+
+int frame_at(float time) {
+  if (frame_count <= 1) {
+    return 0;
+  }
+
+  if (frame_rate > 0) {
+    return int(time / frame_rate) % frame_count;
+  }
+
+  float total = frame_ends[frame_count - 1];
+  if (frame_loop == 1 && time > total) {
+    time = mod(time, total);
+  }
+
+  for (int i = 0; i < frame_count; ++i) {
+    if (time <= frame_ends[i]) {
+      return i;
+    }
+  }
+
+  return frame_count - 1;
+}
+
+void main() {
+  pass_usetex = use_tex;
+  pass_color = color;
+  pass_texcoord = vec2(0);
+
+  // Dead particles are left outside of the clip space
+  if (in_life <= 0) {
+    gl_Position = vec4(2, 2, 2, 1);
+    return;
+  }
+
+  if (use_tex == 1) {
+    vec4 raw_coord = frame_coords[frame_at(max(life - in_life, 0))];
+
+    vec2 tex_size = vec2(raw_coord.w - raw_coord.y, raw_coord.z - raw_coord.x);
+    vec2 offset = raw_coord.xy;
+    pass_texcoord = offset + (tex_size * in_texc);
+  }
+
+  vec4 mod_pos = vec4(in_pos, 1.0f);
+  mod_pos.z += (180.f - mod_pos.y) * 0.01f;
+
+  vec3 world = vec3(origin + in_motion.xy + mod_pos.xy * size,
+                    depth + mod_pos.z);
+
+  gl_Position = projection * view * vec4(world, 1.0);
+}
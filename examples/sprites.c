@@ -24,8 +24,11 @@ Tab - Toggle text capture
 #define BAKED_SHEET_SIZE  2048
 #define BAKED_SHEET_WIDTH 64
 
-#define BATCH_SIZE  32
+// Shaders with instanced attributes aren't limited by uniform array sizes
+#define BATCH_SIZE  1024
 #define USE_BATCHES 1
+// Stream 32 bytes per sprite (batch_packed.vert) instead of a full matrix
+#define USE_PACKED 1
 
 r_shader      shader, baked, particle, fbo_shader, ui_shader;
 r_shader      single;
@@ -59,27 +62,14 @@ r_shader load_shader(const char* vs, const char* fs) {
 
 enum { LEFT = 1 << 1, RIGHT = 1 << 2, UP = 1 << 3, DOWN = 1 << 4 } dir;
 
-static int rnd(int min, int max) {
-  int range = max - min;
-  int value = rand() % range;
-  return min + value;
-}
-
 void particle_spawn(r_particles* system, r_particle* particle) {
-  float x = fmod(rand(), system->size[0]);
-  float y = fmod(rand(), system->size[1]);
-
-  particle->position[0] = x;
-  particle->position[1] = y;
+  // The system's own generator replays the same effect from the same seed
+  particle->position[0] = s_rand_range(&system->rng, 0.f, system->size[0]);
+  particle->position[1] = s_rand_range(&system->rng, 0.f, system->size[1]);
   particle->layer       = 10;
 
-  int dir_x = 0, dir_y = 0;
-
-  dir_x = rnd(-2, 2);
-  dir_y = rnd(-2, 2);
-
-  particle->direction[0] = dir_x;
-  particle->direction[1] = dir_y;
+  particle->direction[0] = s_rand_range(&system->rng, -2.f, 2.f);
+  particle->direction[1] = s_rand_range(&system->rng, -2.f, 2.f);
 }
 
 void particle_animate(r_particles* system, r_particle* particle) {
@@ -95,8 +85,13 @@ void particle_animate(r_particles* system, r_particle* particle) {
 }
 
 void init_render(r_ctx* ctx) {
-  shader = load_shader("resources/shaders/instanced.vert",
+#if USE_PACKED
+  shader = load_shader("resources/shaders/batch_packed.vert",
+                       "resources/shaders/instanced.frag");
+#else
+  shader = load_shader("resources/shaders/batch.vert",
                        "resources/shaders/instanced.frag");
+#endif
   r_shader_cache(ctx, shader, "main");
 
   single = load_shader("resources/shaders/single.vert",
@@ -295,7 +290,7 @@ int main(void) {
   r_window_params params =
       r_window_params_create(1280, 720, 0, 0, 1, 0, 60, "Sprites Example");
 
-  render_ctx = r_ctx_create(params, 3, 32, 128, 4);
+  render_ctx = r_ctx_create(params, 3, BATCH_SIZE, 128, 4);
   r_window_clear_color("#0A0A0A");
 
   if (!render_ctx) {
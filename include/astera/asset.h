@@ -28,13 +28,33 @@ typedef struct {
 
   int32_t chunk_start, chunk_length;
 
+  /* refs - the number of users holding the asset, only refs = 0 is evicted
+   * referenced - if the asset was used since the map's last eviction sweep */
+  uint32_t refs;
+  uint8_t  referenced;
+
+  /* borrowed - if the data is owned by something else (i.e a memory or
+   *            mapped pak file) and shouldn't be freed with the asset */
   uint8_t fs;
+  uint8_t borrowed;
   uint8_t filled;
   uint8_t req;
   uint8_t req_free;
   uint8_t chunk;
 } asset_t;
 
+/* PAK_CODEC_LZ4_CHUNKED - only stored, files bigger than a chunk written
+ * with PAK_CODEC_LZ4 are split into blocks of ASTERA_PAK_CHUNK_SIZE raw
+ * bytes, each prefixed with its stored size (top bit set if uncompressed) */
+typedef enum {
+  PAK_CODEC_NONE        = 0,
+  PAK_CODEC_LZ4         = 1,
+  PAK_CODEC_LZ4_CHUNKED = 2,
+} pak_codec;
+
+// The raw bytes the pak writer reads & compresses at a time (version 5+)
+#define ASTERA_PAK_CHUNK_SIZE (256 * 1024)
+
 #if defined(ASTERA_PAK_WRITE)
 typedef struct {
   char     name[56];
@@ -42,6 +62,20 @@ typedef struct {
   uint32_t size;
   uint32_t index;
 
+  // stored_size - the size of the data written out (after compression)
+  uint32_t stored_size;
+
+  // checksum - fnv-1a hash of the file's data (see asset_checksum)
+  uint32_t checksum;
+
+  // time - the time spent reading, compressing & writing the file (ms)
+  double time;
+
+  /* codec - the compression codec to store this file with (pak_codec)
+   * level - the compression level to use (1 = fastest, 9 = smallest) */
+  uint8_t codec;
+  uint8_t level;
+
   // If  the file is loaded in memory or not
   uint8_t is_mem;
 
@@ -55,19 +89,66 @@ typedef struct {
   const char*  filepath;
   pak_wfile_t* files;
   uint32_t     count;
+
+  /* codec - the codec used for files added from here on (pak_codec)
+   * level - the compression level used for files added from here on */
+  uint8_t codec;
+  uint8_t level;
+
+  // base - a previous build of the pak to reuse unchanged files from
+  const char* base;
+
+  // threads - worker threads hashing & compressing files, 0 = none
+  uint32_t threads;
+
+  /* reused - files copied from the base pak without being read or compressed
+   * shared - files with the same data as an earlier file, stored once
+   * shared_bytes - the bytes not written thanks to shared files */
+  uint32_t reused, shared;
+  uint64_t shared_bytes;
 } pak_write_t;
 #endif
 
-/* PAK FILE LAYOUT:
- * 0  - pack_header_t
- * 12 - entries
- * n  - start of files */
+/* PAK FILE LAYOUT (legacy, id "PACK"):
+ * 0  - pak_header_t
+ * 8  - entries
+ * n  - start of files
+ *
+ * PAK FILE LAYOUT (extended, id "PAKX"):
+ * 0  - pak_header_t
+ * 8  - pak_header_ext_t
+ * 24 - entries
+ * n  - name hash table (pak_hash_t * count, sorted by hash)
+ * n  - entry extensions (pak_file_ext_t * count, version 3+)
+ * n  - entry checksums (uint32_t * count, version 4+)
+ * n  - start of files
+ *
+ * NOTE: entries with the same data share one offset (version 4+)
+ * NOTE: big compressed entries are stored in chunks (version 5+) */
+
+#define ASTERA_PAK_ID_LEGACY   "PACK"
+#define ASTERA_PAK_ID_EXTENDED "PAKX"
+
+// The newest pak format version this build can read & writes out
+#define ASTERA_PAK_VERSION 5
 
 typedef struct {
   char     id[4];
   uint32_t count;
 } pak_header_t;
 
+// exactly 16 bytes, only present in extended ("PAKX") pak files
+typedef struct {
+  /* version - the format version of the pak file
+   * flags - reserved for format features
+   * hash_offset - the offset of the name hash table (bytes)
+   * data_offset - the offset of the first file's data (bytes) */
+  uint32_t version;
+  uint32_t flags;
+  uint32_t hash_offset;
+  uint32_t data_offset;
+} pak_header_ext_t;
+
 // exactly 64 bytes
 typedef struct {
   char     name[56];
@@ -75,34 +156,115 @@ typedef struct {
   uint32_t size;
 } pak_file_t;
 
+// exactly 8 bytes, only present in version 3+ pak files
+typedef struct {
+  /* codec - the codec the entry's data is stored with (pak_codec), version
+   *         4+ keeps the codec the entry was written with in bits 8-15
+   * raw_size - the size of the entry once decompressed (bytes)
+   * NOTE: pak_file_t's size is the size of the stored data */
+  uint32_t codec;
+  uint32_t raw_size;
+} pak_file_ext_t;
+
+// exactly 8 bytes
+typedef struct {
+  /* hash - fnv-1a hash of the entry's name
+   * index - the index of the entry the hash belongs to */
+  uint32_t hash;
+  uint32_t index;
+} pak_hash_t;
+
 typedef struct {
   pak_file_t* files;
   uint32_t    count;
 
+  /* hashes - name hashes of each entry, sorted by hash (for pak_find)
+   * NOTE: built at open time for legacy pak files */
+  pak_hash_t* hashes;
+
+  /* exts - compression info for each entry, 0 if none are compressed */
+  pak_file_ext_t* exts;
+
+  // checksums - fnv-1a hash of each entry's data, 0 before version 4
+  uint32_t* checksums;
+
   union {
     const void* ptr;
     const char* filepath;
   } data;
 
   /* data_size - the size of the pak file (bytes)
-   * is_mem - if to use data.ptr for accessing data */
+   * version - the format version of the pak file (1 = legacy)
+   * is_mem - if to use data.ptr for accessing data
+   * is_mmap - if data.ptr is a read only mapping of the pak file */
   uint32_t data_size;
+  uint32_t version;
   uint8_t  is_mem;
+  uint8_t  is_mmap;
 } pak_t;
 
+// Asynchronous loading state of an asset map, defined in asset.c
+typedef struct asset_stream_t asset_stream_t;
+
+typedef struct {
+  /* data - the block allocations are made from
+   * capacity - the size of the block in bytes
+   * used - the bytes allocated since the last reset
+   * peak - the most bytes used at once
+   * owned - if the block was allocated by the arena */
+  unsigned char* data;
+  uint32_t       capacity, used, peak;
+  uint8_t        owned;
+} asset_arena_t;
+
+typedef struct {
+  /* hits - lookups served by an asset already in the map
+   * misses - lookups that had to load the asset
+   * evictions - assets dropped to stay within the budget
+   * resident - bytes of asset data owned by the map (borrowed data excluded)
+   * budget - the max resident bytes, 0 = unlimited */
+  uint32_t hits, misses, evictions;
+  uint64_t resident;
+  uint64_t budget;
+} asset_map_stats_t;
+
 typedef struct {
   asset_t** assets;
 
   uint32_t count;
   uint32_t capacity;
 
-  // uid_counter - the ID of assets in this map
-  uint32_t uid_counter;
+  /* table - open addressed table of slot + 1 by name hash (0 = empty)
+   * table_hashes - the name hash of each table entry
+   * table_capacity - the size of the table (power of 2)
+   * free_slots - stack of the empty slots in assets (free_count in use)
+   * live - the slots in use (count in use), live_index - position in live
+   * names - the map's copy of each slot's name, the asset's name points at
+   *         it so callers don't have to keep theirs around */
+  uint32_t* table;
+  uint32_t* table_hashes;
+  uint32_t  table_capacity;
+  uint32_t* free_slots;
+  uint32_t  free_count;
+  uint32_t* live;
+  uint32_t* live_index;
+  char**    names;
+
+  /* clock - the position in live of the next asset to check for eviction
+   * stats - usage & the memory budget of the map */
+  uint32_t          clock;
+  asset_map_stats_t stats;
 
   const char* name;
   const char* filename;
 
   pak_t* pak;
+
+  // stream - worker threads for asset_map_request [OPTIONAL]
+  asset_stream_t* stream;
+
+  // arena - where loaded assets are allocated from [OPTIONAL]
+  asset_arena_t* arena;
 } asset_map_t;
 
 #if defined(ASTERA_PAK_WRITE)
@@ -117,6 +279,31 @@ pak_write_t* pak_write_create(const char* file);
  * NOTE: THIS FUNCTION IS ONLY INCLUDED IF ASTERA_PAK_WRITE IS DEFINED */
 void pak_write_destroy(pak_write_t* write);
 
+/* Set the compression used for files added to the write structure after
+ * write - the write structure to change
+ * codec - the codec to use (pak_codec)
+ * level - the compression level, 1 (fastest) to 9 (smallest)
+ * NOTE: files which don't get smaller are stored uncompressed
+ * NOTE: THIS FUNCTION IS ONLY INCLUDED IF ASTERA_PAK_WRITE IS DEFINED */
+void pak_write_set_codec(pak_write_t* write, uint8_t codec, uint8_t level);
+
+/* Set a previous build of the pak to copy unchanged files from
+ * write - the write structure
+ * base - the path of the previous pak, 0 = none
+ * NOTE: files on disk are reused if their size matches & they haven't been
+ * modified since the base was written, files in memory if their checksum
+ * matches. The base has to be a different file than the one written
+ * NOTE: THIS FUNCTION IS ONLY INCLUDED IF ASTERA_PAK_WRITE IS DEFINED */
+void pak_write_set_base(pak_write_t* write, const char* base);
+
+/* Set the amount of worker threads to hash & compress files with
+ * write - the write structure
+ * threads - the amount of threads, 0 = only the calling thread
+ * NOTE: files are always read & written in chunks of ASTERA_PAK_CHUNK_SIZE,
+ * at most 2 chunks per thread (1 without threads) are queued at a time
+ * NOTE: THIS FUNCTION IS ONLY INCLUDED IF ASTERA_PAK_WRITE IS DEFINED */
+void pak_write_set_threads(pak_write_t* write, uint32_t threads);
+
 /* Add a file to the pack file with name
  * write - the write structure to append to
  * file - the source file
@@ -139,6 +326,7 @@ uint8_t pak_write_add_mem(pak_write_t* write, const unsigned char* data,
 /* Write the pack write structure to file
  * write - the structure to write
  * returns: success = 1, fail = 0
+ * NOTE: files with the same data are only stored once
  * NOTE: THIS FUNCTION IS ONLY INCLUDED IF ASTERA_PAK_WRITE IS DEFINED */
 uint8_t pak_write_to_file(pak_write_t* write);
 #endif
@@ -157,6 +345,14 @@ pak_t* pak_open_file(const char* file);
  * pak structure, don't free it if you still want to use the pak struct */
 pak_t* pak_open_mem(unsigned char* data, uint32_t data_length);
 
+/* Open a file as a pak by mapping it into memory (read only)
+ * file - path to the pak file
+ * returns: pointer to pak_t struct for usage, fail = 0
+ * NOTE: pak_extract returns pointers directly into the mapping, they're
+ * valid until pak_close & shouldn't be written to or freed. Platforms
+ * without mapping support fall back to reading the whole file into memory */
+pak_t* pak_open_mmap(const char* file);
+
 /* Close out a pak file & free all its resources
  *  returns: success = 1, fail = 0 */
 uint8_t pak_close(pak_t* pak);
@@ -164,7 +360,10 @@ uint8_t pak_close(pak_t* pak);
 /* Get the data of an indexed file (allocates own space if filemode)
  * pak - the pak structure pointer
  * index - the index of the file
- * size - a pointer to int to set the size */
+ * size - a pointer to int to set the size
+ * NOTE: in memory & mapped modes (pak->is_mem) the pointer returned is owned
+ * by the pak & shouldn't be freed, unless the entry is compressed (see
+ * pak_compressed) in which case it's decompressed into its own space */
 unsigned char* pak_extract(pak_t* pak, uint32_t index, uint32_t* size);
 
 /* Get the data of an indexed file (uses your data pointer)
@@ -177,10 +376,35 @@ unsigned char* pak_extract(pak_t* pak, uint32_t index, uint32_t* size);
 uint32_t pak_extract_noalloc(pak_t* pak, uint32_t index, unsigned char* out,
                              uint32_t out_cap);
 
+/* Get the data of multiple files at once, reading them in offset order with
+ * neighbouring entries merged into single sequential reads
+ * pak - the pak structure pointer
+ * indices - the indices of the files
+ * count - the number of indices
+ * out - the data pointers, a non zero out[i] is filled in place & has to
+ *       hold pak_size(pak, indices[i]) bytes
+ * sizes - the sizes of the files [OPTIONAL]
+ * buffer - space to place files without an out pointer in [OPTIONAL]
+ * buffer_cap - the capacity of buffer (see pak_extract_batch_size)
+ * returns: the number of files extracted, failed files have out[i] = 0
+ * NOTE: files without an out pointer or a buffer follow the ownership rules
+ * of pak_extract. Files placed in buffer are null terminated & 8 byte
+ * aligned */
+uint32_t pak_extract_batch(pak_t* pak, const uint32_t* indices,
+                           uint32_t count, unsigned char** out,
+                           uint32_t* sizes, unsigned char* buffer,
+                           uint32_t buffer_cap);
+
+/* Get the buffer capacity needed to place a batch of files
+ * returns: the capacity in bytes for pak_extract_batch */
+uint32_t pak_extract_batch_size(pak_t* pak, const uint32_t* indices,
+                                uint32_t count);
+
 /* Find an entry in the pak file by name
  * pak - the pak structure
  * filename - the name of the entry
- * returns: index, fail = -1 */
+ * returns: index, fail = -1
+ * NOTE: uses a binary search of the name hash table, O(log n) */
 int32_t pak_find(pak_t* pak, const char* filename);
 
 /* Return the total number of entries in the pak structure
@@ -197,15 +421,44 @@ uint32_t pak_offset(pak_t* pak, uint32_t index);
 /* Get the size of a file within the pak file
  * pak - pak file structure
  * index - the index of the entry
- * returns: size of the entry file */
+ * returns: size of the entry file (uncompressed) */
 uint32_t pak_size(pak_t* pak, uint32_t index);
 
+/* Get the amount of space a file takes up within the pak file
+ * pak - pak file structure
+ * index - the index of the entry
+ * returns: size of the entry's stored (compressed) data */
+uint32_t pak_stored_size(pak_t* pak, uint32_t index);
+
+/* Get the codec an entry is stored with
+ * pak - pak file structure
+ * index - the index of the entry
+ * returns: pak_codec of the entry */
+uint8_t pak_codec_of(pak_t* pak, uint32_t index);
+
+/* Check if an entry is stored compressed
+ * pak - pak file structure
+ * index - the index of the entry
+ * returns: compressed = 1, raw = 0 */
+uint8_t pak_compressed(pak_t* pak, uint32_t index);
+
+/* Get the checksum of an entry's data (matches asset_checksum once extracted)
+ * pak - pak file structure
+ * index - the index of the entry
+ * returns: the checksum, unknown (before version 4) = 0 */
+uint32_t pak_checksum(pak_t* pak, uint32_t index);
+
 /* Get the name of an entry by index
  * pak - the pak file structure
  * index - the index of the entry
  * returns: name string */
 char* pak_name(pak_t* pak, uint32_t index);
 
+/* Get the hash of an entry name as stored in the pak's hash table
+ * name - the name of the entry
+ * returns: fnv-1a hash of the name */
+uint32_t pak_name_hash(const char* name);
+
 /* Initialize an fnv-1a hash
  * Returns: initial fnv1a value */
 uint32_t asset_fnv1a_init(void);
@@ -221,41 +474,151 @@ void asset_fnv1a_hash(uint32_t* hash, const void* data, uint32_t size);
  * returns: 32-bit checksum */
 uint32_t asset_checksum(asset_t* asset);
 
+/* Create an arena to bump allocate assets from
+ * data - the block to allocate from, 0 = allocate one [OPTIONAL]
+ * capacity - the size of the block in bytes
+ * returns: the arena, fail = arena with capacity 0 */
+asset_arena_t asset_arena_create(unsigned char* data, uint32_t capacity);
+
+/* Destroy an arena, freeing its block if the arena allocated it */
+void asset_arena_destroy(asset_arena_t* arena);
+
+/* Allocate space from an arena (16 byte aligned)
+ * returns: pointer to the space, fail (arena full) = 0
+ * NOTE: arenas aren't thread safe */
+void* asset_arena_alloc(asset_arena_t* arena, uint32_t size);
+
+/* Get the current position of an arena to reset back to later
+ * returns: the mark */
+uint32_t asset_arena_mark(asset_arena_t* arena);
+
+/* Release every allocation made since a mark in O(1)
+ * mark - the mark to reset to, 0 = release everything */
+void asset_arena_reset(asset_arena_t* arena, uint32_t mark);
+
 /* Create an asset map
  * filename - point to a file to read from [OPTIONAL]
  * name - the name of the asset map capacity - the max number of
  * assets to store in the map
+ * budget - the max bytes of asset data to keep loaded, unreferenced assets
+ *          are evicted least recently used first (0 = unlimited)
  * returns: formatted asset_map_t type with assets loaded in */
 asset_map_t asset_map_create(const char* filename, const char* name,
-                             uint32_t capacity);
+                             uint32_t capacity, uint64_t budget);
+
+/* Create an asset map backed by a memory mapped pak file
+ * filename - the pak file to map
+ * name - the name of the asset map capacity - the max number of
+ * assets to store in the map
+ * budget - the max bytes of asset data to keep loaded (0 = unlimited)
+ * returns: formatted asset_map_t type, assets from the pak are borrowed from
+ * the mapping rather than copied */
+asset_map_t asset_map_create_mmap(const char* filename, const char* name,
+                                  uint32_t capacity, uint64_t budget);
 
 /* Create an asset map
  * data - the data of a pak file [OPTIONAL]
  * data_length - the length of the pak file's data [OPTIONAL]
  * name - the name of the asset map capacity - the max number of
  * assets to store in the map
+ * budget - the max bytes of asset data to keep loaded (0 = unlimited)
  * returns: formatted asset_map_t type with assets loaded in */
 asset_map_t asset_map_create_mem(unsigned char* data, uint32_t data_length,
-                                 const char* name, uint32_t capacity);
+                                 const char* name, uint32_t capacity,
+                                 uint64_t budget);
 
 /* Destroy an asset map and all its resources
  * map - the map to destroy */
 void asset_map_destroy(asset_map_t* map);
 
-/* Add an asset into the tracking of a map */
-void asset_map_add(asset_map_t* map, asset_t* asset);
-/* Remove an asset from the tracking of a map */
+/* Add an asset into the tracking of a map (sets the asset's uid to its slot)
+ * returns: success = 1, fail (map full) = 0
+ * NOTE: the map keeps its own copy of the asset's name & points name at it */
+uint8_t asset_map_add(asset_map_t* map, asset_t* asset);
+/* Remove an asset from the tracking of a map, freeing its data */
 void asset_map_remove(asset_map_t* map, asset_t* asset);
 /* Remove an asset from the tracking of a map by id */
 void asset_map_removei(asset_map_t* map, uint32_t id);
-/* Get a file from the asset map's directed source */
+/* Find an asset tracked by the map by name
+ * returns: the asset, not found = 0 */
+asset_t* asset_map_find(asset_map_t* map, const char* file);
+/* Get a file from the asset map's directed source (cached in the map)
+ * returns: the asset, fail (or no space in the map) = 0
+ * NOTE: the asset is referenced until released with asset_map_release */
 asset_t* asset_map_get(asset_map_t* map, const char* file);
+/* Hold a reference to an asset, keeping it from being evicted */
+void asset_map_retain(asset_map_t* map, asset_t* asset);
+/* Drop a reference to an asset, at 0 refs it can be evicted
+ * NOTE: an asset that failed to load is removed at 0 refs */
+void asset_map_release(asset_map_t* map, asset_t* asset);
+/* Set the max bytes of asset data the map keeps loaded, evicting if needed
+ * map - the map to set the budget of
+ * budget - the max bytes of asset data, 0 = unlimited */
+void asset_map_set_budget(asset_map_t* map, uint64_t budget);
+/* Evict unreferenced assets until the map is within its budget
+ * returns: the number of assets evicted */
+uint32_t asset_map_trim(asset_map_t* map);
+/* Get the usage stats of a map */
+asset_map_stats_t asset_map_get_stats(asset_map_t* map);
+
+/* Allocate the assets the map loads (structure & data) from an arena
+ * map - the map to set the arena of
+ * arena - the arena to use, 0 = the heap
+ * NOTE: assets fall back to the heap once the arena is full. Arena data is
+ * borrowed, so it doesn't count against the map's budget */
+void asset_map_set_arena(asset_map_t* map, asset_arena_t* arena);
+
+/* Start a scope of assets (i.e a level) in the map's arena
+ * returns: the scope to pass to asset_map_scope_end */
+uint32_t asset_map_scope_begin(asset_map_t* map);
+
+/* Remove every asset loaded into the arena since the scope began & release
+ * their space at once, references are ignored
+ * map - the map to end the scope of
+ * scope - the scope returned by asset_map_scope_begin
+ * NOTE: assets that fell back to the heap are left in the map, size the arena
+ * for the largest scope (see asset_arena_t.peak) */
+void asset_map_scope_end(asset_map_t* map, uint32_t scope);
 /* Get an asset from the map by index */
 asset_t* asset_map_geti(asset_map_t* map, uint32_t id);
 
-/* Update for any free requests made*/
+/* Update for any free requests made (also calls asset_map_poll & trims the
+ * map to its budget) */
 void asset_map_update(asset_map_t* map);
 
+/* Start worker threads to load requested assets in the background
+ * map - the map to start streaming for
+ * thread_count - the number of worker threads, 0 = processor count - 1
+ * returns: success = 1, fail = 0 */
+uint8_t asset_map_stream_start(asset_map_t* map, uint32_t thread_count);
+
+/* Finish any requests in flight & stop the map's worker threads
+ * map - the map to stop streaming for */
+void asset_map_stream_stop(asset_map_t* map);
+
+/* Request an asset to be loaded in the background
+ * map - the map to load from (asset_map_stream_start must be called first)
+ * file - the name of the file (in the pak or file system)
+ * priority - higher priority requests are loaded first
+ * returns: the asset (req = 1 until loaded), fail = 0
+ * NOTE: the asset is tracked by the map, its data is only valid once filled
+ * is set by asset_map_poll. If loading fails req is cleared without filled
+ * being set, the failed asset is freed by its last asset_map_release or
+ * requested again in place. Already tracked assets are returned as is. The
+ * asset is referenced until released with asset_map_release */
+asset_t* asset_map_request(asset_map_t* map, const char* file,
+                           int32_t priority);
+
+/* Publish the assets finished by the worker threads, sets filled
+ * map - the map to poll (call once per frame)
+ * returns: the number of requests finished since the last poll */
+uint32_t asset_map_poll(asset_map_t* map);
+
+/* Get the number of requests that haven't been published by a poll
+ * map - the map to check
+ * returns: number of pending requests */
+uint32_t asset_map_pending(asset_map_t* map);
+
 /* Get a file from the local system
    file - the file path of the file
    returns: formatted asset_t struct pointer with file data */
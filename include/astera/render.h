@@ -72,6 +72,24 @@ typedef struct {
 // Just for sanity's sake
 typedef uint32_t r_shader;
 
+/* The uniforms set by astera's draw functions, their locations are cached for
+ * each shader when it's created (see r_get_uniform) */
+typedef enum {
+  R_UNIFORM_VIEW = 0,
+  R_UNIFORM_PROJECTION,
+  R_UNIFORM_MODEL,
+  R_UNIFORM_MATS,
+  R_UNIFORM_COORDS,
+  R_UNIFORM_COLORS,
+  R_UNIFORM_COLOR,
+  R_UNIFORM_SHEET_SIZE,
+  R_UNIFORM_FLIP_X,
+  R_UNIFORM_FLIP_Y,
+  R_UNIFORM_USE_TEX,
+  R_UNIFORM_LAYER_MOD,
+  R_UNIFORM_COUNT,
+} r_uniform;
+
 typedef struct {
   /* fbo - the OpenGL Framebuffer Object handle
    * tex - the OpenGL Texture handle (for fbo)
@@ -164,6 +182,80 @@ typedef struct {
   uint32_t  count, capacity;
 } r_sheet;
 
+typedef struct {
+  /* x - the left edge of the run in pixels
+   * y - the height of the packed images along the run
+   * width - the width of the run in pixels */
+  uint32_t x, y, width;
+} r_atlas_node;
+
+typedef struct {
+  /* sheet - the page's texture & the images packed into it
+   * NOTE: the sheet's address doesn't change as the atlas grows, so sprites
+   *       can point to it */
+  r_sheet sheet;
+
+  /* skyline - the top edge of the packed images, left to right
+   * node_count - the amount of nodes in the skyline
+   * node_capacity - the amount of nodes allocated */
+  r_atlas_node* skyline;
+  uint32_t      node_count, node_capacity;
+} r_atlas_page;
+
+typedef struct {
+  /* pages - the atlas' pages, each its own texture
+   * page_count - the amount of pages
+   * page_capacity - the amount of pages allocated */
+  r_atlas_page** pages;
+  uint32_t       page_count, page_capacity;
+
+  /* page_size - the width & height of new pages
+   * max_size - the largest width & height a page can grow to
+   * padding - the empty pixels kept between packed images */
+  uint32_t page_size, max_size, padding;
+} r_atlas;
+
+// The start of a pre-decoded texture (see r_sheet_create_packed)
+#define R_TEX_MAGIC   "RTEX"
+#define R_TEX_VERSION 1
+
+typedef enum {
+  /* R_TEX_RGBA8 - 4 bytes per pixel
+   * R_TEX_BC3 - 16 bytes per 4x4 block (DXT5), needs
+   *             GL_EXT_texture_compression_s3tc */
+  R_TEX_RGBA8 = 0,
+  R_TEX_BC3   = 1,
+} r_tex_format;
+
+/* A pre-decoded texture is laid out as:
+ * r_tex_header, r_tex_region * subtex_count, then each mip level's data
+ * largest first, all little endian */
+typedef struct {
+  /* magic - R_TEX_MAGIC
+   * version - R_TEX_VERSION
+   * format - the r_tex_format of the levels */
+  char     magic[4];
+  uint16_t version, format;
+
+  /* width - the width of the first level in pixels
+   * height - the height of the first level in pixels
+   * levels - the amount of mip levels stored (1 = no mipmaps)
+   * subtex_count - the amount of sub textures in the table */
+  uint32_t width, height;
+  uint32_t levels, subtex_count;
+} r_tex_header;
+
+typedef struct {
+  uint32_t x, y, width, height;
+} r_tex_region;
+
+typedef struct {
+  /* sheet - the sheet of the page the image was packed into, 0 = failed
+   * subtex - the image's sub texture in the sheet */
+  r_sheet* sheet;
+  uint32_t subtex;
+} r_atlas_region;
+
 typedef struct {
   /* x - the x offset in relative worldspace
    * y - the y offset in relative worldspace
@@ -197,6 +289,9 @@ typedef struct {
    * size - the size in world units of the sheet
    * scale - the amount to scale the sheet*/
   vec2 position, size, scale;
+  /* bounds - the area the quads cover relative to position (min x, min y,
+   *          max x, max y) */
+  vec4 bounds;
   /* model - just the OpenGL Model Matrix to render with */
   mat4x4 model;
 } r_baked_sheet;
@@ -270,30 +365,103 @@ typedef struct {
   uint8_t change, animated, visible, group;
 } r_sprite;
 
-/* TODO (uniform buffers) follows layout of sprite_data:
- layout(std140, binding=1) uniform sprite_data {
-  vec4 coords;
-  vec4 color;
-  int  flip_x;
-  int  flip_y;
-  mat4 model;
-}; */
+// Flags for each sprite in an r_sprite_pool
+typedef enum {
+  R_SPRITE_POOL_VISIBLE = 1,
+  R_SPRITE_POOL_FLIP_X  = 2,
+  R_SPRITE_POOL_FLIP_Y  = 4,
+} r_sprite_pool_flag;
+
+/* Sprites sharing a sheet & shader, stored as separate arrays so updates
+ * & culling go through them a group at a time, made for large amounts of
+ * sprites (use r_sprite otherwise)
+ * NOTE: arrays are padded to a multiple of 4 sprites for the SIMD kernels */
+typedef struct {
+  /* sheet - the sheet every sprite in the pool uses
+   * shader - the shader every sprite in the pool is drawn with */
+  r_sheet* sheet;
+  r_shader shader;
+
+  /* x, y - the center of each sprite in world units
+   * half_w, half_h - half of the size of each sprite */
+  float *x, *y;
+  float *half_w, *half_h;
+
+  /* times - the time into each sprite's current frame
+   * rates - the length of each sprite's current frame (0 = not animating)
+   * anims - the animation of each sprite (0 = a single subtexture)
+   * frames - the current frame of each animation, or each sprite's
+   *          subtexture if not animated */
+  float*    times;
+  float*    rates;
+  r_anim**  anims;
+  uint32_t* frames;
+
+  /* colors - the color of each sprite
+   * layers - the layer of each sprite
+   * flags - the r_sprite_pool_flag bits of each sprite */
+  vec4*    colors;
+  uint8_t* layers;
+  uint8_t* flags;
+
+  /* count - the number of sprites in the pool
+   * capacity - the max number of sprites in the pool */
+  uint32_t count, capacity;
+} r_sprite_pool;
 
+// The amount of instance buffers each batch cycles through
+#if !defined(ASTERA_RENDER_INSTANCE_BUFFERS)
+#define ASTERA_RENDER_INSTANCE_BUFFERS 3
+#endif
+
+/* Per sprite data streamed to shaders with instanced attributes, follows the
+ * layout of batch.vert:
+ layout(location = 2) in mat4 in_model; (locations 2 to 5)
+ layout(location = 6) in vec4 in_coords;
+ layout(location = 7) in vec4 in_color;
+ layout(location = 8) in vec2 in_flip; */
 typedef struct {
-  vec4   coord;
-  vec4   color;
-  int    flip_x;
-  int    flip_y;
   mat4x4 model;
-} r_sprite_data;
+  vec4   coords;
+  vec4   color;
+  vec2   flip;
+} r_instance;
+
+// Flip bits of r_instance_packed
+#define R_INSTANCE_PACKED_FLIP_X 1
+#define R_INSTANCE_PACKED_FLIP_Y 2
+
+/* Per sprite data packed into 32 bytes for 2D sprites, follows the layout of
+ * batch_packed.vert:
+ layout(location = 2) in vec4 in_rect; (x, y, w, h)
+ layout(location = 3) in vec4 in_coords; (normalized shorts)
+ layout(location = 4) in vec4 in_color; (normalized bytes)
+ layout(location = 5) in uint in_rotation; (0 - 65535 = 0 - 2 pi)
+ layout(location = 6) in uvec2 in_misc; (layer, flip bits) */
+typedef struct {
+  float    x, y, w, h;
+  uint16_t coords[4];
+  uint8_t  color[4];
+  uint16_t rotation;
+  uint8_t  layer, flags;
+} r_instance_packed;
 
-// TODO this -> sub_buffer and swap in at draw call not buffer at draw call
 typedef struct {
-  uint32_t       binding_point, block_index;
-  uint32_t       buffer;
-  int            count, capacity;
-  r_sprite_data* sprite_data;
-} r_ubo;
+  /* vaos - a vertex array per buffer, with the quad & instance attributes
+   * buffers - the instance buffers, written round robin
+   * fences - the GL sync set after drawing from each buffer
+   * current - the next buffer to write
+   * capacity - the amount of instances each buffer holds
+   * stride - the size of each instance (r_instance or r_instance_packed) */
+  uint32_t vaos[ASTERA_RENDER_INSTANCE_BUFFERS];
+  uint32_t buffers[ASTERA_RENDER_INSTANCE_BUFFERS];
+  void*    fences[ASTERA_RENDER_INSTANCE_BUFFERS];
+  uint32_t current, capacity, stride;
+
+  /* orphans - the times a buffer was still in use & had to be reallocated
+   *           instead of written over (a bigger ring avoids this) */
+  uint32_t orphans;
+} r_instance_ring;
 
 typedef struct {
   r_shader shader;
@@ -306,11 +474,57 @@ typedef struct {
   vec4*   colors;
   vec4*   coords;
 
+  /* instances - per sprite data for shaders with instanced attributes
+   * packed - per sprite data for shaders with packed instanced attributes
+   * ring - the buffers the instances are streamed through */
+  r_instance*        instances;
+  r_instance_packed* packed;
+  r_instance_ring    ring;
+
+  /* count - the amount of sprites in the batch
+   * capacity - the max amount of sprites in the batch
+   * use_instances - if the shader takes instanced attributes (in_model at
+   *                 location 2) rather than uniform arrays
+   * use_packed - if the shader takes packed instanced attributes (in_rect at
+   *              location 2) */
   uint32_t count, capacity;
-  uint8_t  use_ubo;
-  r_ubo    ubo;
+  uint8_t  use_instances, use_packed;
 } r_batch;
 
+/* A sprite queued for the frame, drawn in key order by r_ctx_draw
+ * NOTE: sprites keep their full instance & are only packed for batches whose
+ *       shader takes r_instance_packed, r_sprite_pool writes packed instances
+ * key - from high to low bits: layer (8), shader (16), sheet (16) & the order
+ *       it was queued in (24), so sprites sharing state end up next to each
+ *       other within a layer
+ * sheet - the sheet to draw the sprite with
+ * shader - the shader to draw the sprite with
+ * instance - the index of the sprite's data in the buffer's instances
+ * packed - if the sprite's data is in the buffer's packed instances */
+typedef struct {
+  uint64_t key;
+  r_sheet* sheet;
+  r_shader shader;
+  uint32_t instance;
+  uint8_t  packed;
+} r_command;
+
+typedef struct {
+  /* commands - the queued sprites
+   * sorted - scratch space for sorting the commands
+   * instances - the data of each sprite, copied when it's queued
+   * packed - the data of each packed sprite (r_sprite_pool)
+   * count - the amount of queued sprites
+   * capacity - the amount of sprites that can be queued before growing */
+  r_command*         commands;
+  r_command*         sorted;
+  r_instance*        instances;
+  r_instance_packed* packed;
+  uint32_t           count, capacity;
+} r_command_buffer;
+
+/* A single particle, copied out of & back into a system's arrays for the
+ * spawner & per particle animator callbacks */
 typedef struct {
   float   life, last;
   float   rotation;
@@ -321,6 +535,32 @@ typedef struct {
   vec4     color;
 } r_particle;
 
+/* The particles of a system, stored as separate arrays so they're simulated
+ * 4 at a time
+ * NOTE: arrays are padded to a multiple of 4 particles */
+typedef struct {
+  /* x, y - the position of each particle relative to the system
+   * vx, vy - the velocity of each particle (units per millisecond) */
+  float *x, *y;
+  float *vx, *vy;
+
+  /* life - the time each particle has left in milliseconds
+   * rotation - the rotation of each particle
+   * width, height - the size of each particle
+   * dir_x, dir_y - the direction of each particle (for custom behavior) */
+  float* life;
+  float* rotation;
+  float *width, *height;
+  float *dir_x, *dir_y;
+
+  /* frames - the frame (or sub texture) of each particle
+   * colors - the color of each particle
+   * layers - the layer of each particle */
+  uint32_t* frames;
+  vec4*     colors;
+  uint8_t*  layers;
+} r_particle_arrays;
+
 typedef enum {
   PARTICLE_COLORED,
   PARTICLE_TEXTURED,
@@ -332,12 +572,18 @@ typedef struct r_particles r_particles;
 typedef void (*r_particle_animator)(r_particles*, r_particle*);
 typedef void (*r_particle_spawner)(r_particles*, r_particle*);
 
+/* Animate the particles [start, start + count) of a system directly through
+ * its arrays (system->data) */
+typedef void (*r_particle_batch_animator)(r_particles*, uint32_t start,
+                                          uint32_t count);
+
 struct r_particles {
-  /* list - the array of particles */
-  r_particle* list;
+  /* data - the particles, live particles are kept packed at the front
+   *        (the first `count`), so their order changes as they die */
+  r_particle_arrays data;
 
   /* capacity - the max amount of particles to buffer for
-   * count - the amount of particles within the system currently
+   * count - the amount of live particles at the front of list
    * max_emission - the max amount of particles to emit (0 = infinite)
    * emission_count - the amount of particles emitted */
   uint32_t capacity, count;
@@ -358,6 +604,12 @@ struct r_particles {
    * spawn_time - the time remaining to next particle spawn */
   float time, spawn_time;
 
+  /* rng - the system's own random numbers, for spawning (& spawner
+   *       callbacks), so systems can update at once & replay exactly
+   * seed - the seed rng restarts from on reset */
+  s_rand   rng;
+  uint64_t seed;
+
   /* position - The center position of the particle system
    * size - the size (width, height) of the particle system
    * model - the model matrix of the base system */
@@ -379,15 +631,24 @@ struct r_particles {
   /* Overall color of the system */
   vec4 color;
 
-  /* GL Uniforms */
+  /* GL Uniforms
+   * uniform_count - the amount of particles waiting in the arrays
+   * uniform_cap - the most particles sent in one draw call
+   * uniform_size - the length of the arrays, r_particles_update_many grows
+   *                them to hold every particle
+   * prepared - if r_particles_update_many wrote the arrays since the last
+   *            draw, so r_particles_draw only has to send them */
   mat4x4*  mats;
   vec4*    colors;
   vec4*    coords;
-  uint32_t uniform_count, uniform_cap;
+  uint32_t uniform_count, uniform_cap, uniform_size;
+  uint8_t  prepared;
 
-  /* For custom movement/behavior */
-  r_particle_animator animator_func;
-  r_particle_spawner  spawner_func;
+  /* For custom movement/behavior, batch_animator_func is used over
+   * animator_func if set */
+  r_particle_animator       animator_func;
+  r_particle_batch_animator batch_animator_func;
+  r_particle_spawner        spawner_func;
 
   /* Flags
    * calculate: whether to calculate data for render
@@ -401,6 +662,51 @@ struct r_particles {
   int8_t calculate, type, use_animator, use_spawner, alive;
 };
 
+/* The most animation frames a GPU particle system can draw with, the size of
+ * the frame arrays in particles_gpu_draw.vert */
+#if !defined(ASTERA_PARTICLES_GPU_FRAMES)
+#define ASTERA_PARTICLES_GPU_FRAMES 32
+#endif
+
+/* Particles simulated on the GPU with transform feedback, only the amount of
+ * particles to spawn is worked out on the CPU. Each particle is a position,
+ * velocity & life in a GL buffer, the rest comes from the r_particles the
+ * system follows (spawn rate, lifetimes, area, size, velocity, color, layer
+ * & texture), custom spawners & animators aren't run */
+typedef struct {
+  /* system - the particle system to take the spawn settings & timing from,
+   *          its own particles & arrays aren't used
+   * update - the transform feedback shader to advance the particles with */
+  r_particles* system;
+  r_shader     update;
+
+  /* buffers - the particle state, read from one & written into the other
+   * vaos - the vertex arrays to update each buffer's particles from
+   * draw_vaos - the vertex arrays to draw each buffer's particles with
+   * current - the buffer with the latest state */
+  uint32_t buffers[2], vaos[2], draw_vaos[2];
+  uint32_t current;
+
+  /* capacity - the amount of particles in the buffers
+   * next - the slot the next particle spawns into, particles are spawned
+   *        round the buffer in order so the oldest is replaced first
+   * remaining - the time left until the last particle spawned dies */
+  uint32_t capacity, next;
+  float    remaining;
+} r_particles_gpu;
+
+/* The OpenGL bindings last made through astera, so draws that share them
+ * don't bind them again
+ * shader - the bound shader program
+ * tex - the texture bound to GL_TEXTURE0
+ * vao - the bound vertex array
+ * issued - the number of binds sent to OpenGL
+ * skipped - the number of binds skipped since they were already bound */
+typedef struct {
+  uint32_t shader, tex, vao;
+  uint32_t issued, skipped;
+} r_state;
+
 typedef struct r_ctx {
   /* window - the rendering context's window
    * camera - the rendering context's camera */
@@ -447,9 +753,24 @@ typedef struct r_ctx {
   uint8_t  batch_count, batch_capacity;
   uint32_t batch_size;
 
+  /* commands - the sprites queued to be batched this frame */
+  r_command_buffer commands;
+
+  /* jobs - worker threads preparing sprites (see r_ctx_set_threads) */
+  s_pool* jobs;
+
   /* input_ctx - a pointer to an input context for glfw callbacks */
   i_ctx* input_ctx;
 
+  /* state - the tracked OpenGL bindings (see r_ctx_reset_state) */
+  r_state state;
+
+  /* culling - skip sprites, particles & baked sheets outside of the camera
+   * drawn - the amount of instances that passed the camera test
+   * culled - the amount of instances skipped for being off camera */
+  uint8_t  culling;
+  uint32_t drawn, culled;
+
   /* allowed - allow rendering
    * scaled - whether the resolution has changed */
   uint8_t allowed, scaled;
@@ -477,7 +798,12 @@ r_window_params r_window_params_create(uint32_t width, uint32_t height,
  * params - the window parameters for the game window
  * use_fbo - to use a framebuffer to render to or not (post-processing)
  * batch_count - the number of batches to create for different draw types
+ *               NOTE: queued sprites are sorted & drawn one run at a time, so
+ *               a single batch is enough
  * batch_size - the max amount of sprites to store in each given batch
+ *              NOTE: shaders with uniform arrays (instanced.vert) can't hold
+ *              more than their array size, shaders with instanced attributes
+ *              (batch.vert) can hold thousands
  * anim_map_size - the amount of animations to allow to be cached / mapped
  * shader_map_size - the amount of shaders to allow to be cached / mapped */
 r_ctx* r_ctx_create(r_window_params params, uint8_t batch_count,
@@ -490,6 +816,41 @@ r_camera* r_ctx_get_camera(r_ctx* ctx);
 /* Make a specific context the primary context used for callbacks */
 void r_ctx_make_current(r_ctx* ctx);
 
+/* Forget the bindings tracked by the context, so the next draw binds
+ * everything it uses again
+ * NOTE: call this after other code draws with OpenGL (i.e the UI) & before
+ *       drawing with astera again in the same frame, r_window_swap_buffers
+ *       calls this as well
+ * ctx - the context to reset */
+void r_ctx_reset_state(r_ctx* ctx);
+
+/* Get the number of binds the context has sent to OpenGL & skipped
+ * ctx - the context to check
+ * issued - the number of binds sent (optional)
+ * skipped - the number of binds skipped as already bound (optional) */
+void r_ctx_get_binds(r_ctx* ctx, uint32_t* issued, uint32_t* skipped);
+
+/* Set whether to skip drawing things outside of the camera (default: on)
+ * NOTE: turn this off when drawing with a view other than the camera's
+ * ctx - the context to affect
+ * enabled - whether to cull (0 = no, 1 = yes) */
+void r_ctx_set_culling(r_ctx* ctx, uint8_t enabled);
+
+/* Set the amount of worker threads to prepare sprites on
+ * NOTE: r_sprites_update & r_sprites_draw split large lists between the
+ *       workers & the calling thread, then wait for them to finish, OpenGL
+ *       is only ever used from the calling thread
+ * ctx - the context to affect
+ * threads - the amount of worker threads, 0 = only the calling thread
+ * returns: success = 1, fail = 0 */
+uint8_t r_ctx_set_threads(r_ctx* ctx, uint32_t threads);
+
+/* Get the number of instances drawn & culled by the context
+ * ctx - the context to check
+ * drawn - the number of instances inside the camera (optional)
+ * culled - the number of instances skipped as off camera (optional) */
+void r_ctx_get_culled(r_ctx* ctx, uint32_t* drawn, uint32_t* culled);
+
 /* Set the input context for callbacks
  * ctx - the render context to set input callback for
  * input - the input context to set */
@@ -502,7 +863,9 @@ void r_ctx_destroy(r_ctx* ctx);
  * Currently just camera_update */
 void r_ctx_update(r_ctx* ctx);
 
-/* Call for the context to draw its contents */
+/* Call for the context to draw its contents
+ * NOTE: the queued sprites are sorted by layer, shader & sheet, then drawn
+ *       with as few draw calls as they allow */
 void r_ctx_draw(r_ctx* ctx);
 
 /* Check if OpenGL has thrown an error */
@@ -580,6 +943,7 @@ r_tex r_tex_create(unsigned char* data, uint32_t length);
 void r_tex_destroy(r_tex* tex);
 
 /* Bind the OpenGL Texture buffer passed
+ * NOTE: skipped if it's already bound in the current context
  * tex - the texture ID to bind */
 void r_tex_bind(uint32_t tex);
 
@@ -603,10 +967,84 @@ r_sheet r_sheet_create_tiled(unsigned char* data, uint32_t length,
                              uint32_t sub_width, uint32_t sub_height,
                              uint32_t width_pad, uint32_t height_pad);
 
+/* Create a sheet from a pre-decoded texture (pakutil texture)
+ * NOTE: the levels are uploaded as they are stored, without decoding
+ * data - the texture's data (r_tex_header onward)
+ * length - the length of the data
+ * returns: the sheet with the texture's sub textures, fail = {0} */
+r_sheet r_sheet_create_packed(unsigned char* data, uint32_t length);
+
+/* Get the size of one level of a pre-decoded texture
+ * format - the r_tex_format of the level
+ * width - the width of the level in pixels
+ * height - the height of the level in pixels
+ * returns: the size of the level in bytes */
+uint64_t r_tex_level_size(r_tex_format format, uint32_t width,
+                          uint32_t height);
+
 /* Destroy a texture sheet's OpenGL Buffer & free its subsprite contents
  * sheet - the sheet to destroy */
 void r_sheet_destroy(r_sheet* sheet);
 
+/* Create an atlas to pack images into at runtime
+ * NOTE: sprites drawn from the same page share a batch, whichever image
+ *       they came from
+ * page_size - the width & height pages start at
+ * max_size - the largest size pages grow to, 0 = the largest OpenGL allows
+ * padding - the empty pixels to keep between images
+ * returns: the atlas, fail = {0} */
+r_atlas r_atlas_create(uint32_t page_size, uint32_t max_size,
+                       uint32_t padding);
+
+/* Pack an image into the atlas
+ * NOTE: pages are grown (up to max_size) before new ones are added, the
+ *       coords of a grown page's sub textures are updated in place
+ * atlas - the atlas to pack into
+ * data - the image data (png, jpg, etc)
+ * length - the length of the image data
+ * returns: the page's sheet & the image's sub texture, fail = {0} */
+r_atlas_region r_atlas_add(r_atlas* atlas, unsigned char* data,
+                           uint32_t length);
+
+/* Pack decoded pixels into the atlas
+ * atlas - the atlas to pack into
+ * pixels - the RGBA pixels (4 bytes each), rows from the top down
+ * width - the width of the image in pixels
+ * height - the height of the image in pixels
+ * returns: the page's sheet & the image's sub texture, fail = {0} */
+r_atlas_region r_atlas_add_pixels(r_atlas* atlas, unsigned char* pixels,
+                                  uint32_t width, uint32_t height);
+
+/* Pack a sprite sheet into the atlas, splitting it by a grid
+ * NOTE: the tiles are given consecutive sub textures, so animations can
+ *       offset their frames by the first
+ * atlas - the atlas to pack into
+ * data - the image data (png, jpg, etc)
+ * length - the length of the image data
+ * sub_width - the width of each tile
+ * sub_height - the height of each tile
+ * returns: the page's sheet & the first tile's sub texture, fail = {0} */
+r_atlas_region r_atlas_add_tiled(r_atlas* atlas, unsigned char* data,
+                                 uint32_t length, uint32_t sub_width,
+                                 uint32_t sub_height);
+
+/* Take room for a rectangle on a page's skyline, without touching its texture
+ * NOTE: offline packers (pakutil) can pass a zeroed page with only the
+ *       sheet's width & height set, & free the page's skyline after
+ * page - the page to pack into
+ * width - the width of the rectangle
+ * height - the height of the rectangle
+ * x - set to the left edge of the rectangle
+ * y - set to the top edge of the rectangle
+ * returns: success = 1, no room = 0 */
+uint8_t r_atlas_page_pack(r_atlas_page* page, uint32_t width, uint32_t height,
+                          uint32_t* x, uint32_t* y);
+
+/* Destroy an atlas' pages & textures
+ * NOTE: sheets returned by the atlas can't be used after this
+ * atlas - the atlas to destroy */
+void r_atlas_destroy(r_atlas* atlas);
+
 /* Create a baked sheet (series of quads) to render
  * sheet - the texture sheet you want to use
  * quads - the quads you want to put within the baked_sheet
@@ -635,12 +1073,20 @@ void r_baked_sheet_destroy(r_baked_sheet* sheet);
  *                 (i.e PARTICLE_COLORED |  PARTICLE_ANIMATED)
  * calculate - whether or not to automatically calculate uniform arrays
  *             NOTE: You should only disable this if you want to use your own
- *                   methods of rendering  */
+ *                   methods of rendering
+ * NOTE: Systems are seeded in the order they're created, see
+ *       r_particles_set_seed */
 r_particles r_particles_create(uint32_t emit_rate, float particle_life,
                                uint32_t particle_capacity, uint32_t emit_count,
                                int8_t particle_type, int8_t calculate,
                                uint16_t uniform_cap);
 
+/* Seed a particle system's random numbers, the same seed spawns the same
+ * particles each time the system is started
+ * system - the system to affect
+ * seed - the seed to use */
+void r_particles_set_seed(r_particles* system, uint64_t seed);
+
 /* Start emission of the particles
  * NOTE: this resets uniforms, see resume to start after stopping
  * particles - the particle system to start */
@@ -714,21 +1160,73 @@ void r_particles_set_spawner(r_particles* system, r_particle_spawner spawner);
 void r_particles_set_animator(r_particles*        system,
                               r_particle_animator animator);
 
+/* Set the function to animate particles with a group at a time, faster
+ * than r_particles_set_animator for large systems
+ * system - the system to affect
+ * animator - the function to use, ex:
+ *            void animate(r_particles* system, uint32_t start,
+ *                         uint32_t count) */
+void r_particles_set_batch_animator(r_particles*              system,
+                                    r_particle_batch_animator animator);
+
 /* Remove a spawner function from a particle system
  * system - the system to affect */
 void r_particles_remove_spawner(r_particles* system);
 
-/* Remove an animator function from a particle system
+/* Remove an animator function (per particle or batch) from a particle system
  * system - the system to affect */
 void r_particles_remove_animator(r_particles* system);
 
 /* Update the simulation of the particles */
 void r_particles_update(r_particles* system, time_s delta);
 
+/* Update many particle systems at once on the context's worker threads (see
+ * r_ctx_set_threads), splitting large systems between them, & write the
+ * draw data of each system that calculates it, so r_particles_draw only has
+ * to send it
+ * ctx - the context with the workers & the camera to cull against
+ * systems - the array of particle systems
+ * count - the amount of systems
+ * delta - the time passed in milliseconds
+ * NOTE: Spawners & animators of different systems run at the same time, &
+ *       the animator of a large system runs on several threads at once, so
+ *       they shouldn't share state (use each system's rng) */
+void r_particles_update_many(r_ctx* ctx, r_particles* systems, uint32_t count,
+                             time_s delta);
+
 /* Destroy all resources for the particles
  * NOTE: This will not destroy the textures / anims & shaders used */
 void r_particles_destroy(r_particles* particles);
 
+/* Create the GL buffers for a GPU particle system
+ * ctx - the context to use the default quad of
+ * system - the particle system to follow, its spawn settings & timing are
+ *          read on each update
+ * update - a shader made with r_shader_create_feedback & the particle
+ *          varyings (see particles_gpu.vert)
+ * capacity - the amount of particles to hold, if more are alive at once
+ *            the oldest are replaced
+ * returns: the GPU particle system, fail = capacity of 0
+ * NOTE: system can be created with a capacity of 1, its particles aren't
+ *       simulated */
+r_particles_gpu r_particles_gpu_create(r_ctx* ctx, r_particles* system,
+                                       r_shader update, uint32_t capacity);
+
+/* Spawn the particles due over delta & advance every particle on the GPU
+ * delta - the time passed in milliseconds */
+void r_particles_gpu_update(r_ctx* ctx, r_particles_gpu* particles,
+                            time_s delta);
+
+/* Draw the particles with one instanced draw call
+ * shader - a shader made for the GPU particle state, i.e
+ *          particles_gpu_draw.vert & particles.frag */
+void r_particles_gpu_draw(r_ctx* ctx, r_particles_gpu* particles,
+                          r_shader shader);
+
+/* Destroy the GL buffers of a GPU particle system
+ * NOTE: This will not destroy the system followed or the shaders */
+void r_particles_gpu_destroy(r_particles_gpu* particles);
+
 /* Set a particle system's default particle animation
  * particles - the particle system to affect
  * anim - the animation to set as default */
@@ -894,7 +1392,18 @@ void r_sprite_set_color(r_sprite* sprite, vec4 color);
  * delta - the time since last update / frame */
 void r_sprite_update(r_sprite* sprite, long delta);
 
-/* Call for a sprite to be drawn in the next batch
+/* Update multiple sprites for drawing, on the context's worker threads
+ * ctx - the context to update the sprites with
+ * sprites - the list of sprites
+ * sprite_count - the number of sprites
+ * delta - the time since last update / frame */
+void r_sprites_update(r_ctx* ctx, r_sprite* sprites, uint32_t sprite_count,
+                      long delta);
+
+/* Queue a sprite to be drawn by the next r_ctx_draw
+ * NOTE: the sprite's state is copied, so changes after this call are drawn
+ *       next frame. Shaders that take r_instance_packed only get the model's
+ *       position, size & rotation, shearing & other transforms are dropped
  * ctx - the context to draw the sprite in
  * sprite - the sprite to draw */
 void r_sprite_draw_batch(r_ctx* ctx, r_sprite* sprite);
@@ -904,13 +1413,76 @@ void r_sprite_draw_batch(r_ctx* ctx, r_sprite* sprite);
  * sprite - the sprite to draw */
 void r_sprite_draw(r_ctx* ctx, r_sprite* sprite);
 
-/* Call for multiple sprites to be drawn
+/* Queue multiple sprites to be drawn by the next r_ctx_draw
+ * NOTE: each sprite can use its own sheet & shader, large lists are
+ *       prepared on the context's worker threads (see r_ctx_set_threads)
  * ctx - the context to draw the sprites in
  * sprites - the list of sprites
  * sprite_count - the number of sprites
- * returns: sprites drawn successfully */
+ * returns: sprites handled before the queue ran out of space */
 uint32_t r_sprites_draw(r_ctx* ctx, r_sprite* sprites, uint32_t sprite_count);
 
+/* Create a pool of sprites
+ * sheet - the sheet the sprites use
+ * shader - the shader to draw the sprites with
+ * capacity - the max amount of sprites in the pool
+ * returns: the pool, fail = zeroed struct */
+r_sprite_pool r_sprite_pool_create(r_sheet* sheet, r_shader shader,
+                                   uint32_t capacity);
+
+/* Free a pool's arrays
+ * NOTE: This will not destroy the sheet, anims & shader used */
+void r_sprite_pool_destroy(r_sprite_pool* pool);
+
+/* Add a sprite to a pool (visible, white)
+ * pool - the pool to add to
+ * position - the center of the sprite
+ * size - the size of the sprite
+ * layer - the layer to draw the sprite on
+ * tex - the subtexture of the sheet to draw
+ * returns: the index of the sprite, fail = -1 */
+int32_t r_sprite_pool_add(r_sprite_pool* pool, vec2 position, vec2 size,
+                          uint8_t layer, uint32_t tex);
+
+/* Remove a sprite from a pool
+ * NOTE: the last sprite in the pool is moved into its index */
+void r_sprite_pool_remove(r_sprite_pool* pool, uint32_t index);
+
+/* Set a pool sprite's center */
+void r_sprite_pool_set_pos(r_sprite_pool* pool, uint32_t index,
+                           vec2 position);
+
+/* Set a pool sprite's size */
+void r_sprite_pool_set_size(r_sprite_pool* pool, uint32_t index, vec2 size);
+
+/* Set a pool sprite's color */
+void r_sprite_pool_set_color(r_sprite_pool* pool, uint32_t index,
+                             vec4 color);
+
+/* Set a pool sprite's flags (r_sprite_pool_flag) */
+void r_sprite_pool_set_flags(r_sprite_pool* pool, uint32_t index,
+                             uint8_t flags);
+
+/* Set a pool sprite to a single subtexture, stopping any animation */
+void r_sprite_pool_set_tex(r_sprite_pool* pool, uint32_t index,
+                           uint32_t tex);
+
+/* Play an animation on a pool sprite from its first frame
+ * NOTE: the animation has to use the pool's sheet */
+void r_sprite_pool_set_anim(r_sprite_pool* pool, uint32_t index,
+                            r_anim* anim);
+
+/* Advance the animations of every sprite in a pool
+ * pool - the pool to update
+ * delta - the time since the last update (milliseconds) */
+void r_sprite_pool_update(r_sprite_pool* pool, time_s delta);
+
+/* Queue a pool's visible sprites to be drawn by the next r_ctx_draw
+ * ctx - the context to draw the sprites in
+ * pool - the pool to draw
+ * returns: the number of sprites queued */
+uint32_t r_sprite_pool_draw(r_ctx* ctx, r_sprite_pool* pool);
+
 /* Get the current state of a sprite's animation
  * sprite - the sprite to check
  * returns: 0 = STOPPED, 1 = PLAY, 2 = PAUSE */
@@ -970,6 +1542,23 @@ void r_camera_get_position(r_camera* camera, vec2 dst);
  * point - the point to center to */
 void r_camera_center_to(r_camera* camera, vec2 point);
 
+/* Get the area of the world a camera can see, grown to fit its rotation
+ * camera - the camera to check
+ * dst - the destination of the bounds (min x, min y, max x, max y) */
+void r_camera_get_bounds(r_camera* camera, vec4 dst);
+
+/* Test boxes against bounds (i.e from r_camera_get_bounds) in bulk
+ * NOTE: the arrays are separate so the test can be vectorized
+ * bounds - the area to test against (min x, min y, max x, max y)
+ * x, y - the center of each box
+ * half_w, half_h - half of the width & height of each box
+ * visible - the destination of each result (0 = outside, 1 = inside)
+ * count - the number of boxes
+ * returns: the number of boxes inside the bounds */
+uint32_t r_cull_boxes(vec4 bounds, const float* x, const float* y,
+                      const float* half_w, const float* half_h,
+                      uint8_t* visible, uint32_t count);
+
 /* Translate a point on screen to world space based on the camera
  * camera is the camera to translate the point from
  * point is the point within the camera [0,1] on each axis
@@ -990,16 +1579,29 @@ void r_camera_world_to_screen(vec2 dst, r_camera* camera, vec2 point);
 void r_camera_size_to_screen(vec2 dst, r_camera* camera, vec2 size);
 
 /* vert - the vertex shader program's data
- * frag - the fragment shader program's data */
+ * frag - the fragment shader program's data
+ * NOTE: the locations of the shader's uniforms are cached when it's created,
+ *       the r_set_* functions look them up there instead of asking OpenGL */
 r_shader r_shader_create(unsigned char* vert, unsigned char* frag);
 
+/* Create a vertex only shader that writes its outputs into buffers
+ * (transform feedback) instead of drawing
+ * vert - the vertex shader program's data
+ * varyings - the names of the outputs to write, in order (interleaved)
+ * count - the amount of varyings */
+r_shader r_shader_create_feedback(unsigned char* vert, const char** varyings,
+                                  uint32_t count);
+
 /* Get a shader from the context's map by name */
 r_shader r_shader_get(r_ctx* ctx, const char* name);
 
 /* Bind the shader in OpenGL
- * NOTE: r_shader is just typedefed uint32_t */
+ * NOTE: r_shader is just typedefed uint32_t, binding is skipped if it's
+ *       already bound in the current context */
 void r_shader_bind(r_shader shader);
-/* Destroy the OpenGL Shader & remove it from context */
+/* Destroy the OpenGL Shader & remove it from context
+ * NOTE: this also drops the shader's cached uniform locations, so shaders
+ *       should be deleted here rather than with glDeleteProgram */
 void r_shader_destroy(r_ctx* ctx, r_shader shader);
 /* Add a shader to the context's cache */
 void r_shader_cache(r_ctx* ctx, r_shader shader, const char* name);
@@ -1086,9 +1688,16 @@ void r_set_m4i(int loc, mat4x4 value);
  * NOTE: this does not bind the shader
  * shader - the shader to check
  * name - the name of the uniform
- * returns: the location of the uniform */
+ * returns: the location of the uniform (cached after the first lookup) */
 int r_get_loc(r_shader shader, const char* name);
 
+/* Get the location of one of astera's known uniforms in a shader, without
+ * hashing its name
+ * shader - the shader to check
+ * uniform - the uniform to get (r_uniform)
+ * returns: the location of the uniform, not in the shader = -1 */
+int r_get_uniform(r_shader shader, r_uniform uniform);
+
 /* Set a mat4 uniform array
  * NOTE: this does not bind the shader
  * shader - the shader to use
@@ -1,6 +1,5 @@
 // TODO:
 // - Multi iterator to parse duplicate keys
-// - Threading
 // - System Info
 
 /* MACROS:
@@ -53,6 +52,23 @@ typedef struct {
   time_s delta;
 } s_timer;
 
+/* A small random number generator (PCG32), each one is independent so it
+ * can be used without locking & replayed from the same seed
+ * state - the current position in the sequence
+ * inc - the sequence (stream) selected, always odd */
+typedef struct {
+  uint64_t state, inc;
+} s_rand;
+
+/* A job to be ran by a worker pool
+ * data - the user data pushed with the job */
+typedef void (*s_job_func)(void* data);
+
+/* Platform mutex & worker pool, defined in sys.c
+ * NOTE: Both are allocated by their create functions */
+typedef struct s_mutex s_mutex;
+typedef struct s_pool  s_pool;
+
 /* String based data input/output*/
 typedef struct {
   char *   data, *cursor;
@@ -148,6 +164,33 @@ s_timer s_timer_create();
    returns: time actually slept */
 time_s s_sleep(time_s duration);
 
+/* Create a random number generator
+   seed - the starting point, the same seed & stream give the same numbers
+   stream - which of the generator's sequences to use
+   returns: the seeded generator */
+s_rand s_rand_create(uint64_t seed, uint64_t stream);
+
+/* Get the next random number
+   rng - the generator to use
+   returns: a random number from 0 to UINT32_MAX */
+uint32_t s_rand_next(s_rand* rng);
+
+/* Get a random float within a range
+   rng - the generator to use
+   min - the lowest value
+   max - the highest value
+   returns: a random value from min to max */
+float s_rand_range(s_rand* rng, float min, float max);
+
+/* Fill an array with random floats within a range
+   rng - the generator to use
+   dst - the array to fill
+   count - the amount of values to write
+   min - the lowest value
+   max - the highest value */
+void s_rand_fill(s_rand* rng, float* dst, uint32_t count, float min,
+                 float max);
+
 /* Convert integer to String
    value - the value to convert to string
    string - the storage for the string
@@ -230,6 +273,61 @@ int s_buff_get_i(s_buffer_t* buffer);
  * return: the string value */
 char* s_buff_get_s(s_buffer_t* buffer, char* dst);
 
+/* Get the number of logical processors available
+ * returns: processor count, at least 1 */
+uint32_t s_cpu_count(void);
+
+/* Create a mutex
+ * returns: pointer to the mutex, fail = 0 */
+s_mutex* s_mutex_create(void);
+
+/* Destroy a mutex
+ * mutex - the mutex to destroy (must be unlocked) */
+void s_mutex_destroy(s_mutex* mutex);
+
+/* Lock a mutex, blocking until it's available
+ * mutex - the mutex to lock */
+void s_mutex_lock(s_mutex* mutex);
+
+/* Unlock a mutex
+ * mutex - the mutex to unlock */
+void s_mutex_unlock(s_mutex* mutex);
+
+/* Create a pool of worker threads
+ * thread_count - the number of threads to start, 0 = run jobs on push
+ * returns: pointer to the pool, fail = 0 */
+s_pool* s_pool_create(uint32_t thread_count);
+
+/* Finish all queued jobs & destroy the pool
+ * pool - the pool to destroy */
+void s_pool_destroy(s_pool* pool);
+
+/* Queue a job in the pool
+ * pool - the pool to queue the job in
+ * func - the function to run
+ * data - the data to pass to func
+ * priority - higher priority jobs are ran first, equal priority jobs are ran
+ *            in the order they're pushed
+ * returns: success = 1, fail = 0 */
+uint8_t s_pool_push(s_pool* pool, s_job_func func, void* data,
+                    int32_t priority);
+
+/* Block until all queued jobs in the pool have finished
+ * pool - the pool to wait on */
+void s_pool_wait(s_pool* pool);
+
+/* Block until one job has finished, a job that hasn't started yet is taken
+ * off the queue & ran on the calling thread instead
+ * pool - the pool the job was queued in
+ * data - the data the job was queued with (jobs are found by it)
+ * NOTE: a job that already finished returns right away */
+void s_pool_finish(s_pool* pool, void* data);
+
+/* Get the number of worker threads in the pool
+ * pool - the pool to check
+ * returns: thread count */
+uint32_t s_pool_thread_count(s_pool* pool);
+
 #ifdef __cplusplus
 }
 #endif
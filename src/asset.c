@@ -1,46 +1,52 @@
 #include <astera/asset.h>
 #include <astera/debug.h>
 
+// For the worker pool used by asset streaming
+#include <astera/sys.h>
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#define HAVE_WIN32_MMAP
+#define WIN32_LEAN_AND_MEAN
+#include <io.h>
+#include <windows.h>
+#elif defined(__linux__) || defined(__unix__) || defined(__FreeBSD__) || \
+    defined(__APPLE__)
+#define HAVE_POSIX_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #if !defined(alloca)
 #define alloca(x) __builtin_alloca(x)
 #endif
 
-static uint32_t fs_file_size(const char* fp) {
-  if (!fp) {
-    ASTERA_FUNC_DBG("no file path passed\n");
-    return 0;
-  }
-
-  FILE* f = fopen(fp, "r");
+#if !defined(HAVE_POSIX_MMAP) && !defined(HAVE_WIN32_MMAP)
+static unsigned char* fs_file_data(const char* path, uint32_t* size_ptr) {
+  FILE* f = fopen(path, "rb+");
 
   if (!f) {
-    ASTERA_FUNC_DBG("unable to open file %s\n", fp);
     return 0;
   }
 
   fseek(f, 0, SEEK_END);
-  uint32_t length = (uint32_t)ftell(f);
-  fclose(f);
-
-  return length;
-}
-
-static unsigned char* fs_file_data(const char* path, uint32_t* size_ptr) {
-  FILE* f = fopen(path, "rb+");
+  long end = ftell(f);
+  rewind(f);
 
-  if (!f) {
+  // Paks address their data with 32 bits
+  if (end < 0 || (uint64_t)end > UINT32_MAX) {
+    ASTERA_FUNC_DBG("unable to size %s, or it's over 4 GiB\n", path);
+    fclose(f);
     return 0;
   }
 
-  uint32_t data_length = 0;
-
-  fseek(f, 0, SEEK_END);
-  data_length = ftell(f);
-  rewind(f);
+  uint32_t data_length = (uint32_t)end;
 
   unsigned char* data = (unsigned char*)malloc(sizeof(char) * data_length);
 
@@ -63,6 +69,369 @@ static unsigned char* fs_file_data(const char* path, uint32_t* size_ptr) {
 
   return data;
 }
+#endif
+
+/* LZ4 block format codec used for compressed pak entries
+ * Each sequence is: token (literal length << 4 | match length - 4), literal
+ * length bytes, literals, 16-bit match offset, match length bytes. The last
+ * sequence is literals only */
+#define PAK_LZ4_MIN_MATCH     4
+#define PAK_LZ4_LAST_LITERALS 5
+#define PAK_LZ4_MF_LIMIT      12
+#define PAK_LZ4_MAX_OFFSET    65535
+#define PAK_LZ4_HASH_BITS     16
+
+// Flag on the size of a chunked entry's block if it's stored uncompressed
+#define PAK_CHUNK_RAW 0x80000000u
+
+static uint32_t pak_lz4_decompress(const unsigned char* src, uint32_t src_size,
+                                   unsigned char* dst, uint32_t dst_size) {
+  const unsigned char* ip   = src;
+  const unsigned char* iend = src + src_size;
+  unsigned char*       op   = dst;
+  unsigned char*       oend = dst + dst_size;
+
+  while (ip < iend) {
+    uint32_t token   = *ip++;
+    uint32_t literal = token >> 4;
+
+    if (literal == 15) {
+      uint32_t b = 255;
+      while (b == 255) {
+        if (ip >= iend) {
+          return 0;
+        }
+        b = *ip++;
+        literal += b;
+      }
+    }
+
+    if (literal > (uint32_t)(iend - ip) || literal > (uint32_t)(oend - op)) {
+      return 0;
+    }
+
+    memcpy(op, ip, literal);
+    op += literal;
+    ip += literal;
+
+    // The last sequence only contains literals
+    if (ip >= iend) {
+      break;
+    }
+
+    if (iend - ip < 2) {
+      return 0;
+    }
+
+    uint32_t offset = (uint32_t)ip[0] | ((uint32_t)ip[1] << 8);
+    ip += 2;
+
+    if (!offset || offset > (uint32_t)(op - dst)) {
+      return 0;
+    }
+
+    uint32_t match = token & 15;
+    if (match == 15) {
+      uint32_t b = 255;
+      while (b == 255) {
+        if (ip >= iend) {
+          return 0;
+        }
+        b = *ip++;
+        match += b;
+      }
+    }
+    match += PAK_LZ4_MIN_MATCH;
+
+    if (match > (uint32_t)(oend - op)) {
+      return 0;
+    }
+
+    // Matches can overlap the output, in which case copy byte by byte
+    const unsigned char* copy = op - offset;
+    if (offset >= match) {
+      memcpy(op, copy, match);
+    } else {
+      for (uint32_t i = 0; i < match; ++i) {
+        op[i] = copy[i];
+      }
+    }
+    op += match;
+  }
+
+  return (uint32_t)(op - dst);
+}
+
+#if defined(ASTERA_PAK_WRITE)
+static uint32_t pak_lz4_bound(uint32_t size) {
+  return size + (size / 255) + 16;
+}
+
+static uint32_t pak_lz4_read32(const unsigned char* ptr) {
+  uint32_t value;
+  memcpy(&value, ptr, sizeof(uint32_t));
+  return value;
+}
+
+static uint32_t pak_lz4_hash(uint32_t value) {
+  return (value * 2654435761u) >> (32 - PAK_LZ4_HASH_BITS);
+}
+
+static unsigned char* pak_lz4_write_length(unsigned char* op,
+                                           uint32_t       length) {
+  while (length >= 255) {
+    *op++ = 255;
+    length -= 255;
+  }
+  *op++ = (unsigned char)length;
+  return op;
+}
+
+/* Compress data into the LZ4 block format
+ * level - 1 only checks the last position with the same hash, higher levels
+ *         search a chain of (1 << level) previous positions
+ * returns: compressed size, fail = 0 */
+static uint32_t pak_lz4_compress(const unsigned char* src, uint32_t src_size,
+                                 unsigned char* dst, uint32_t dst_cap,
+                                 uint8_t level) {
+  // Positions are stored + 1 so that 0 can mean empty
+  uint32_t* head = (uint32_t*)calloc(1 << PAK_LZ4_HASH_BITS, sizeof(uint32_t));
+  uint32_t* chain = 0;
+  uint32_t  depth = 1;
+
+  if (!head) {
+    return 0;
+  }
+
+  if (level > 1) {
+    depth = 1u << ((level > 12) ? 12 : level);
+    chain = (uint32_t*)malloc(sizeof(uint32_t) * (src_size + 1));
+
+    if (!chain) {
+      free(head);
+      return 0;
+    }
+  }
+
+  const unsigned char* ip     = src;
+  const unsigned char* anchor = src;
+  const unsigned char* iend   = src + src_size;
+  unsigned char*       op     = dst;
+  unsigned char*       oend   = dst + dst_cap;
+
+  if (src_size > PAK_LZ4_MF_LIMIT) {
+    const unsigned char* mflimit    = iend - PAK_LZ4_MF_LIMIT;
+    const unsigned char* matchlimit = iend - PAK_LZ4_LAST_LITERALS;
+
+    while (ip < mflimit) {
+      uint32_t pos      = (uint32_t)(ip - src);
+      uint32_t hash     = pak_lz4_hash(pak_lz4_read32(ip));
+      uint32_t best_len = 0, best_pos = 0;
+
+      uint32_t candidate = head[hash];
+      for (uint32_t probes = 0; candidate && probes < depth; ++probes) {
+        uint32_t cpos = candidate - 1;
+
+        if (pos - cpos > PAK_LZ4_MAX_OFFSET) {
+          break;
+        }
+
+        if (pak_lz4_read32(src + cpos) == pak_lz4_read32(ip)) {
+          uint32_t length = PAK_LZ4_MIN_MATCH;
+          while (ip + length < matchlimit && src[cpos + length] == ip[length]) {
+            ++length;
+          }
+
+          if (length > best_len) {
+            best_len = length;
+            best_pos = cpos;
+          }
+        }
+
+        if (!chain) {
+          break;
+        }
+
+        candidate = chain[cpos];
+      }
+
+      if (chain) {
+        chain[pos] = head[hash];
+      }
+      head[hash] = pos + 1;
+
+      if (best_len < PAK_LZ4_MIN_MATCH) {
+        ++ip;
+        continue;
+      }
+
+      uint32_t literal = (uint32_t)(ip - anchor);
+      uint32_t match   = best_len - PAK_LZ4_MIN_MATCH;
+
+      // token + literal lengths + literals + offset + match lengths
+      if ((uint32_t)(oend - op) <
+          1 + (literal / 255) + 1 + literal + 2 + (match / 255) + 1) {
+        free(head);
+        free(chain);
+        return 0;
+      }
+
+      unsigned char* token = op++;
+      *token = (unsigned char)(((literal < 15) ? literal : 15) << 4 |
+                               ((match < 15) ? match : 15));
+
+      if (literal >= 15) {
+        op = pak_lz4_write_length(op, literal - 15);
+      }
+
+      memcpy(op, anchor, literal);
+      op += literal;
+
+      uint32_t offset = pos - best_pos;
+      *op++           = (unsigned char)(offset & 0xFF);
+      *op++           = (unsigned char)(offset >> 8);
+
+      if (match >= 15) {
+        op = pak_lz4_write_length(op, match - 15);
+      }
+
+      // Keep the chain complete for the positions covered by the match
+      if (chain) {
+        for (uint32_t i = pos + 1; i < pos + best_len && src + i < mflimit;
+             ++i) {
+          uint32_t h = pak_lz4_hash(pak_lz4_read32(src + i));
+          chain[i]   = head[h];
+          head[h]    = i + 1;
+        }
+      }
+
+      ip += best_len;
+      anchor = ip;
+    }
+  }
+
+  uint32_t literal = (uint32_t)(iend - anchor);
+
+  if ((uint32_t)(oend - op) < 1 + (literal / 255) + 1 + literal) {
+    free(head);
+    free(chain);
+    return 0;
+  }
+
+  unsigned char* token = op++;
+  *token = (unsigned char)(((literal < 15) ? literal : 15) << 4);
+
+  if (literal >= 15) {
+    op = pak_lz4_write_length(op, literal - 15);
+  }
+
+  memcpy(op, anchor, literal);
+  op += literal;
+
+  free(head);
+  free(chain);
+
+  return (uint32_t)(op - dst);
+}
+#endif
+
+static int pak_hash_cmp(const void* a, const void* b) {
+  const pak_hash_t* ha = (const pak_hash_t*)a;
+  const pak_hash_t* hb = (const pak_hash_t*)b;
+
+  if (ha->hash != hb->hash) {
+    return (ha->hash < hb->hash) ? -1 : 1;
+  }
+
+  return (ha->index < hb->index) ? -1 : (ha->index > hb->index);
+}
+
+// Create the sorted name hash table for the entries of a pak
+static pak_hash_t* pak_hashes_create(const pak_file_t* files, uint32_t count) {
+  pak_hash_t* hashes = (pak_hash_t*)calloc(count, sizeof(pak_hash_t));
+
+  if (!hashes) {
+    ASTERA_FUNC_DBG("unable to allocate space for %i hashes\n", count);
+    return 0;
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    hashes[i] = (pak_hash_t){.hash = pak_name_hash(files[i].name), .index = i};
+  }
+
+  qsort(hashes, count, sizeof(pak_hash_t), pak_hash_cmp);
+
+  return hashes;
+}
+
+/* Check a hash table read from a pak points only at its entries
+ * returns: valid = 1, invalid = 0 */
+static uint8_t pak_hashes_valid(const pak_hash_t* hashes, uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    if (hashes[i].index >= count) {
+      ASTERA_FUNC_DBG("hash %i points past the entries (%i)\n", i,
+                      hashes[i].index);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/* Check the data of every entry lies within a pak's data
+ * length - the size of the pak's data (bytes)
+ * returns: valid = 1, invalid = 0 */
+static uint8_t pak_entries_valid(const pak_file_t* files, uint32_t count,
+                                 uint32_t length) {
+  for (uint32_t i = 0; i < count; ++i) {
+    if ((uint64_t)files[i].offset + files[i].size > length) {
+      ASTERA_FUNC_DBG("entry %i extends past the end of the data\n", i);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/* Parse the header(s) at the start of a pak file
+ * data - the start of the pak file
+ * length - the amount of bytes available in data
+ * header - the header to fill out
+ * ext - the extended header to fill out (version 1 if legacy)
+ * returns: offset of the entries, fail = 0 */
+static uint32_t pak_parse_header(const unsigned char* data, uint32_t length,
+                                 pak_header_t* header, pak_header_ext_t* ext) {
+  if (length < sizeof(pak_header_t)) {
+    ASTERA_FUNC_DBG("not enough data for pak header\n");
+    return 0;
+  }
+
+  memcpy(header, data, sizeof(pak_header_t));
+
+  if (!memcmp(header->id, ASTERA_PAK_ID_LEGACY, 4)) {
+    *ext = (pak_header_ext_t){.version = 1, 0};
+    return sizeof(pak_header_t);
+  }
+
+  if (memcmp(header->id, ASTERA_PAK_ID_EXTENDED, 4)) {
+    ASTERA_FUNC_DBG("invalid pak file format\n");
+    return 0;
+  }
+
+  if (length < sizeof(pak_header_t) + sizeof(pak_header_ext_t)) {
+    ASTERA_FUNC_DBG("not enough data for extended pak header\n");
+    return 0;
+  }
+
+  memcpy(ext, data + sizeof(pak_header_t), sizeof(pak_header_ext_t));
+
+  if (ext->version < 2 || ext->version > ASTERA_PAK_VERSION) {
+    ASTERA_FUNC_DBG("unsupported pak version %i\n", ext->version);
+    return 0;
+  }
+
+  return sizeof(pak_header_t) + sizeof(pak_header_ext_t);
+}
 
 #if defined(ASTERA_PAK_WRITE)
 
@@ -85,6 +454,52 @@ void pak_write_destroy(pak_write_t* write) {
   free(write);
 }
 
+void pak_write_set_codec(pak_write_t* write, uint8_t codec, uint8_t level) {
+  if (!write) {
+    return;
+  }
+
+  // Chunking is decided per file when it's written
+  write->codec = (codec == PAK_CODEC_LZ4_CHUNKED) ? PAK_CODEC_LZ4 : codec;
+  write->level = (level == 0) ? 1 : (level > 9) ? 9 : level;
+}
+
+void pak_write_set_threads(pak_write_t* write, uint32_t threads) {
+  if (!write) {
+    return;
+  }
+
+  write->threads = threads;
+}
+
+/* Get the size & last modification time of a file without opening it
+ * size - set to the size in bytes [OPTIONAL]
+ * mtime - set to the last modification time [OPTIONAL]
+ * returns: success = 1, fail (or size wanted & over 4 GiB) = 0 */
+static uint8_t fs_file_stat(const char* fp, uint32_t* size, int64_t* mtime) {
+  struct stat st;
+
+  if (!fp || stat(fp, &st) != 0) {
+    ASTERA_FUNC_DBG("unable to stat file %s\n", fp ? fp : "(null)");
+    return 0;
+  }
+
+  if (size && (uint64_t)st.st_size > UINT32_MAX) {
+    ASTERA_FUNC_DBG("file %s is over 4 GiB\n", fp);
+    return 0;
+  }
+
+  if (size) {
+    *size = (uint32_t)st.st_size;
+  }
+
+  if (mtime) {
+    *mtime = (int64_t)st.st_mtime;
+  }
+
+  return 1;
+}
+
 static uint8_t __write_contains(pak_write_t* write, const char* name) {
   for (uint32_t i = 0; i < write->count; ++i) {
     if (!strcmp(write->files[i].name, name)) {
@@ -104,9 +519,9 @@ uint8_t pak_write_add_file(pak_write_t* write, const char* file,
     return 0;
   }
 
-  uint32_t size = fs_file_size(file);
+  uint32_t size = 0;
 
-  if (size == 0) {
+  if (!fs_file_stat(file, &size, 0) || size == 0) {
     return 0;
   }
 
@@ -114,6 +529,8 @@ uint8_t pak_write_add_file(pak_write_t* write, const char* file,
       .data.filepath = file,
       .size          = size,
       .is_mem        = 0,
+      .codec         = write->codec,
+      .level         = write->level,
   };
 
   snprintf(wfile.name, 55, "%s", name);
@@ -146,6 +563,8 @@ uint8_t pak_write_add_mem(pak_write_t* write, const unsigned char* data,
       .data.ptr = data,
       .size     = size,
       .is_mem   = 1,
+      .codec    = write->codec,
+      .level    = write->level,
   };
 
   snprintf(wfile.name, 55, "%s", name);
@@ -158,117 +577,846 @@ uint8_t pak_write_add_mem(pak_write_t* write, const unsigned char* data,
   return 1;
 }
 
-uint8_t pak_write_to_file(pak_write_t* write) {
+void pak_write_set_base(pak_write_t* write, const char* base) {
   if (!write) {
-    ASTERA_FUNC_DBG("no write structure passed.\n");
-    return 0;
+    return;
   }
 
-  uint32_t header_offset =
-      sizeof(pak_header_t) + ((sizeof(pak_file_t) * write->count));
-  uint32_t offset = header_offset;
+  write->base = base;
+}
 
-  FILE* f = fopen(write->filepath, "wb+");
+/* Find a file's stored data in the base pak, if it's unchanged
+ * base_mtime - the last modification time of the base pak
+ * returns: the index of the entry in the base, not reusable = -1 */
+static int32_t pak_write_find_base(pak_wfile_t* wfile, pak_t* base,
+                                   int64_t base_mtime) {
+  int32_t index = pak_find(base, wfile->name);
 
-  if (!f) {
-    ASTERA_FUNC_DBG("unable to open file %s to write.\n", write->filepath);
-    return 0;
+  if (index == -1 || pak_size(base, index) != wfile->size) {
+    return -1;
   }
 
-  for (uint32_t i = 0; i < write->count; ++i) {
-    write->files[i].offset = offset;
-    offset += write->files[i].size;
+  // Files the base tried to compress may still be stored uncompressed
+  if (((base->exts[index].codec >> 8) & 0xFF) != wfile->codec) {
+    return -1;
   }
 
-  pak_header_t header = (pak_header_t){.id = "PACK", .count = write->count};
+  if (wfile->is_mem) {
+    uint32_t checksum = ASTERA_HASH_INITIAL;
+    asset_fnv1a_hash(&checksum, wfile->data.ptr, wfile->size);
 
-  fwrite("PACK", 1, 4, f);
-  fwrite(&header.count, 1, sizeof(uint32_t), f);
-
-  for (uint32_t i = 0; i < header.count; ++i) {
-    pak_wfile_t* wfile = &write->files[i];
+    if (checksum != pak_checksum(base, index)) {
+      return -1;
+    }
+  } else {
+    // Files touched in the same second as the base can't be trusted
+    int64_t mtime = 0;
 
-    fwrite(wfile->name, 1, 56, f);
-    fwrite(&wfile->offset, 1, sizeof(uint32_t), f);
-    fwrite(&wfile->size, 1, sizeof(uint32_t), f);
+    if (!fs_file_stat(wfile->data.filepath, 0, &mtime) || !base_mtime ||
+        mtime >= base_mtime) {
+      return -1;
+    }
   }
 
-  for (uint32_t i = 0; i < header.count; ++i) {
-    pak_wfile_t*   wfile     = &write->files[i];
-    unsigned char* file_data = 0;
-    if (wfile->is_mem) {
-      file_data = wfile->data.ptr;
-    } else {
-      file_data = fs_file_data(wfile->data.filepath, 0);
-    }
+  wfile->checksum = pak_checksum(base, index);
+  return index;
+}
 
-    fwrite(file_data, sizeof(unsigned char), wfile->size, f);
+// The state of each file while a pak is written
+typedef struct {
+  pak_wfile_t* wfile;
+
+  /* base - the entry in the base pak to copy the stored data of, none = -1
+   * shared - the earlier file with the same data, none = -1 */
+  int32_t base, shared;
+
+  // f - the file's source while its chunks are compressed, shared by them
+  FILE* f;
+
+  // ok - if the file's data could be read
+  uint8_t ok;
+} pak_write_state_t;
+
+// A chunk of a file compressed by the write pool
+typedef struct {
+  pak_write_state_t* state;
+  uint32_t           start, length;
+
+  // lock - taken to read from the state's shared source
+  s_mutex* lock;
+
+  /* raw - the chunk's data, in place for files in memory
+   * buffer - space the chunk is read into for files on disk
+   * NOTE: buffer & out belong to the window slot & are reused by each chunk
+   *       the slot is handed */
+  const unsigned char* raw;
+  unsigned char*       buffer;
+
+  // out - the compressed chunk, out_size - 0 if it should be stored raw
+  unsigned char* out;
+  uint32_t       out_size;
+
+  double  time;
+  uint8_t ok;
+} pak_write_job_t;
+
+// Everything the writing thread needs to put data in the pak
+typedef struct {
+  FILE*           f;
+  pak_file_ext_t* exts;
+
+  // buffer - a chunk for data copied by the writing thread
+  unsigned char* buffer;
+
+  /* offset - where the next data is written
+   * end - the furthest data was written, if more than offset
+   * NOTE: kept in 64 bits to catch data going past the 32 bit offsets */
+  uint64_t offset, end;
+  uint8_t  ok;
+} pak_write_ctx_t;
+
+// returns: the source of a file on disk, in memory or fail = 0
+static FILE* pak_wfile_open(pak_wfile_t* wfile) {
+  return wfile->is_mem ? 0 : fopen(wfile->data.filepath, "rb");
+}
 
-    if (!wfile->is_mem)
-      free(file_data);
+/* Read part of a file's data, in place for files in memory
+ * f - the file's source (pak_wfile_open)
+ * buffer - space for length bytes
+ * returns: pointer to the data, fail = 0 */
+static const unsigned char* pak_wfile_read(pak_wfile_t* wfile, FILE* f,
+                                           uint32_t start, uint32_t length,
+                                           unsigned char* buffer) {
+  if (wfile->is_mem) {
+    return (const unsigned char*)wfile->data.ptr + start;
   }
 
-  fclose(f);
+  if (!f || !buffer || fseek(f, start, SEEK_SET) != 0 ||
+      fread(buffer, sizeof(unsigned char), length, f) != length) {
+    return 0;
+  }
 
-  return 1;
+  return buffer;
 }
 
-#endif
+// returns: the size of the chunk starting at done
+static uint32_t pak_chunk_length(uint32_t size, uint32_t done) {
+  uint32_t length = size - done;
+  return (length > ASTERA_PAK_CHUNK_SIZE) ? ASTERA_PAK_CHUNK_SIZE : length;
+}
 
-pak_t* pak_open_file(const char* file) {
-  FILE* f = fopen(file, "rb+");
+// Hash a file's data a chunk at a time (pak_write_state_t)
+static void pak_write_hash_job(void* data) {
+  pak_write_state_t* state = (pak_write_state_t*)data;
+  pak_wfile_t*       wfile = state->wfile;
+  time_s             start = s_get_time();
 
-  if (!f) {
-    ASTERA_FUNC_DBG("unable to open file %s\n", file);
-    return 0;
+  FILE*          f      = pak_wfile_open(wfile);
+  unsigned char* buffer = 0;
+
+  if (!wfile->is_mem) {
+    buffer = (unsigned char*)malloc(ASTERA_PAK_CHUNK_SIZE);
   }
 
-  pak_header_t header = {0};
-  fread(&header, 1, sizeof(pak_header_t), f);
+  wfile->checksum = ASTERA_HASH_INITIAL;
+  state->ok       = 1;
 
-  if (strncmp(header.id, "PACK", 4)) {
-    ASTERA_FUNC_DBG("invalid pak file format %s\n", file);
-    fclose(f);
-    return 0;
+  for (uint32_t done = 0; done < wfile->size;) {
+    uint32_t             length = pak_chunk_length(wfile->size, done);
+    const unsigned char* chunk =
+        pak_wfile_read(wfile, f, done, length, buffer);
+
+    if (!chunk) {
+      state->ok = 0;
+      break;
+    }
+
+    asset_fnv1a_hash(&wfile->checksum, chunk, length);
+    done += length;
   }
 
-  if (header.count == 0) {
-    ASTERA_FUNC_DBG("empty pak file %s\n", file);
+  free(buffer);
+
+  if (f)
     fclose(f);
+
+  wfile->time += (double)(s_get_time() - start);
+}
+
+/* Compare the data of two files a chunk at a time
+ * returns: same = 1, different or fail = 0 */
+static uint8_t pak_write_same_data(pak_wfile_t* a, pak_wfile_t* b,
+                                   unsigned char* buffer_a,
+                                   unsigned char* buffer_b) {
+  if (a->size != b->size) {
     return 0;
   }
 
-  pak_t* pak = (pak_t*)calloc(1, sizeof(pak_t));
+  FILE*   fa   = pak_wfile_open(a);
+  FILE*   fb   = pak_wfile_open(b);
+  uint8_t same = 1;
 
-  if (!pak) {
-    ASTERA_FUNC_DBG("unable to alloc pak_t\n");
-    fclose(f);
-    return 0;
+  for (uint32_t done = 0; same && done < a->size;) {
+    uint32_t             length = pak_chunk_length(a->size, done);
+    const unsigned char* data_a =
+        pak_wfile_read(a, fa, done, length, buffer_a);
+    const unsigned char* data_b =
+        pak_wfile_read(b, fb, done, length, buffer_b);
+
+    same = data_a && data_b && !memcmp(data_a, data_b, length);
+    done += length;
   }
 
-  pak->count         = header.count;
-  pak->data.filepath = file;
+  if (fa)
+    fclose(fa);
+  if (fb)
+    fclose(fb);
 
-  // Seek to the end of the header size (start of entries)
-  fseek(f, sizeof(pak_header_t), SEEK_SET);
+  return same;
+}
 
-  pak->files = (pak_file_t*)calloc(header.count, sizeof(pak_file_t));
+// Read & compress a chunk of a file (pak_write_job_t)
+static void pak_write_chunk_job(void* data) {
+  pak_write_job_t*   job   = (pak_write_job_t*)data;
+  pak_write_state_t* state = job->state;
+  pak_wfile_t*       wfile = state->wfile;
+  time_s             start = s_get_time();
 
-  if (!pak->files) {
-    ASTERA_FUNC_DBG("unable to allocate space for entries\n");
-    free(pak);
-    return 0;
+  // Chunks of a file share its source, so reads take turns
+  if (!wfile->is_mem) {
+    s_mutex_lock(job->lock);
   }
 
-  if (fread(pak->files, header.count, sizeof(pak_file_t), f) !=
-      sizeof(pak_file_t)) {
-    ASTERA_FUNC_DBG("invalid read of entries: %s\n", file);
-    fclose(f);
-    free(pak->files);
-    free(pak);
-    return 0;
+  job->raw =
+      pak_wfile_read(wfile, state->f, job->start, job->length, job->buffer);
+
+  if (!wfile->is_mem) {
+    s_mutex_unlock(job->lock);
   }
 
+  job->ok       = job->raw != 0;
+  job->out_size = 0;
+
+  if (job->ok) {
+    uint32_t size = pak_lz4_compress(job->raw, job->length, job->out,
+                                     pak_lz4_bound(job->length), wfile->level);
+
+    // Only keep the compressed data if it's actually smaller
+    job->out_size = (size && size < job->length) ? size : 0;
+  }
+
+  job->time = (double)(s_get_time() - start);
+}
+
+/* Copy a file's data into the pak uncompressed, a chunk at a time
+ * returns: success = 1, fail = 0 */
+static uint8_t pak_write_copy_raw(pak_write_ctx_t* ctx, pak_wfile_t* wfile) {
+  FILE*   src = pak_wfile_open(wfile);
+  uint8_t ok  = 1;
+
+  for (uint32_t done = 0; ok && done < wfile->size;) {
+    uint32_t             length = pak_chunk_length(wfile->size, done);
+    const unsigned char* chunk =
+        pak_wfile_read(wfile, src, done, length, ctx->buffer);
+
+    ok = chunk && fwrite(chunk, sizeof(unsigned char), length, ctx->f) ==
+                      length;
+    done += length;
+  }
+
+  if (src)
+    fclose(src);
+
+  return ok;
+}
+
+/* Copy an entry's stored data out of the base pak, a chunk at a time
+ * returns: success = 1, fail = 0 */
+static uint8_t pak_write_copy_base(pak_write_ctx_t* ctx, pak_t* base,
+                                   FILE* base_f, uint32_t index) {
+  uint32_t stored_size = pak_stored_size(base, index);
+  uint8_t  ok = fseek(base_f, pak_offset(base, index), SEEK_SET) == 0;
+
+  for (uint32_t done = 0; ok && done < stored_size;) {
+    uint32_t length = pak_chunk_length(stored_size, done);
+
+    ok = fread(ctx->buffer, sizeof(unsigned char), length, base_f) ==
+             length &&
+         fwrite(ctx->buffer, sizeof(unsigned char), length, ctx->f) == length;
+    done += length;
+  }
+
+  return ok;
+}
+
+/* Check an entry's data still fits in the 32 bit offsets of the format
+ * returns: fits = 1, too big = 0 */
+static uint8_t pak_write_fits(pak_write_ctx_t* ctx, pak_wfile_t* wfile,
+                              uint64_t size) {
+  (void)wfile; // only named in debug output
+
+  if (ctx->offset + size > UINT32_MAX) {
+    ASTERA_FUNC_DBG("%s ends past 4 GiB, the most a pak can address.\n",
+                    wfile->name);
+    return 0;
+  }
+
+  return 1;
+}
+
+// Cut the file being written down to size, trailing data is never read
+static void pak_write_truncate(FILE* f, uint32_t size) {
+  fflush(f);
+#if defined(_WIN32) || defined(_WIN64)
+  _chsize_s(_fileno(f), size);
+#elif defined(HAVE_POSIX_MMAP)
+  if (ftruncate(fileno(f), size) != 0) {
+    ASTERA_FUNC_DBG("unable to truncate pak to %u bytes\n", size);
+  }
+#else
+  (void)size;
+#endif
+}
+
+/* Set the codec an entry ended up stored with, storing it raw if the
+ * compressed chunks were no smaller
+ * returns: success = 1, fail = 0 */
+static uint8_t pak_write_finish(pak_write_ctx_t* ctx, pak_wfile_t* wfile,
+                                uint8_t codec) {
+  if (codec == PAK_CODEC_LZ4_CHUNKED && wfile->stored_size >= wfile->size) {
+    if (ctx->offset > ctx->end) {
+      ctx->end = ctx->offset;
+    }
+
+    if (fseek(ctx->f, wfile->offset, SEEK_SET) != 0 ||
+        !pak_write_copy_raw(ctx, wfile)) {
+      return 0;
+    }
+
+    codec              = PAK_CODEC_NONE;
+    wfile->stored_size = wfile->size;
+    ctx->offset        = (uint64_t)wfile->offset + wfile->size;
+  }
+
+  ctx->exts[wfile->index] = (pak_file_ext_t){
+      .codec = codec | (wfile->codec << 8), .raw_size = wfile->size};
+  return 1;
+}
+
+/* Compress a window of chunks on the pool, then write them out in order
+ * returns: success = 1, fail = 0 */
+static uint8_t pak_write_flush(pak_write_ctx_t* ctx, s_pool* pool,
+                               pak_write_job_t* jobs, uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!s_pool_push(pool, pak_write_chunk_job, &jobs[i], 0)) {
+      pak_write_chunk_job(&jobs[i]);
+    }
+  }
+
+  s_pool_wait(pool);
+
+  for (uint32_t i = 0; i < count; ++i) {
+    pak_write_job_t* job     = &jobs[i];
+    pak_wfile_t*     wfile   = job->state->wfile;
+    uint8_t          chunked = wfile->size > ASTERA_PAK_CHUNK_SIZE;
+    time_s           start   = s_get_time();
+
+    if (job->start == 0) {
+      wfile->offset      = (uint32_t)ctx->offset;
+      wfile->stored_size = 0;
+    }
+
+    ctx->ok = ctx->ok && job->ok;
+
+    const unsigned char* stored = job->out_size ? job->out : job->raw;
+    uint32_t stored_size = job->out_size ? job->out_size : job->length;
+
+    ctx->ok = ctx->ok &&
+              pak_write_fits(ctx, wfile,
+                             stored_size + (chunked ? sizeof(uint32_t) : 0));
+
+    // Chunks of big files are prefixed with their size
+    if (ctx->ok && chunked) {
+      uint32_t prefix =
+          job->out_size ? job->out_size : (job->length | PAK_CHUNK_RAW);
+
+      ctx->ok = fwrite(&prefix, sizeof(uint32_t), 1, ctx->f) == 1;
+      wfile->stored_size += sizeof(uint32_t);
+      ctx->offset += sizeof(uint32_t);
+    }
+
+    if (ctx->ok) {
+      ctx->ok = fwrite(stored, sizeof(unsigned char), stored_size, ctx->f) ==
+                stored_size;
+      wfile->stored_size += stored_size;
+      ctx->offset += stored_size;
+    }
+
+    if (ctx->ok && job->start + job->length == wfile->size) {
+      uint8_t codec = chunked          ? PAK_CODEC_LZ4_CHUNKED
+                      : job->out_size ? PAK_CODEC_LZ4
+                                      : PAK_CODEC_NONE;
+      ctx->ok       = pak_write_finish(ctx, wfile, codec);
+    }
+
+    // Nothing reads the source after the file's last chunk
+    if (job->start + job->length == wfile->size && job->state->f) {
+      fclose(job->state->f);
+      job->state->f = 0;
+    }
+
+    wfile->time += job->time + (double)(s_get_time() - start);
+  }
+
+  return ctx->ok;
+}
+
+uint8_t pak_write_to_file(pak_write_t* write) {
+  if (!write) {
+    ASTERA_FUNC_DBG("no write structure passed.\n");
+    return 0;
+  }
+
+  uint32_t entries_offset = sizeof(pak_header_t) + sizeof(pak_header_ext_t);
+  uint32_t hash_offset = entries_offset + (sizeof(pak_file_t) * write->count);
+  uint32_t ext_offset  = hash_offset + (sizeof(pak_hash_t) * write->count);
+  uint32_t checksum_offset =
+      ext_offset + (sizeof(pak_file_ext_t) * write->count);
+  uint32_t data_offset = checksum_offset + (sizeof(uint32_t) * write->count);
+
+  if (write->base && !strcmp(write->base, write->filepath)) {
+    ASTERA_FUNC_DBG("base pak can't be the file being written.\n");
+    return 0;
+  }
+
+  FILE* f = fopen(write->filepath, "wb+");
+
+  if (!f) {
+    ASTERA_FUNC_DBG("unable to open file %s to write.\n", write->filepath);
+    return 0;
+  }
+
+  // Only bases with checksums can share data with the new files
+  pak_t*  base       = write->base ? pak_open_file(write->base) : 0;
+  FILE*   base_f     = 0;
+  int64_t base_mtime = 0;
+
+  if (base && base->version >= 4) {
+    base_f = fopen(write->base, "rb");
+    fs_file_stat(write->base, 0, &base_mtime);
+  }
+
+  uint32_t share_capacity = 8;
+  while (share_capacity < write->count * 2) {
+    share_capacity <<= 1;
+  }
+
+  // Keep every thread busy while the window's chunks are written out
+  uint32_t window = write->threads ? write->threads * 2 : 1;
+  uint32_t count  = write->count ? write->count : 1;
+
+  pak_hash_t* hashes = (pak_hash_t*)calloc(count, sizeof(pak_hash_t));
+  pak_file_ext_t* exts =
+      (pak_file_ext_t*)calloc(count, sizeof(pak_file_ext_t));
+  uint32_t* checksums = (uint32_t*)calloc(count, sizeof(uint32_t));
+  uint32_t* shares    = (uint32_t*)calloc(share_capacity, sizeof(uint32_t));
+  pak_write_state_t* states =
+      (pak_write_state_t*)calloc(count, sizeof(pak_write_state_t));
+  pak_write_job_t* jobs =
+      (pak_write_job_t*)calloc(window, sizeof(pak_write_job_t));
+  unsigned char* compare = (unsigned char*)malloc(ASTERA_PAK_CHUNK_SIZE);
+  s_pool*        pool    = s_pool_create(write->threads);
+  s_mutex*       lock    = s_mutex_create();
+
+  // Each window slot keeps its buffers for every chunk it's handed
+  uint8_t slots = jobs != 0;
+  for (uint32_t i = 0; slots && i < window; ++i) {
+    jobs[i].buffer = (unsigned char*)malloc(ASTERA_PAK_CHUNK_SIZE);
+    jobs[i].out =
+        (unsigned char*)malloc(pak_lz4_bound(ASTERA_PAK_CHUNK_SIZE));
+    slots = jobs[i].buffer && jobs[i].out;
+  }
+
+  pak_write_ctx_t ctx = (pak_write_ctx_t){
+      .f      = f,
+      .exts   = exts,
+      .buffer = (unsigned char*)malloc(ASTERA_PAK_CHUNK_SIZE),
+      .offset = data_offset,
+      .ok     = 1,
+  };
+
+  if (!hashes || !exts || !checksums || !shares || !states || !slots ||
+      !compare || !ctx.buffer || !pool || !lock) {
+    ASTERA_FUNC_DBG("unable to allocate space for pak tables.\n");
+    ctx.ok = 0;
+  }
+
+  write->reused       = 0;
+  write->shared       = 0;
+  write->shared_bytes = 0;
+
+  // Hash every file that can't be copied from the base
+  for (uint32_t i = 0; ctx.ok && i < write->count; ++i) {
+    pak_write_state_t* state = &states[i];
+    pak_wfile_t*       wfile = &write->files[i];
+
+    *state       = (pak_write_state_t){.wfile = wfile, .base = -1,
+                                       .shared = -1, .ok = 1};
+    wfile->index = i;
+    wfile->time  = 0.0;
+
+    if (base_f) {
+      state->base = pak_write_find_base(wfile, base, base_mtime);
+    }
+
+    if (state->base == -1 &&
+        !s_pool_push(pool, pak_write_hash_job, state, 0)) {
+      pak_write_hash_job(state);
+    }
+  }
+
+  if (pool) {
+    s_pool_wait(pool);
+  }
+
+  for (uint32_t i = 0; ctx.ok && i < write->count; ++i) {
+    if (!states[i].ok) {
+      ASTERA_FUNC_DBG("unable to get data for %s.\n", write->files[i].name);
+      ctx.ok = 0;
+    }
+  }
+
+  // Files with the same data as an earlier file point at its stored data
+  uint32_t mask = share_capacity - 1;
+  for (uint32_t i = 0; ctx.ok && i < write->count; ++i) {
+    pak_wfile_t* wfile = &write->files[i];
+    uint32_t     slot  = wfile->checksum & mask;
+
+    for (; shares[slot]; slot = (slot + 1) & mask) {
+      pak_wfile_t* other = &write->files[shares[slot] - 1];
+
+      // Checksums can collide, compare the actual data
+      if (other->checksum == wfile->checksum &&
+          pak_write_same_data(other, wfile, compare, ctx.buffer)) {
+        states[i].shared = (int32_t)(shares[slot] - 1);
+        break;
+      }
+    }
+
+    if (states[i].shared == -1) {
+      shares[slot] = i + 1;
+    }
+  }
+
+  /* Write out the files first, since the stored sizes aren't known until
+   * each file is compressed. Files are streamed a chunk at a time, the
+   * chunks of compressed files are handed to the pool a window at a time */
+  uint32_t queued = 0;
+
+  if (ctx.ok) {
+    ctx.ok = fseek(f, data_offset, SEEK_SET) == 0;
+  }
+
+  for (uint32_t i = 0; ctx.ok && i < write->count; ++i) {
+    pak_write_state_t* state = &states[i];
+    pak_wfile_t*       wfile = state->wfile;
+
+    if (state->shared != -1) {
+      continue;
+    }
+
+    if (state->base != -1 || wfile->codec != PAK_CODEC_LZ4) {
+      // Keep the data in order, write everything queued before this file
+      uint8_t flushed = pak_write_flush(&ctx, pool, jobs, queued);
+      queued          = 0;
+
+      if (!flushed) {
+        break;
+      }
+
+      time_s  start = s_get_time();
+      uint8_t codec = PAK_CODEC_NONE;
+
+      uint32_t stored_size = (state->base != -1)
+                                 ? pak_stored_size(base, state->base)
+                                 : wfile->size;
+
+      if (!pak_write_fits(&ctx, wfile, stored_size)) {
+        ctx.ok = 0;
+        break;
+      }
+
+      wfile->offset = (uint32_t)ctx.offset;
+
+      if (state->base != -1) {
+        ctx.ok = pak_write_copy_base(&ctx, base, base_f, state->base);
+        wfile->stored_size = pak_stored_size(base, state->base);
+        codec              = pak_codec_of(base, state->base);
+        ++write->reused;
+      } else {
+        ctx.ok             = pak_write_copy_raw(&ctx, wfile);
+        wfile->stored_size = wfile->size;
+      }
+
+      ctx.offset += wfile->stored_size;
+      ctx.exts[i] = (pak_file_ext_t){.codec    = codec | (wfile->codec << 8),
+                                     .raw_size = wfile->size};
+      wfile->time += (double)(s_get_time() - start);
+      continue;
+    }
+
+    // Opened once, every chunk of the file reads from it
+    if (wfile->size) {
+      state->f = pak_wfile_open(wfile);
+    }
+
+    for (uint32_t done = 0; ctx.ok && done < wfile->size;) {
+      pak_write_job_t* job = &jobs[queued++];
+
+      job->state  = state;
+      job->lock   = lock;
+      job->start  = done;
+      job->length = pak_chunk_length(wfile->size, done);
+      done += job->length;
+
+      if (queued == window) {
+        pak_write_flush(&ctx, pool, jobs, queued);
+        queued = 0;
+      }
+    }
+  }
+
+  pak_write_flush(&ctx, pool, jobs, queued);
+
+  if (ctx.ok && ctx.end > ctx.offset) {
+    pak_write_truncate(f, (uint32_t)ctx.offset);
+  }
+
+  for (uint32_t i = 0; ctx.ok && i < write->count; ++i) {
+    pak_wfile_t* wfile = &write->files[i];
+
+    if (states[i].shared != -1) {
+      pak_wfile_t* other = &write->files[states[i].shared];
+
+      wfile->offset      = other->offset;
+      wfile->stored_size = other->stored_size;
+      exts[i]            = (pak_file_ext_t){
+                     .codec    = (uint8_t)exts[other->index].codec |
+                              (wfile->codec << 8),
+                     .raw_size = wfile->size};
+
+      ++write->shared;
+      write->shared_bytes += wfile->stored_size;
+    }
+
+    hashes[i]    = (pak_hash_t){.hash = pak_name_hash(wfile->name), .index = i};
+    checksums[i] = wfile->checksum;
+  }
+
+  if (ctx.ok) {
+    qsort(hashes, write->count, sizeof(pak_hash_t), pak_hash_cmp);
+
+    pak_header_t header = (pak_header_t){.count = write->count};
+    memcpy(header.id, ASTERA_PAK_ID_EXTENDED, 4);
+
+    pak_header_ext_t ext =
+        (pak_header_ext_t){.version     = ASTERA_PAK_VERSION,
+                           .flags       = 0,
+                           .hash_offset = hash_offset,
+                           .data_offset = data_offset};
+
+    // A short write leaves a broken pak, so every write has to land
+    ctx.ok = fseek(f, 0, SEEK_SET) == 0;
+
+    ctx.ok = ctx.ok && fwrite(header.id, 1, 4, f) == 4;
+    ctx.ok = ctx.ok && fwrite(&header.count, sizeof(uint32_t), 1, f) == 1;
+    ctx.ok = ctx.ok && fwrite(&ext, sizeof(pak_header_ext_t), 1, f) == 1;
+
+    for (uint32_t i = 0; ctx.ok && i < header.count; ++i) {
+      pak_wfile_t* wfile = &write->files[i];
+
+      ctx.ok = fwrite(wfile->name, 1, 56, f) == 56 &&
+               fwrite(&wfile->offset, sizeof(uint32_t), 1, f) == 1 &&
+               fwrite(&wfile->stored_size, sizeof(uint32_t), 1, f) == 1;
+    }
+
+    ctx.ok = ctx.ok && fwrite(hashes, sizeof(pak_hash_t), header.count, f) ==
+                           header.count;
+    ctx.ok = ctx.ok && fwrite(exts, sizeof(pak_file_ext_t), header.count,
+                              f) == header.count;
+    ctx.ok = ctx.ok && fwrite(checksums, sizeof(uint32_t), header.count, f) ==
+                           header.count;
+
+    if (!ctx.ok) {
+      ASTERA_FUNC_DBG("unable to write the tables of %s.\n", write->filepath);
+    }
+  }
+
+  if (pool)
+    s_pool_destroy(pool);
+
+  if (lock)
+    s_mutex_destroy(lock);
+
+  // Sources of files a failed write didn't get through
+  for (uint32_t i = 0; states && i < write->count; ++i) {
+    if (states[i].f)
+      fclose(states[i].f);
+  }
+
+  for (uint32_t i = 0; jobs && i < window; ++i) {
+    free(jobs[i].buffer);
+    free(jobs[i].out);
+  }
+
+  free(hashes);
+  free(exts);
+  free(checksums);
+  free(shares);
+  free(states);
+  free(jobs);
+  free(compare);
+  free(ctx.buffer);
+
+  if (fclose(f) != 0) {
+    ctx.ok = 0;
+  }
+
+  if (base_f)
+    fclose(base_f);
+  if (base)
+    pak_close(base);
+
+  return ctx.ok;
+}
+
+#endif
+
+pak_t* pak_open_file(const char* file) {
+  FILE* f = fopen(file, "rb");
+
+  if (!f) {
+    ASTERA_FUNC_DBG("unable to open file %s\n", file);
+    return 0;
+  }
+
+  unsigned char header_data[sizeof(pak_header_t) + sizeof(pak_header_ext_t)];
+  uint32_t      header_read =
+      (uint32_t)fread(header_data, 1, sizeof(header_data), f);
+
+  pak_header_t     header = {0};
+  pak_header_ext_t ext    = {0};
+
+  uint32_t entries_offset =
+      pak_parse_header(header_data, header_read, &header, &ext);
+
+  if (!entries_offset) {
+    ASTERA_FUNC_DBG("invalid pak file format %s\n", file);
+    fclose(f);
+    return 0;
+  }
+
+  if (header.count == 0) {
+    ASTERA_FUNC_DBG("empty pak file %s\n", file);
+    fclose(f);
+    return 0;
+  }
+
+  pak_t* pak = (pak_t*)calloc(1, sizeof(pak_t));
+
+  if (!pak) {
+    ASTERA_FUNC_DBG("unable to alloc pak_t\n");
+    fclose(f);
+    return 0;
+  }
+
+  pak->count         = header.count;
+  pak->version       = ext.version;
+  pak->data.filepath = file;
+
+  // Seek to the end of the header size (start of entries)
+  fseek(f, entries_offset, SEEK_SET);
+
+  pak->files = (pak_file_t*)calloc(header.count, sizeof(pak_file_t));
+
+  if (!pak->files) {
+    ASTERA_FUNC_DBG("unable to allocate space for entries\n");
+    fclose(f);
+    free(pak);
+    return 0;
+  }
+
+  if (fread(pak->files, sizeof(pak_file_t), header.count, f) != header.count) {
+    ASTERA_FUNC_DBG("invalid read of entries: %s\n", file);
+    fclose(f);
+    free(pak->files);
+    free(pak);
+    return 0;
+  }
+
+  if (pak->version >= 2) {
+    pak->hashes = (pak_hash_t*)calloc(header.count, sizeof(pak_hash_t));
+
+    fseek(f, ext.hash_offset, SEEK_SET);
+    if (!pak->hashes ||
+        fread(pak->hashes, sizeof(pak_hash_t), header.count, f) !=
+            header.count ||
+        !pak_hashes_valid(pak->hashes, header.count)) {
+      ASTERA_FUNC_DBG("invalid read of hash table: %s\n", file);
+      fclose(f);
+      free(pak->hashes);
+      free(pak->files);
+      free(pak);
+      return 0;
+    }
+  } else {
+    pak->hashes = pak_hashes_create(pak->files, pak->count);
+
+    if (!pak->hashes) {
+      fclose(f);
+      free(pak->files);
+      free(pak);
+      return 0;
+    }
+  }
+
+  // The entry extensions directly follow the hash table
+  if (pak->version >= 3) {
+    pak->exts = (pak_file_ext_t*)calloc(header.count, sizeof(pak_file_ext_t));
+
+    fseek(f, ext.hash_offset + (sizeof(pak_hash_t) * header.count), SEEK_SET);
+    if (!pak->exts || fread(pak->exts, sizeof(pak_file_ext_t), header.count,
+                            f) != header.count) {
+      ASTERA_FUNC_DBG("invalid read of entry extensions: %s\n", file);
+      fclose(f);
+      free(pak->exts);
+      free(pak->hashes);
+      free(pak->files);
+      free(pak);
+      return 0;
+    }
+  }
+
+  // The checksums directly follow the entry extensions
+  if (pak->version >= 4) {
+    pak->checksums = (uint32_t*)calloc(header.count, sizeof(uint32_t));
+
+    if (!pak->checksums || fread(pak->checksums, sizeof(uint32_t),
+                                 header.count, f) != header.count) {
+      ASTERA_FUNC_DBG("invalid read of checksums: %s\n", file);
+      fclose(f);
+      free(pak->checksums);
+      free(pak->exts);
+      free(pak->hashes);
+      free(pak->files);
+      free(pak);
+      return 0;
+    }
+  }
+
+  fseek(f, 0, SEEK_END);
+  pak->data_size = (uint32_t)ftell(f);
+
   fclose(f);
 
   return pak;
@@ -280,16 +1428,52 @@ pak_t* pak_open_mem(unsigned char* data, uint32_t data_length) {
     return 0;
   }
 
-  // Get the header from the start of the data passed
-  pak_header_t* header = (pak_header_t*)data;
+  pak_header_t     header = {0};
+  pak_header_ext_t ext    = {0};
+
+  uint32_t entries_offset = pak_parse_header(data, data_length, &header, &ext);
 
-  if (!header) {
-    ASTERA_FUNC_DBG("unable to obtain header pointer\n");
+  if (!entries_offset) {
+    ASTERA_FUNC_DBG("invalid pak file\n");
     return 0;
   }
 
-  if (memcmp(header->id, "PACK", 4)) {
-    ASTERA_FUNC_DBG("invalid pak file\n");
+  if (header.count == 0) {
+    ASTERA_FUNC_DBG("empty pak file\n");
+    return 0;
+  }
+
+  if (entries_offset + (sizeof(pak_file_t) * header.count) > data_length) {
+    ASTERA_FUNC_DBG("entries extend past the end of the data\n");
+    return 0;
+  }
+
+  if (ext.version >= 2 &&
+      ext.hash_offset + (sizeof(pak_hash_t) * header.count) > data_length) {
+    ASTERA_FUNC_DBG("hash table extends past the end of the data\n");
+    return 0;
+  }
+
+  uint32_t ext_offset = ext.hash_offset + (sizeof(pak_hash_t) * header.count);
+
+  if (ext.version >= 3 &&
+      ext_offset + (sizeof(pak_file_ext_t) * header.count) > data_length) {
+    ASTERA_FUNC_DBG("entry extensions extend past the end of the data\n");
+    return 0;
+  }
+
+  uint32_t checksum_offset =
+      ext_offset + (sizeof(pak_file_ext_t) * header.count);
+
+  if (ext.version >= 4 &&
+      checksum_offset + (sizeof(uint32_t) * header.count) > data_length) {
+    ASTERA_FUNC_DBG("checksums extend past the end of the data\n");
+    return 0;
+  }
+
+  // Uncompressed entries are handed out in place, so they have to be mapped
+  if (!pak_entries_valid((const pak_file_t*)(data + entries_offset),
+                         header.count, data_length)) {
     return 0;
   }
 
@@ -300,12 +1484,160 @@ pak_t* pak_open_mem(unsigned char* data, uint32_t data_length) {
     return 0;
   }
 
-  pak->is_mem = 1;
-  pak->files  = 0;
+  pak->is_mem    = 1;
+  pak->count     = header.count;
+  pak->version   = ext.version;
+  pak->data.ptr  = data;
+  pak->data_size = data_length;
+
+  // Entries are used in place, the hash table is copied so it can be freed
+  // the same way as the ones built for legacy paks
+  pak->files = (pak_file_t*)(data + entries_offset);
+
+  if (pak->version >= 3) {
+    pak->exts = (pak_file_ext_t*)(data + ext_offset);
+  }
+
+  if (pak->version >= 4) {
+    pak->checksums = (uint32_t*)(data + checksum_offset);
+  }
+
+  if (pak->version >= 2) {
+    pak->hashes = (pak_hash_t*)malloc(sizeof(pak_hash_t) * header.count);
+
+    if (pak->hashes) {
+      memcpy(pak->hashes, data + ext.hash_offset,
+             sizeof(pak_hash_t) * header.count);
+
+      if (!pak_hashes_valid(pak->hashes, header.count)) {
+        free(pak->hashes);
+        free(pak);
+        return 0;
+      }
+    }
+  } else {
+    pak->hashes = pak_hashes_create(pak->files, pak->count);
+  }
+
+  if (!pak->hashes) {
+    ASTERA_FUNC_DBG("unable to create hash table\n");
+    free(pak);
+    return 0;
+  }
+
+  return pak;
+}
+
+pak_t* pak_open_mmap(const char* file) {
+  if (!file) {
+    ASTERA_FUNC_DBG("no file passed\n");
+    return 0;
+  }
+
+  unsigned char* data   = 0;
+  uint32_t       length = 0;
+
+#if defined(HAVE_POSIX_MMAP)
+  int fd = open(file, O_RDONLY);
+
+  if (fd == -1) {
+    ASTERA_FUNC_DBG("unable to open file %s\n", file);
+    return 0;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size <= 0) {
+    ASTERA_FUNC_DBG("unable to get size of file %s\n", file);
+    close(fd);
+    return 0;
+  }
+
+  // Paks address their data with 32 bits, don't map only part of the file
+  if ((uint64_t)st.st_size > UINT32_MAX) {
+    ASTERA_FUNC_DBG("file %s is over 4 GiB\n", file);
+    close(fd);
+    return 0;
+  }
+
+  length = (uint32_t)st.st_size;
+  data   = (unsigned char*)mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  // The mapping holds its own reference to the file
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    ASTERA_FUNC_DBG("unable to map file %s\n", file);
+    return 0;
+  }
+#elif defined(HAVE_WIN32_MMAP)
+  HANDLE handle = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, 0,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+
+  if (handle == INVALID_HANDLE_VALUE) {
+    ASTERA_FUNC_DBG("unable to open file %s\n", file);
+    return 0;
+  }
+
+  DWORD high = 0;
+  length     = (uint32_t)GetFileSize(handle, &high);
+
+  // Paks address their data with 32 bits, don't map only part of the file
+  if (high) {
+    ASTERA_FUNC_DBG("file %s is over 4 GiB\n", file);
+    CloseHandle(handle);
+    return 0;
+  }
+
+  HANDLE mapping = CreateFileMappingA(handle, 0, PAGE_READONLY, 0, 0, 0);
+  CloseHandle(handle);
 
-  pak->files = (pak_file_t*)data + sizeof(pak_header_t);
+  if (!mapping) {
+    ASTERA_FUNC_DBG("unable to create mapping of file %s\n", file);
+    return 0;
+  }
+
+  // The view holds its own reference to the mapping
+  data = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+
+  if (!data) {
+    ASTERA_FUNC_DBG("unable to map file %s\n", file);
+    return 0;
+  }
+#else
+  // No mapping support, keep the whole file in memory instead
+  data = fs_file_data(file, &length);
+
+  if (!data) {
+    ASTERA_FUNC_DBG("unable to read file %s\n", file);
+    return 0;
+  }
+
+  pak_t* pak = pak_open_mem(data, length);
+
+  // Only a pak that opened takes ownership of the data
+  if (!pak) {
+    free(data);
+  }
 
   return pak;
+#endif
+
+#if defined(HAVE_POSIX_MMAP) || defined(HAVE_WIN32_MMAP)
+  pak_t* pak = pak_open_mem(data, length);
+
+  if (!pak) {
+#if defined(HAVE_POSIX_MMAP)
+    munmap(data, length);
+#else
+    UnmapViewOfFile(data);
+#endif
+    return 0;
+  }
+
+  pak->is_mmap = 1;
+  return pak;
+#endif
 }
 
 unsigned char* pak_extract(pak_t* pak, uint32_t index, uint32_t* size) {
@@ -321,86 +1653,458 @@ unsigned char* pak_extract(pak_t* pak, uint32_t index, uint32_t* size) {
 
   pak_file_t* entry = &pak->files[index];
 
+  if (pak->is_mem && !pak_compressed(pak, index)) {
+    unsigned char* data =
+        (unsigned char*)((const unsigned char*)pak->data.ptr + entry->offset);
+
+    if (size) {
+      *size = entry->size;
+    }
+
+    return data;
+  }
+
+  uint32_t raw_size = pak_size(pak, index);
+
+  unsigned char* data =
+      (unsigned char*)calloc(raw_size + 1, sizeof(unsigned char));
+
+  if (!data) {
+    ASTERA_FUNC_DBG("unable to allocate %i bytes\n",
+                    (sizeof(unsigned char) * raw_size));
+    return 0;
+  }
+
+  if (pak_extract_noalloc(pak, index, data, raw_size) != raw_size) {
+    free(data);
+    return 0;
+  }
+
+  if (size) {
+    *size = raw_size;
+  }
+
+  return data;
+}
+
+// returns: the raw size decoded, fail = 0
+static uint32_t pak_decode_chunked(const unsigned char* stored,
+                                   uint32_t stored_size, unsigned char* out,
+                                   uint32_t raw_size) {
+  uint32_t in = 0, done = 0;
+
+  while (done < raw_size) {
+    uint32_t block = 0;
+
+    if (stored_size - in < sizeof(uint32_t)) {
+      return 0;
+    }
+
+    memcpy(&block, stored + in, sizeof(uint32_t));
+    in += sizeof(uint32_t);
+
+    uint8_t  raw    = (block & PAK_CHUNK_RAW) != 0;
+    uint32_t length = block & ~PAK_CHUNK_RAW;
+    uint32_t expect = raw_size - done;
+
+    if (expect > ASTERA_PAK_CHUNK_SIZE) {
+      expect = ASTERA_PAK_CHUNK_SIZE;
+    }
+
+    if (length > stored_size - in) {
+      return 0;
+    }
+
+    if (raw) {
+      if (length != expect) {
+        return 0;
+      }
+      memcpy(out + done, stored + in, length);
+    } else if (pak_lz4_decompress(stored + in, length, out + done, expect) !=
+               expect) {
+      return 0;
+    }
+
+    in += length;
+    done += expect;
+  }
+
+  return done;
+}
+
+// Decode stored data into raw data
+// returns: the raw size decoded, fail = 0
+static uint32_t pak_decode(uint8_t codec, const unsigned char* stored,
+                           uint32_t stored_size, unsigned char* out,
+                           uint32_t raw_size) {
+  switch (codec) {
+    case PAK_CODEC_NONE:
+      if (stored_size > raw_size) {
+        return 0;
+      }
+      memcpy(out, stored, sizeof(unsigned char) * stored_size);
+      return stored_size;
+    case PAK_CODEC_LZ4:
+      return pak_lz4_decompress(stored, stored_size, out, raw_size);
+    case PAK_CODEC_LZ4_CHUNKED:
+      return pak_decode_chunked(stored, stored_size, out, raw_size);
+    default:
+      ASTERA_FUNC_DBG("unknown codec %i\n", codec);
+      return 0;
+  }
+}
+
+uint32_t pak_extract_noalloc(pak_t* pak, uint32_t index, unsigned char* out,
+                             uint32_t out_cap) {
+  if (!out || !out_cap) {
+    ASTERA_FUNC_DBG("invalid out buffer parameters passed\n");
+    return 0;
+  }
+
+  if (!pak || index >= pak->count) {
+    ASTERA_FUNC_DBG("index outside of pak entry count\n");
+    return 0;
+  }
+
+  pak_file_t* entry    = &pak->files[index];
+  uint8_t     codec    = pak_codec_of(pak, index);
+  uint32_t    raw_size = pak_size(pak, index);
+
+  if (out_cap < raw_size) {
+    ASTERA_FUNC_DBG("out buffer too small: %i, need %i\n", out_cap, raw_size);
+    return 0;
+  }
+
+  const unsigned char* stored = 0;
+  unsigned char*       temp   = 0;
+
   if (!pak->is_mem) {
-    FILE* f = fopen(pak->data.filepath, "rb+");
+    FILE* f = fopen(pak->data.filepath, "rb");
 
     if (!f) {
       ASTERA_FUNC_DBG("unable to open pak file %s\n", pak->data.filepath);
       return 0;
     }
 
-    unsigned char* data =
-        (unsigned char*)calloc(entry->size + 1, sizeof(unsigned char));
+    // Uncompressed data can be read straight into the out buffer
+    unsigned char* dst = out;
+    if (codec != PAK_CODEC_NONE) {
+      temp = (unsigned char*)malloc(entry->size);
+      dst  = temp;
+    }
+
+    fseek(f, entry->offset, SEEK_SET);
+    if (!dst || fread(dst, sizeof(unsigned char), entry->size, f) !=
+                    entry->size) {
+      ASTERA_FUNC_DBG("unable to read %i bytes\n",
+                      (sizeof(unsigned char) * entry->size));
+      fclose(f);
+      free(temp);
+      return 0;
+    }
+
+    fclose(f);
+
+    if (codec == PAK_CODEC_NONE) {
+      return entry->size;
+    }
+
+    stored = temp;
+  } else {
+    stored = (const unsigned char*)pak->data.ptr + entry->offset;
+  }
+
+  uint32_t used = pak_decode(codec, stored, entry->size, out, raw_size);
+
+  if (temp) {
+    free(temp);
+  }
+
+  if (used != raw_size) {
+    ASTERA_FUNC_DBG("unable to decompress entry %i\n", index);
+    return 0;
+  }
+
+  return used;
+}
+
+// Bytes between entries still worth reading through rather than seeking past
+#define PAK_BATCH_GAP (4 * 1024)
+// The max size of a merged read, kept small enough to stay in cache
+#define PAK_BATCH_SPAN (64 * 1024)
+
+typedef struct {
+  uint32_t offset, size;
+  uint32_t slot;
+} pak_span_t;
+
+static int pak_span_cmp(const void* a, const void* b) {
+  const pak_span_t* x = (const pak_span_t*)a;
+  const pak_span_t* y = (const pak_span_t*)b;
+
+  if (x->offset != y->offset)
+    return (x->offset < y->offset) ? -1 : 1;
+
+  return (x->slot < y->slot) ? -1 : (x->slot > y->slot);
+}
+
+static uint32_t pak_batch_align(uint32_t value) {
+  return (value + 7) & ~(uint32_t)7;
+}
+
+uint32_t pak_extract_batch_size(pak_t* pak, const uint32_t* indices,
+                                uint32_t count) {
+  if (!pak || !indices)
+    return 0;
+
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (indices[i] < pak->count) {
+      total += pak_batch_align(pak_size(pak, indices[i]) + 1);
+    }
+  }
+
+  return total;
+}
+
+// Decode an entry out of stored data into its out pointer
+static uint8_t pak_batch_decode(pak_t* pak, uint32_t index,
+                                const unsigned char* stored,
+                                unsigned char* out) {
+  uint32_t raw_size = pak_size(pak, index);
+
+  if (!raw_size) {
+    return 1;
+  }
+
+  return pak_decode(pak_codec_of(pak, index), stored,
+                    pak->files[index].size, out, raw_size) == raw_size;
+}
+
+// Release the space of a failed entry
+static void pak_batch_fail(unsigned char** out, uint8_t* owned,
+                           uint32_t slot) {
+  if (owned[slot]) {
+    free(out[slot]);
+    owned[slot] = 0;
+  }
+  out[slot] = 0;
+}
+
+uint32_t pak_extract_batch(pak_t* pak, const uint32_t* indices,
+                           uint32_t count, unsigned char** out,
+                           uint32_t* sizes, unsigned char* buffer,
+                           uint32_t buffer_cap) {
+  if (!pak || !indices || !out || !count) {
+    ASTERA_FUNC_DBG("invalid parameters passed\n");
+    return 0;
+  }
+
+  // owned - if out[i] was allocated here & has to be freed on failure
+  uint8_t* owned = (uint8_t*)calloc(count, sizeof(uint8_t));
+  if (!owned) {
+    ASTERA_FUNC_DBG("unable to allocate batch of %i\n", count);
+    return 0;
+  }
+
+  uint32_t used = 0, extracted = 0;
+
+  // Find a home for every entry up front
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t index = indices[i];
+
+    if (sizes) {
+      sizes[i] = 0;
+    }
+
+    if (index >= pak->count) {
+      ASTERA_FUNC_DBG("entry %i outside of pak entry count\n", index);
+      out[i] = 0;
+      continue;
+    }
+
+    uint32_t raw_size = pak_size(pak, index);
+
+    if (out[i]) {
+      continue;
+    }
+
+    if (buffer) {
+      uint32_t need = pak_batch_align(raw_size + 1);
+
+      if (used + need > buffer_cap) {
+        ASTERA_FUNC_DBG("no space in buffer for entry %i\n", index);
+        continue;
+      }
+
+      out[i]           = buffer + used;
+      out[i][raw_size] = 0;
+      used += need;
+    } else if (pak->is_mem && !pak_compressed(pak, index)) {
+      // Borrowed straight from the pak, same as pak_extract
+      out[i] = (unsigned char*)pak->data.ptr + pak->files[index].offset;
+      if (sizes) {
+        sizes[i] = raw_size;
+      }
+      ++extracted;
+      continue;
+    } else {
+      out[i]   = (unsigned char*)calloc(raw_size + 1, sizeof(unsigned char));
+      owned[i] = 1;
+
+      if (!out[i]) {
+        ASTERA_FUNC_DBG("unable to allocate %i bytes\n", raw_size + 1);
+        owned[i] = 0;
+        continue;
+      }
+    }
+  }
+
+  // Memory paks have nothing to gain from ordering, decode in place
+  if (pak->is_mem) {
+    for (uint32_t i = 0; i < count; ++i) {
+      uint32_t index = indices[i];
+
+      if (!out[i] || index >= pak->count) {
+        continue;
+      }
+
+      const unsigned char* stored =
+          (const unsigned char*)pak->data.ptr + pak->files[index].offset;
+
+      if (stored == out[i]) {
+        continue;
+      }
+
+      if (pak_batch_decode(pak, index, stored, out[i])) {
+        if (sizes) {
+          sizes[i] = pak_size(pak, index);
+        }
+        ++extracted;
+      } else {
+        pak_batch_fail(out, owned, i);
+      }
+    }
+
+    free(owned);
+    return extracted;
+  }
 
-    if (!data) {
-      ASTERA_FUNC_DBG("unable to allocate %i bytes\n",
-                      (sizeof(unsigned char) * entry->size));
-      fclose(f);
-      return 0;
-    }
+  pak_span_t* spans = (pak_span_t*)malloc(sizeof(pak_span_t) * count);
+  FILE*       f     = fopen(pak->data.filepath, "rb");
 
-    fseek(f, entry->offset, SEEK_SET);
-    if (!fread(data, sizeof(unsigned char), entry->size, f)) {
-      ASTERA_FUNC_DBG("unable to read %i bytes\n",
-                      (sizeof(unsigned char) * entry->size));
+  if (!spans || !f) {
+    ASTERA_FUNC_DBG("unable to start batch from %s\n", pak->data.filepath);
+    for (uint32_t i = 0; i < count; ++i) {
+      pak_batch_fail(out, owned, i);
+    }
+    free(spans);
+    free(owned);
+    if (f) {
       fclose(f);
-      free(data);
-      return 0;
     }
+    return 0;
+  }
 
-    if (size) {
-      *size = entry->size;
+  uint32_t span_count = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (out[i] && indices[i] < pak->count) {
+      pak_file_t* entry = &pak->files[indices[i]];
+      spans[span_count++] =
+          (pak_span_t){.offset = entry->offset, .size = entry->size, .slot = i};
     }
+  }
 
-    return data;
-  } else {
-    unsigned char* data = (unsigned char*)(pak->data.ptr + entry->offset);
+  qsort(spans, span_count, sizeof(pak_span_t), pak_span_cmp);
 
-    if (size) {
-      *size = entry->size;
+  unsigned char* stage     = 0;
+  uint32_t       stage_cap = 0;
+  long           position  = -1;
+
+  for (uint32_t start = 0; start < span_count;) {
+    // Merge entries until the gap or read size grows too large
+    uint32_t first = spans[start].offset;
+    uint32_t last  = first + spans[start].size;
+    uint32_t end   = start + 1;
+
+    while (end < span_count && spans[end].offset <= last + PAK_BATCH_GAP) {
+      uint32_t next = spans[end].offset + spans[end].size;
+      uint32_t high = (next > last) ? next : last;
+
+      if (high - first > PAK_BATCH_SPAN) {
+        break;
+      }
+
+      last = high;
+      ++end;
     }
 
-    return data;
-  }
-}
+    uint32_t length = last - first;
+    uint32_t slot   = spans[start].slot;
+    uint32_t index  = indices[slot];
 
-uint32_t pak_extract_noalloc(pak_t* pak, uint32_t index, unsigned char* out,
-                             uint32_t out_cap) {
-  if (!out || !out_cap) {
-    ASTERA_FUNC_DBG("invalid out buffer parameters passed\n");
-    return 0;
-  }
+    // Only seek when the reads aren't already sequential
+    if (position != (long)first) {
+      fseek(f, first, SEEK_SET);
+    }
 
-  if (index > pak->count) {
-    ASTERA_FUNC_DBG("index outside of pak entry count\n");
-    return 0;
-  }
+    uint8_t read_ok = 1;
+    if (end - start == 1 && !pak_compressed(pak, index)) {
+      // A lone uncompressed entry can be read right into place
+      read_ok = fread(out[slot], sizeof(unsigned char), length, f) == length;
+      if (read_ok) {
+        if (sizes) {
+          sizes[slot] = length;
+        }
+        ++extracted;
+      } else {
+        pak_batch_fail(out, owned, slot);
+      }
+    } else {
+      if (length > stage_cap) {
+        unsigned char* grown = (unsigned char*)realloc(stage, length);
+        if (grown) {
+          stage     = grown;
+          stage_cap = length;
+        }
+      }
 
-  pak_file_t* entry = &pak->files[index];
+      read_ok = length <= stage_cap &&
+                fread(stage, sizeof(unsigned char), length, f) == length;
 
-  if (!pak->is_mem) {
-    FILE* f = fopen(pak->data.filepath, "rb+");
+      for (uint32_t i = start; i < end; ++i) {
+        uint32_t s_slot  = spans[i].slot;
+        uint32_t s_index = indices[s_slot];
 
-    if (!f) {
-      ASTERA_FUNC_DBG("unable to open pak file %s\n", pak->data.filepath);
-      return 0;
+        if (read_ok && pak_batch_decode(pak, s_index,
+                                        stage + (spans[i].offset - first),
+                                        out[s_slot])) {
+          if (sizes) {
+            sizes[s_slot] = pak_size(pak, s_index);
+          }
+          ++extracted;
+        } else {
+          pak_batch_fail(out, owned, s_slot);
+        }
+      }
     }
 
-    fseek(f, entry->offset, SEEK_SET);
-    if (!fread(out, sizeof(unsigned char), entry->size, f)) {
-      ASTERA_FUNC_DBG("unable to read %i bytes\n",
-                      (sizeof(unsigned char) * entry->size));
-      fclose(f);
-      free(out);
-      return 0;
+    if (!read_ok) {
+      ASTERA_FUNC_DBG("unable to read %i bytes at %i\n", length, first);
+      position = -1;
+    } else {
+      position = (long)last;
     }
 
-    return entry->size;
-  } else {
-    unsigned char* data = (unsigned char*)(pak->data.ptr + entry->offset);
-    memcpy(out, data, sizeof(unsigned char) * entry->size);
-    return entry->size;
+    start = end;
   }
+
+  fclose(f);
+  free(stage);
+  free(spans);
+  free(owned);
+
+  return extracted;
 }
 
 uint8_t pak_close(pak_t* pak) {
@@ -409,12 +2113,31 @@ uint8_t pak_close(pak_t* pak) {
     return 0;
   }
 
-  if (pak->is_mem) {
-    free(pak->data.ptr);
+  if (pak->is_mmap) {
+#if defined(HAVE_POSIX_MMAP)
+    munmap((void*)pak->data.ptr, pak->data_size);
+#elif defined(HAVE_WIN32_MMAP)
+    UnmapViewOfFile(pak->data.ptr);
+#endif
+  } else if (pak->is_mem) {
+    free((void*)pak->data.ptr);
+  } else {
+    // NOTE: entries point into the data in memory mode
+    if (pak->files) {
+      free(pak->files);
+    }
+
+    if (pak->exts) {
+      free(pak->exts);
+    }
+
+    if (pak->checksums) {
+      free(pak->checksums);
+    }
   }
 
-  if (pak->files) {
-    free(pak->files);
+  if (pak->hashes) {
+    free(pak->hashes);
   }
 
   // free out the pointer itself
@@ -424,12 +2147,27 @@ uint8_t pak_close(pak_t* pak) {
 }
 
 int32_t pak_find(pak_t* pak, const char* filename) {
-  if (!pak)
+  if (!pak || !filename || !pak->hashes)
     return -1;
 
-  for (uint32_t i = 0; i < pak->count; ++i) {
-    if (!strcmp(pak->files[i].name, filename)) {
-      return i;
+  uint32_t hash = pak_name_hash(filename);
+
+  // Find the first entry with a matching hash
+  uint32_t low = 0, high = pak->count;
+  while (low < high) {
+    uint32_t mid = low + ((high - low) / 2);
+    if (pak->hashes[mid].hash < hash) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  // Check each of the entries that share the hash (collisions)
+  for (uint32_t i = low; i < pak->count && pak->hashes[i].hash == hash; ++i) {
+    uint32_t index = pak->hashes[i].index;
+    if (index < pak->count && !strncmp(pak->files[index].name, filename, 56)) {
+      return (int32_t)index;
     }
   }
 
@@ -450,11 +2188,34 @@ uint32_t pak_offset(pak_t* pak, uint32_t index) {
 }
 
 uint32_t pak_size(pak_t* pak, uint32_t index) {
+  if (!pak || index >= pak->count)
+    return 0;
+  return pak->exts ? pak->exts[index].raw_size : pak->files[index].size;
+}
+
+uint32_t pak_stored_size(pak_t* pak, uint32_t index) {
   if (!pak)
     return 0;
   return index < pak->count ? pak->files[index].size : 0;
 }
 
+uint8_t pak_codec_of(pak_t* pak, uint32_t index) {
+  if (!pak || !pak->exts || index >= pak->count)
+    return PAK_CODEC_NONE;
+  return (uint8_t)pak->exts[index].codec;
+}
+
+uint8_t pak_compressed(pak_t* pak, uint32_t index) {
+  return pak_codec_of(pak, index) != PAK_CODEC_NONE;
+}
+
+uint32_t pak_checksum(pak_t* pak, uint32_t index) {
+  if (!pak || index >= pak->count || !pak->checksums)
+    return 0;
+
+  return pak->checksums[index];
+}
+
 char* pak_name(pak_t* pak, uint32_t index) {
   if (!pak)
     return 0;
@@ -472,6 +2233,19 @@ void asset_fnv1a_hash(uint32_t* hash, const void* data, uint32_t size) {
   }
 }
 
+uint32_t pak_name_hash(const char* name) {
+  uint32_t hash   = asset_fnv1a_init();
+  uint32_t length = 0;
+
+  // Names are stored in 56 byte fields, which may not be null terminated
+  while (length < 56 && name[length]) {
+    ++length;
+  }
+
+  asset_fnv1a_hash(&hash, name, length);
+  return hash;
+}
+
 uint32_t asset_checksum(asset_t* asset) {
   uint32_t hash = ASTERA_HASH_INITIAL;
   asset_fnv1a_hash(&hash, asset->data, asset->data_length);
@@ -482,7 +2256,7 @@ void asset_free(asset_t* asset) {
   asset->name   = 0;
   asset->filled = 0;
   asset->req    = 0;
-  if (asset->data)
+  if (asset->data && !asset->borrowed)
     free(asset->data);
 
   // these pointers are allocated independent of anything
@@ -490,75 +2264,527 @@ void asset_free(asset_t* asset) {
     free(asset);
 }
 
+typedef struct {
+  /* asset - the asset to fill once published
+   * pak - the pak to extract from, 0 = file system
+   * index - the index of the entry in the pak
+   * data - the data loaded by the worker, 0 if failed */
+  asset_t*       asset;
+  pak_t*         pak;
+  int32_t        index;
+  unsigned char* data;
+  uint32_t       data_length;
+  uint8_t        borrowed;
+
+  // dest - space reserved in the map's arena to extract into [OPTIONAL]
+  unsigned char* dest;
+
+  /* name - a copy of the file's name, the caller's may be gone by the time
+   *        a worker loads it (allocated with the request) */
+  const char* name;
+
+  asset_stream_t* stream;
+} asset_req_t;
+
+struct asset_stream_t {
+  /* pool - the worker threads loading requests
+   * lock - guards the done list
+   * done - requests loaded by the workers, waiting on asset_map_poll
+   * pending - requests not yet published (only used by the map's thread)
+   * requests - the request in flight for each slot of the map (only used
+   *            by the map's thread) */
+  s_pool*       pool;
+  s_mutex*      lock;
+  asset_req_t** done;
+  uint32_t      done_count, done_capacity;
+  uint32_t      pending;
+  asset_req_t** requests;
+};
+
+static uint32_t asset_map_name_hash(const char* name) {
+  uint32_t hash = asset_fnv1a_init();
+  asset_fnv1a_hash(&hash, name, (uint32_t)strlen(name));
+  return hash;
+}
+
+// Allocate the slot tracking for a map's capacity
+static void asset_map_init(asset_map_t* map) {
+  uint32_t capacity = map->capacity;
+
+  // Keep the table at most half full so probe chains stay short
+  uint32_t table_capacity = 8;
+  while (table_capacity < capacity * 2) {
+    table_capacity <<= 1;
+  }
+
+  map->assets       = (asset_t**)calloc(capacity, sizeof(asset_t*));
+  map->table        = (uint32_t*)calloc(table_capacity, sizeof(uint32_t));
+  map->table_hashes = (uint32_t*)calloc(table_capacity, sizeof(uint32_t));
+  map->free_slots   = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+  map->live         = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+  map->live_index   = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+  map->names        = (char**)calloc(capacity, sizeof(char*));
+
+  if (!map->assets || !map->table || !map->table_hashes || !map->free_slots ||
+      !map->live || !map->live_index || !map->names) {
+    ASTERA_FUNC_DBG("unable to allocate map of capacity %i\n", capacity);
+    free(map->assets);
+    free(map->table);
+    free(map->table_hashes);
+    free(map->free_slots);
+    free(map->live);
+    free(map->live_index);
+    free(map->names);
+
+    map->assets       = 0;
+    map->table        = 0;
+    map->table_hashes = 0;
+    map->free_slots   = 0;
+    map->live         = 0;
+    map->live_index   = 0;
+    map->names        = 0;
+    map->capacity     = 0;
+    return;
+  }
+
+  map->table_capacity = table_capacity;
+
+  // Hand out the lowest slots first
+  for (uint32_t i = 0; i < capacity; ++i) {
+    map->free_slots[i] = capacity - 1 - i;
+  }
+  map->free_count = capacity;
+}
+
+static void asset_map_deinit(asset_map_t* map) {
+  for (uint32_t i = 0; map->names && i < map->capacity; ++i) {
+    free(map->names[i]);
+  }
+
+  free(map->assets);
+  free(map->table);
+  free(map->table_hashes);
+  free(map->free_slots);
+  free(map->live);
+  free(map->live_index);
+  free(map->names);
+
+  map->assets         = 0;
+  map->table          = 0;
+  map->table_hashes   = 0;
+  map->free_slots     = 0;
+  map->live           = 0;
+  map->live_index     = 0;
+  map->names          = 0;
+  map->table_capacity = 0;
+  map->free_count     = 0;
+  map->clock          = 0;
+  map->stats.resident = 0;
+}
+
 void asset_map_free(asset_map_t* map) {
   if (!map) {
     ASTERA_FUNC_DBG("No map passed to free.\n");
     return;
   }
 
-  for (uint32_t i = 0; i < map->capacity; ++i) {
-    asset_t* asset = map->assets[i];
-    if (asset->data) {
-      free(asset->data);
-    }
-  }
+  for (uint32_t i = 0; i < map->count; ++i) {
+    asset_t* asset = map->assets[map->live[i]];
+    if (asset && asset->data && !asset->borrowed) {
+      free(asset->data);
+    }
+  }
+
+  asset_map_deinit(map);
+  map->count    = 0;
+  map->capacity = 0;
+  map->name     = 0;
+  map->filename = 0;
+}
+
+// returns: position in the table, not found = -1
+static int32_t asset_map_table_find(asset_map_t* map, const char* name,
+                                    uint32_t hash) {
+  if (!map->table_capacity)
+    return -1;
+
+  uint32_t mask = map->table_capacity - 1;
+
+  for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+    uint32_t entry = map->table[i];
+
+    if (!entry) {
+      return -1;
+    }
+
+    if (map->table_hashes[i] == hash) {
+      asset_t* asset = map->assets[entry - 1];
+      if (asset && asset->name && !strcmp(asset->name, name)) {
+        return (int32_t)i;
+      }
+    }
+  }
+}
+
+asset_arena_t asset_arena_create(unsigned char* data, uint32_t capacity) {
+  asset_arena_t arena = (asset_arena_t){.data = data, .capacity = capacity, 0};
+
+  if (!data && capacity) {
+    arena.data  = (unsigned char*)malloc(capacity);
+    arena.owned = 1;
+
+    if (!arena.data) {
+      ASTERA_FUNC_DBG("unable to allocate arena of %i bytes\n", capacity);
+      arena.capacity = 0;
+      arena.owned    = 0;
+    }
+  }
+
+  return arena;
+}
+
+void asset_arena_destroy(asset_arena_t* arena) {
+  if (!arena)
+    return;
+
+  if (arena->owned && arena->data) {
+    free(arena->data);
+  }
+
+  *arena = (asset_arena_t){0};
+}
+
+void* asset_arena_alloc(asset_arena_t* arena, uint32_t size) {
+  if (!arena || !arena->data)
+    return 0;
+
+  // Align from the block's address, caller blocks might not be aligned
+  uintptr_t base  = (uintptr_t)arena->data;
+  uintptr_t start = (base + arena->used + 15) & ~(uintptr_t)15;
+  uintptr_t end   = start + size;
+
+  if (end > base + arena->capacity || end < start) {
+    return 0;
+  }
+
+  arena->used = (uint32_t)(end - base);
+
+  if (arena->used > arena->peak) {
+    arena->peak = arena->used;
+  }
+
+  return (void*)start;
+}
+
+uint32_t asset_arena_mark(asset_arena_t* arena) {
+  return arena ? arena->used : 0;
+}
+
+void asset_arena_reset(asset_arena_t* arena, uint32_t mark) {
+  if (!arena)
+    return;
+
+  if (mark < arena->used) {
+    arena->used = mark;
+  }
+}
+
+// returns: if the pointer falls in the arena past the mark
+static uint8_t asset_arena_owns(asset_arena_t* arena, const void* ptr,
+                                uint32_t mark) {
+  const unsigned char* p = (const unsigned char*)ptr;
+  return p >= arena->data + mark && p < arena->data + arena->capacity;
+}
+
+// Allocate an asset structure, from the map's arena if it has one
+static asset_t* asset_map_new_asset(asset_map_t* map) {
+  asset_t* asset =
+      (asset_t*)asset_arena_alloc(map->arena, (uint32_t)sizeof(asset_t));
+
+  if (asset) {
+    memset(asset, 0, sizeof(asset_t));
+    return asset;
+  }
+
+  asset = (asset_t*)calloc(1, sizeof(asset_t));
+
+  if (asset) {
+    asset->fs = 1;
+  }
+
+  return asset;
+}
+
+/* Allocate space for asset data, from the map's arena if it has one
+ * borrowed - set if the space is owned by the arena
+ * NOTE: the space is null terminated at size */
+static unsigned char* asset_map_new_data(asset_map_t* map, uint32_t size,
+                                         uint8_t* borrowed) {
+  unsigned char* data = (unsigned char*)asset_arena_alloc(map->arena, size + 1);
+  *borrowed           = data != 0;
+
+  if (!data) {
+    data = (unsigned char*)malloc(size + 1);
+  }
+
+  if (data) {
+    data[size] = 0;
+  }
+
+  return data;
+}
+
+// Release the data of an asset that failed to load
+static void asset_map_drop_data(unsigned char* data, uint8_t borrowed) {
+  if (data && !borrowed) {
+    free(data);
+  }
+}
+
+static void asset_map_table_insert(asset_map_t* map, uint32_t slot,
+                                   uint32_t hash) {
+  uint32_t mask = map->table_capacity - 1;
+  uint32_t i    = hash & mask;
+
+  while (map->table[i]) {
+    i = (i + 1) & mask;
+  }
+
+  map->table[i]        = slot + 1;
+  map->table_hashes[i] = hash;
+}
+
+// Remove a table entry, shifting back any entries probed past it
+static void asset_map_table_erase(asset_map_t* map, uint32_t i) {
+  uint32_t mask = map->table_capacity - 1;
+
+  map->table[i] = 0;
+
+  for (uint32_t j = (i + 1) & mask; map->table[j]; j = (j + 1) & mask) {
+    uint32_t home = map->table_hashes[j] & mask;
+
+    // Only move the entry if its home isn't between the hole & itself
+    uint8_t reachable =
+        (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+
+    if (!reachable) {
+      map->table[i]        = map->table[j];
+      map->table_hashes[i] = map->table_hashes[j];
+      map->table[j]        = 0;
+      i                    = j;
+    }
+  }
+}
+
+// The bytes of an asset's data counted against the map's budget
+static uint32_t asset_owned_bytes(asset_t* asset) {
+  return (asset->data && !asset->borrowed) ? asset->data_length : 0;
+}
+
+/* Evict the least recently used unreferenced asset (CLOCK sweep)
+ * owned_only - only evict assets holding bytes against the budget
+ * returns: evicted = 1, nothing to evict = 0 */
+static uint8_t asset_map_evict(asset_map_t* map, uint8_t owned_only) {
+  // Two passes clear every referenced bit at most once
+  for (uint32_t step = 0; step < map->count * 2; ++step) {
+    if (map->clock >= map->count) {
+      map->clock = 0;
+    }
+
+    uint32_t slot  = map->live[map->clock];
+    asset_t* asset = map->assets[slot];
+
+    uint8_t skip = owned_only && !asset_owned_bytes(asset);
+    if (asset->refs || asset->req || skip) {
+      ++map->clock;
+      continue;
+    }
+
+    if (asset->referenced) {
+      asset->referenced = 0;
+      ++map->clock;
+      continue;
+    }
+
+    // The last live slot gets swapped into the clock's position
+    asset_map_removei(map, slot);
+    ++map->stats.evictions;
+    return 1;
+  }
+
+  return 0;
+}
+
+// Remove the table entry of a slot
+static void asset_map_table_remove(asset_map_t* map, uint32_t slot,
+                                   uint32_t hash) {
+  uint32_t mask = map->table_capacity - 1;
+
+  for (uint32_t i = hash & mask; map->table[i]; i = (i + 1) & mask) {
+    if (map->table[i] == slot + 1) {
+      asset_map_table_erase(map, i);
+      return;
+    }
+  }
+}
+
+// Stop an asset being found by name, so it can be loaded again in a new slot
+static void asset_map_forget(asset_map_t* map, asset_t* asset) {
+  if (asset->name) {
+    asset_map_table_remove(map, asset->uid, asset_map_name_hash(asset->name));
+    free(map->names[asset->uid]);
+    map->names[asset->uid] = 0;
+    asset->name            = 0;
+  }
+}
+
+asset_t* asset_map_find(asset_map_t* map, const char* file) {
+  if (!map || !file || !map->count)
+    return 0;
+
+  int32_t index = asset_map_table_find(map, file, asset_map_name_hash(file));
+
+  return (index == -1) ? 0 : map->assets[map->table[index] - 1];
+}
+
+// Load the data of a file from the map's pak or the file system
+// returns: success = 1, fail = 0
+static uint8_t asset_map_load(asset_map_t* map, const char* file,
+                              unsigned char** data, uint32_t* length,
+                              uint8_t* borrowed) {
+  if (map->pak) {
+    int32_t index = pak_find(map->pak, file);
+
+    if (index == -1) {
+      return 0;
+    }
+
+    uint32_t size = pak_size(map->pak, index);
+
+    // Memory & mapped paks hand out pointers into their own data
+    if (map->pak->is_mem && !pak_compressed(map->pak, index)) {
+      *data     = pak_extract(map->pak, index, length);
+      *borrowed = 1;
+      return *data != 0;
+    }
+
+    *data = asset_map_new_data(map, size, borrowed);
+
+    if (!*data) {
+      ASTERA_FUNC_DBG("unable to allocate %i bytes\n", size + 1);
+      return 0;
+    }
+
+    if (pak_extract_noalloc(map->pak, index, *data, size) != size && size) {
+      asset_map_drop_data(*data, *borrowed);
+      *data = 0;
+      return 0;
+    }
+
+    *length = size;
+    return 1;
+  }
+
+  FILE* f = fopen(file, "rb");
+
+  if (!f) {
+    ASTERA_FUNC_DBG("Unable to open system file: %s\n", file);
+    return 0;
+  }
+
+  fseek(f, 0, SEEK_END);
+  uint32_t size = (uint32_t)ftell(f);
+  rewind(f);
+
+  *data = asset_map_new_data(map, size, borrowed);
+
+  if (!*data || fread(*data, sizeof(unsigned char), size, f) != size) {
+    ASTERA_FUNC_DBG("unable to read %i bytes from %s\n", size, file);
+    asset_map_drop_data(*data, *borrowed);
+    *data = 0;
+    fclose(f);
+    return 0;
+  }
+
+  fclose(f);
 
-  free(map->assets);
-  map->assets   = 0;
-  map->count    = 0;
-  map->capacity = 0;
-  map->name     = 0;
-  map->filename = 0;
+  *length = size;
+  return 1;
 }
 
 asset_t* asset_map_get(asset_map_t* map, const char* file) {
+  if (!map || !file) {
+    ASTERA_FUNC_DBG("invalid parameters passed\n");
+    return 0;
+  }
+
   // First check if we have it already loaded
-  if (map->count > 0) {
-    for (uint32_t i = 0; i < map->capacity; ++i) {
-      if (map->assets[i]) {
-        if (map->assets[i]->name && map->assets[i]->data) {
-          if (strcmp(file, map->assets[i]->name) == 0) {
-            return map->assets[i];
-          }
-        }
-      }
+  asset_t* cached = asset_map_find(map, file);
+  if (cached) {
+    // Referenced first so polling can't evict it
+    ++cached->refs;
+    cached->referenced = 1;
+
+    // Still being streamed in, finish only its own request
+    if (cached->req && map->stream) {
+      cached->req_free = 0;
+      s_pool_finish(map->stream->pool, map->stream->requests[cached->uid]);
+      asset_map_poll(map);
+    }
+
+    if (cached->data) {
+      ++map->stats.hits;
+      return cached;
     }
+
+    // Failed or freed, others may still hold it so only stop finding it by
+    // name, the last asset_map_release removes it
+    asset_map_forget(map, cached);
+    asset_map_release(map, cached);
   }
 
-  if (map->pak) {
-    asset_t* asset = (asset_t*)calloc(1, sizeof(asset_t));
-    asset->name    = file;
-    ++map->uid_counter;
-    asset->uid = map->uid_counter;
+  ++map->stats.misses;
 
-    int32_t asset_index = pak_find(map->pak, file);
+  unsigned char* data     = 0;
+  uint32_t       length   = 0;
+  uint8_t        borrowed = 0;
 
-    if (asset_index == -1) {
-      free(asset);
-      return 0;
-    }
+  if (!asset_map_load(map, file, &data, &length, &borrowed)) {
+    return 0;
+  }
 
-    asset->data = pak_extract(map->pak, asset_index, &asset->data_length);
+  asset_t* asset = asset_map_new_asset(map);
 
-    asset->filled = 1;
-    return asset;
-  } else {
-    asset_t* asset = asset_get(file);
-    ++map->uid_counter;
-    asset->uid = map->uid_counter;
+  if (!asset) {
+    ASTERA_FUNC_DBG("unable to allocate asset\n");
+    asset_map_drop_data(data, borrowed);
+    return 0;
+  }
 
-    if (asset) {
-      for (uint32_t i = 0; i < map->capacity; ++i) {
-        if (!map->assets[i]) {
-          map->assets[i] = asset;
-          ++map->count;
-          return asset;
-        }
-      }
-    }
-    asset->filled = 1;
-    return asset;
+  asset->data        = data;
+  asset->data_length = length;
+  asset->borrowed    = borrowed;
+  asset->name        = file;
+  asset->filled      = 1;
+
+  asset->refs       = 1;
+  asset->referenced = 1;
+
+  // Make room by dropping an unreferenced asset if the map is full
+  if (!map->free_count) {
+    asset_map_evict(map, 0);
+  }
+
+  // Untracked assets would never be freed, so don't hand one out
+  if (!asset_map_add(map, asset)) {
+    ASTERA_FUNC_DBG("no space in map to cache %s\n", file);
+    asset_free(asset);
+    return 0;
   }
+
+  asset_map_trim(map);
+
+  return asset;
 }
 
 asset_t* asset_map_geti(asset_map_t* map, uint32_t id) {
@@ -633,11 +2859,12 @@ asset_t* asset_get(const char* file) {
 }
 
 asset_map_t asset_map_create(const char* filename, const char* name,
-                             uint32_t capacity) {
+                             uint32_t capacity, uint64_t budget) {
   asset_map_t map = (asset_map_t){
       .capacity = capacity, .name = name, .filename = filename, 0};
 
-  map.assets = (asset_t**)calloc(capacity, sizeof(asset_t*));
+  asset_map_init(&map);
+  map.stats.budget = budget;
 
   if (filename) {
     pak_t* pak = pak_open_file(filename);
@@ -652,12 +2879,35 @@ asset_map_t asset_map_create(const char* filename, const char* name,
   return map;
 }
 
+asset_map_t asset_map_create_mmap(const char* filename, const char* name,
+                                  uint32_t capacity, uint64_t budget) {
+  asset_map_t map = (asset_map_t){
+      .capacity = capacity, .name = name, .filename = filename, 0};
+
+  asset_map_init(&map);
+  map.stats.budget = budget;
+
+  if (filename) {
+    pak_t* pak = pak_open_mmap(filename);
+
+    if (!pak) {
+      map.filename = 0;
+    } else {
+      map.pak = pak;
+    }
+  }
+
+  return map;
+}
+
 asset_map_t asset_map_create_mem(unsigned char* data, uint32_t data_length,
-                                 const char* name, uint32_t capacity) {
+                                 const char* name, uint32_t capacity,
+                                 uint64_t budget) {
   asset_map_t map =
       (asset_map_t){.capacity = capacity, .name = name, .filename = 0, 0};
 
-  map.assets = (asset_t**)calloc(capacity, sizeof(asset_t*));
+  asset_map_init(&map);
+  map.stats.budget = budget;
 
   if (data && data_length) {
     pak_t* pak = pak_open_mem(data, data_length);
@@ -676,28 +2926,63 @@ void asset_map_destroy(asset_map_t* map) {
   if (!map)
     return;
 
+  asset_map_stream_stop(map);
+
   if (map->pak && map->filename) {
     pak_close(map->pak);
   }
 
-  for (uint32_t i = 0; i < map->capacity; ++i) {
-    if (map->assets[i]) {
-      asset_free(map->assets[i]);
+  for (uint32_t i = 0; i < map->count; ++i) {
+    asset_t* asset = map->assets[map->live[i]];
+    if (asset) {
+      asset_free(asset);
     }
   }
 
-  free(map->assets);
+  asset_map_deinit(map);
+  map->count = 0;
 }
 
-void asset_map_add(asset_map_t* map, asset_t* asset) {
-  for (uint32_t i = 0; i < map->capacity; ++i) {
-    if (!map->assets[i]) {
-      map->assets[i] = asset;
-      asset->uid     = i;
-      ++map->count;
-      break;
+uint8_t asset_map_add(asset_map_t* map, asset_t* asset) {
+  if (!map || !asset) {
+    return 0;
+  }
+
+  if (!map->free_count) {
+    return 0;
+  }
+
+  // Keep a copy of the name, the caller's may not last as long as the asset
+  char* name = 0;
+  if (asset->name) {
+    size_t length = strlen(asset->name) + 1;
+    name          = (char*)malloc(length);
+
+    if (!name) {
+      ASTERA_FUNC_DBG("unable to copy name %s\n", asset->name);
+      return 0;
     }
+
+    memcpy(name, asset->name, length);
+  }
+
+  uint32_t slot = map->free_slots[--map->free_count];
+
+  map->names[slot]      = name;
+  asset->name           = name;
+  map->assets[slot]     = asset;
+  map->live[map->count] = slot;
+  map->live_index[slot] = map->count;
+  asset->uid            = slot;
+  ++map->count;
+
+  map->stats.resident += asset_owned_bytes(asset);
+
+  if (asset->name) {
+    asset_map_table_insert(map, slot, asset_map_name_hash(asset->name));
   }
+
+  return 1;
 }
 
 void asset_map_remove(asset_map_t* map, asset_t* asset) {
@@ -705,22 +2990,431 @@ void asset_map_remove(asset_map_t* map, asset_t* asset) {
 }
 
 void asset_map_removei(asset_map_t* map, uint32_t id) {
-  if (!map->assets[id]) {
+  if (id >= map->capacity || !map->assets[id]) {
     ASTERA_FUNC_DBG("no asset at index %i on asset map.\n", id);
     return;
   }
 
-  free(map->assets[id]->data);
-  map->assets[id]->uid = 0;
+  asset_t* asset = map->assets[id];
+
+  // Workers still own the request, asset_map_poll removes it once finished
+  if (asset->req && map->stream) {
+    asset->req_free = 1;
+    return;
+  }
+
+  if (asset->name) {
+    asset_map_table_remove(map, id, asset_map_name_hash(asset->name));
+  }
+
+  free(map->names[id]);
+  map->names[id] = 0;
+
+  map->stats.resident -= asset_owned_bytes(asset);
+
+  // Swap the last live slot into the removed slot's position
+  uint32_t position     = map->live_index[id];
+  uint32_t last         = map->live[map->count - 1];
+  map->live[position]   = last;
+  map->live_index[last] = position;
   --map->count;
+
+  map->free_slots[map->free_count] = id;
+  ++map->free_count;
+
+  map->assets[id] = 0;
+
+  asset->uid = 0;
+  asset_free(asset);
 }
 
 void asset_map_update(asset_map_t* map) {
-  for (uint32_t i = 0; i < map->capacity; ++i) {
-    if (map->assets[i]->filled && map->assets[i]->req_free) {
-      asset_map_removei(map, i);
+  asset_map_poll(map);
+
+  // Walk backwards since removal swaps the last live slot into place
+  for (uint32_t i = map->count; i > 0; --i) {
+    asset_t* asset = map->assets[map->live[i - 1]];
+    if (asset && asset->filled && asset->req_free) {
+      asset_map_removei(map, map->live[i - 1]);
+    }
+  }
+
+  asset_map_trim(map);
+}
+
+void asset_map_retain(asset_map_t* map, asset_t* asset) {
+  if (!map || !asset)
+    return;
+
+  ++asset->refs;
+  asset->referenced = 1;
+}
+
+void asset_map_release(asset_map_t* map, asset_t* asset) {
+  if (!map || !asset)
+    return;
+
+  if (!asset->refs) {
+    ASTERA_FUNC_DBG("asset %s has no references to release\n",
+                    asset->name ? asset->name : "(unnamed)");
+    return;
+  }
+
+  --asset->refs;
+
+  if (!asset->refs) {
+    // Failed to load, nothing is left to keep it for
+    if (!asset->data && !asset->req) {
+      asset_map_remove(map, asset);
+      return;
+    }
+
+    asset_map_trim(map);
+  }
+}
+
+void asset_map_set_budget(asset_map_t* map, uint64_t budget) {
+  if (!map)
+    return;
+
+  map->stats.budget = budget;
+  asset_map_trim(map);
+}
+
+uint32_t asset_map_trim(asset_map_t* map) {
+  if (!map || !map->stats.budget)
+    return 0;
+
+  uint32_t evicted = 0;
+  while (map->stats.resident > map->stats.budget &&
+         asset_map_evict(map, 1)) {
+    ++evicted;
+  }
+
+  return evicted;
+}
+
+asset_map_stats_t asset_map_get_stats(asset_map_t* map) {
+  if (!map)
+    return (asset_map_stats_t){0};
+
+  return map->stats;
+}
+
+void asset_map_set_arena(asset_map_t* map, asset_arena_t* arena) {
+  if (!map)
+    return;
+
+  map->arena = arena;
+}
+
+uint32_t asset_map_scope_begin(asset_map_t* map) {
+  if (!map || !map->arena) {
+    ASTERA_FUNC_DBG("map has no arena for scopes\n");
+    return 0;
+  }
+
+  return asset_arena_mark(map->arena);
+}
+
+void asset_map_scope_end(asset_map_t* map, uint32_t scope) {
+  if (!map || !map->arena) {
+    ASTERA_FUNC_DBG("map has no arena for scopes\n");
+    return;
+  }
+
+  // Requests in flight may be writing into the scope
+  if (map->stream && map->stream->pending) {
+    s_pool_wait(map->stream->pool);
+    asset_map_poll(map);
+  }
+
+  // Walk backwards since removal swaps the last live slot into place
+  for (uint32_t i = map->count; i > 0; --i) {
+    uint32_t slot  = map->live[i - 1];
+    asset_t* asset = map->assets[slot];
+
+    if (asset_arena_owns(map->arena, asset, scope) ||
+        (asset->borrowed && asset_arena_owns(map->arena, asset->data, scope))) {
+      asset_map_removei(map, slot);
+    }
+  }
+
+  asset_arena_reset(map->arena, scope);
+}
+
+// NOTE: ran on a worker thread, only touches the request until it's queued
+static void asset_stream_job(void* data) {
+  asset_req_t*    req    = (asset_req_t*)data;
+  asset_stream_t* stream = req->stream;
+
+  if (req->dest) {
+    uint32_t size = pak_size(req->pak, req->index);
+
+    if (pak_extract_noalloc(req->pak, req->index, req->dest, size) == size) {
+      req->data        = req->dest;
+      req->data_length = size;
+      req->borrowed    = 1;
+    }
+  } else if (req->pak) {
+    req->data     = pak_extract(req->pak, req->index, &req->data_length);
+    req->borrowed = req->pak->is_mem && !pak_compressed(req->pak, req->index);
+  } else {
+    asset_t* loaded = asset_get(req->name);
+
+    if (loaded) {
+      req->data        = loaded->data;
+      req->data_length = loaded->data_length;
+      free(loaded);
+    }
+  }
+
+  // NOTE: asset_map_request makes sure there's space for every pending request
+  s_mutex_lock(stream->lock);
+  stream->done[stream->done_count] = req;
+  ++stream->done_count;
+
+  s_mutex_unlock(stream->lock);
+}
+
+uint8_t asset_map_stream_start(asset_map_t* map, uint32_t thread_count) {
+  if (!map) {
+    ASTERA_FUNC_DBG("no map passed\n");
+    return 0;
+  }
+
+  if (map->stream) {
+    ASTERA_FUNC_DBG("map already streaming\n");
+    return 1;
+  }
+
+  if (thread_count == 0) {
+    uint32_t cpus = s_cpu_count();
+    thread_count  = (cpus > 1) ? cpus - 1 : 1;
+  }
+
+  asset_stream_t* stream = (asset_stream_t*)calloc(1, sizeof(asset_stream_t));
+
+  if (!stream) {
+    ASTERA_FUNC_DBG("unable to allocate stream\n");
+    return 0;
+  }
+
+  stream->lock = s_mutex_create();
+  stream->pool = s_pool_create(thread_count);
+  stream->requests =
+      (asset_req_t**)calloc(map->capacity ? map->capacity : 1,
+                            sizeof(asset_req_t*));
+
+  if (!stream->lock || !stream->pool || !stream->requests) {
+    ASTERA_FUNC_DBG("unable to start %i worker threads\n", thread_count);
+    s_pool_destroy(stream->pool);
+    s_mutex_destroy(stream->lock);
+    free(stream->requests);
+    free(stream);
+    return 0;
+  }
+
+  map->stream = stream;
+  return 1;
+}
+
+void asset_map_stream_stop(asset_map_t* map) {
+  if (!map || !map->stream)
+    return;
+
+  // Destroying the pool finishes all queued requests
+  s_pool_destroy(map->stream->pool);
+  map->stream->pool = 0;
+
+  asset_map_poll(map);
+
+  s_mutex_destroy(map->stream->lock);
+
+  if (map->stream->done)
+    free(map->stream->done);
+
+  free(map->stream->requests);
+  free(map->stream);
+  map->stream = 0;
+}
+
+asset_t* asset_map_request(asset_map_t* map, const char* file,
+                           int32_t priority) {
+  if (!map || !file) {
+    ASTERA_FUNC_DBG("invalid parameters passed\n");
+    return 0;
+  }
+
+  if (!map->stream) {
+    ASTERA_FUNC_DBG("map isn't streaming, call asset_map_stream_start\n");
+    return 0;
+  }
+
+  asset_t* existing = asset_map_find(map, file);
+  if (existing && (existing->req || existing->data)) {
+    // Requested again before a pending removal went through
+    existing->req_free   = 0;
+    existing->referenced = 1;
+    ++existing->refs;
+    ++map->stats.hits;
+    return existing;
+  }
+
+  int32_t index = -1;
+  if (map->pak) {
+    index = pak_find(map->pak, file);
+
+    if (index == -1) {
+      ASTERA_FUNC_DBG("unable to find %s in pak\n", file);
+      return 0;
+    }
+  }
+
+  // A failed request is tried again in its own slot, so the name is never
+  // tracked twice
+  if (!existing && !map->free_count && !asset_map_evict(map, 0)) {
+    ASTERA_FUNC_DBG("no space in map for %s\n", file);
+    return 0;
+  }
+
+  asset_stream_t* stream = map->stream;
+
+  // Make sure the done list can hold every pending request, so the workers
+  // never have to grow it
+  if (stream->pending + 1 > stream->done_capacity) {
+    uint32_t capacity = stream->done_capacity ? stream->done_capacity * 2 : 32;
+
+    s_mutex_lock(stream->lock);
+    asset_req_t** done =
+        (asset_req_t**)realloc(stream->done, sizeof(asset_req_t*) * capacity);
+
+    if (done) {
+      stream->done          = done;
+      stream->done_capacity = capacity;
+    }
+    s_mutex_unlock(stream->lock);
+
+    if (!done) {
+      ASTERA_FUNC_DBG("unable to grow request list for %s\n", file);
+      return 0;
+    }
+  }
+
+  size_t       name_length = strlen(file) + 1;
+  asset_req_t* req =
+      (asset_req_t*)calloc(1, sizeof(asset_req_t) + name_length);
+  asset_t* asset = req ? (existing ? existing : asset_map_new_asset(map)) : 0;
+
+  if (!asset) {
+    ASTERA_FUNC_DBG("unable to allocate request for %s\n", file);
+    free(req);
+    return 0;
+  }
+
+  // Copied by asset_map_add, an existing asset already has the map's copy
+  if (!existing) {
+    asset->name = file;
+  }
+
+  asset->req        = 1;
+  asset->referenced = 1;
+  ++asset->refs;
+
+  *req = (asset_req_t){.asset  = asset,
+                       .pak    = map->pak,
+                       .index  = index,
+                       .name   = (const char*)(req + 1),
+                       .stream = stream};
+  memcpy(req + 1, file, name_length);
+
+  // Reserve arena space up front, workers can't allocate from it
+  if (map->arena && map->pak &&
+      (!map->pak->is_mem || pak_compressed(map->pak, index))) {
+    req->dest = (unsigned char*)asset_arena_alloc(
+        map->arena, pak_size(map->pak, index) + 1);
+
+    if (req->dest) {
+      req->dest[pak_size(map->pak, index)] = 0;
+    }
+  }
+
+  if (!existing && !asset_map_add(map, asset)) {
+    ASTERA_FUNC_DBG("unable to track request for %s\n", file);
+    asset_free(asset);
+    free(req);
+    return 0;
+  }
+
+  stream->requests[asset->uid] = req;
+
+  if (!s_pool_push(stream->pool, asset_stream_job, req, priority)) {
+    ASTERA_FUNC_DBG("unable to queue request for %s\n", file);
+    stream->requests[asset->uid] = 0;
+    asset->req                   = 0;
+    --asset->refs;
+
+    if (!existing) {
+      asset_map_removei(map, asset->uid);
+    }
+
+    free(req);
+    return 0;
+  }
+
+  ++stream->pending;
+  ++map->stats.misses;
+
+  return asset;
+}
+
+uint32_t asset_map_poll(asset_map_t* map) {
+  if (!map || !map->stream)
+    return 0;
+
+  asset_stream_t* stream = map->stream;
+
+  s_mutex_lock(stream->lock);
+
+  uint32_t count = stream->done_count;
+  for (uint32_t i = 0; i < count; ++i) {
+    asset_req_t* req   = stream->done[i];
+    asset_t*     asset = req->asset;
+
+    asset->data        = req->data;
+    asset->data_length = req->data_length;
+    asset->borrowed    = req->borrowed;
+    asset->filled      = req->data != 0;
+    asset->req         = 0;
+
+    map->stats.resident += asset_owned_bytes(asset);
+
+    stream->requests[asset->uid] = 0;
+    free(req);
+
+    // Removed while it was still streaming, or failed with nobody holding it
+    if (asset->req_free || (!asset->data && !asset->refs)) {
+      asset_map_removei(map, asset->uid);
     }
   }
+  stream->done_count = 0;
+
+  s_mutex_unlock(stream->lock);
+
+  stream->pending -= count;
+
+  if (count) {
+    asset_map_trim(map);
+  }
+
+  return count;
+}
+
+uint32_t asset_map_pending(asset_map_t* map) {
+  if (!map || !map->stream)
+    return 0;
+
+  return map->stream->pending;
 }
 
 asset_t* asset_get_chunk(const char* file, uint32_t chunk_start,
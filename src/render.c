@@ -7,9 +7,27 @@
 
 #include <math.h>
 #include <assert.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+
+// 4 wide kernels for r_sprite_pool & particles, with a plain C fallback
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define R_SIMD_SSE
+// Integer conversions for the particle frame kernel
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define R_SIMD_SSE2
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define R_SIMD_NEON
+#endif
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
@@ -90,7 +108,450 @@ static void glfw_joy_cb(int joystick, int action) {
   }
 }
 
+// Attribute locations of r_instance in batch.vert
+#define R_INSTANCE_MODEL  2
+#define R_INSTANCE_COORDS 6
+#define R_INSTANCE_COLOR  7
+#define R_INSTANCE_FLIP   8
+
+// Attribute locations of r_instance_packed in batch_packed.vert
+#define R_PACKED_RECT     2
+#define R_PACKED_COORDS   3
+#define R_PACKED_COLOR    4
+#define R_PACKED_ROTATION 5
+#define R_PACKED_MISC     6
+
+/* Attribute locations of the particle state in particles_gpu.vert &
+ * particles_gpu_draw.vert, a vec4 motion (position, velocity) & float life */
+#define R_PARTICLES_GPU_MOTION 2
+#define R_PARTICLES_GPU_LIFE   3
+#define R_PARTICLES_GPU_STRIDE (sizeof(float) * 5)
+
+/* Uniform locations cached by shader & name, so setting a uniform doesn't
+ * ask the driver for its location with a string every call */
+typedef struct {
+  r_shader shader;
+  uint32_t hash;
+  int32_t  loc;
+  char*    name;
+} r_uniform_entry;
+
+static r_uniform_entry* _r_uniforms;
+static uint32_t         _r_uniform_count, _r_uniform_capacity;
+
+// Names of the uniforms in r_uniform, with their hashes filled in on use
+static const char* r_uniform_names[R_UNIFORM_COUNT] = {
+    "view",   "projection", "model",  "mats",    "coords",  "colors",
+    "color",  "sheet_size", "flip_x", "flip_y",  "use_tex", "layer_mod",
+};
+static uint32_t r_uniform_hashes[R_UNIFORM_COUNT];
+
+static uint32_t r_uniform_hash(const char* name) {
+  uint32_t hash = 2166136261u;
+  while (*name) {
+    hash = (hash ^ (unsigned char)*name++) * 16777619u;
+  }
+  // 0 is used to mark unhashed names
+  return hash ? hash : 1;
+}
+
+static uint32_t r_uniform_slot(r_shader shader, uint32_t hash) {
+  return (hash ^ (shader * 2654435761u)) & (_r_uniform_capacity - 1);
+}
+
+// returns: index of the uniform in the cache, not found = -1
+static int32_t r_uniform_find(r_shader shader, const char* name,
+                              uint32_t hash) {
+  if (!_r_uniform_capacity) {
+    return -1;
+  }
+
+  uint32_t mask = _r_uniform_capacity - 1;
+  for (uint32_t i = r_uniform_slot(shader, hash); _r_uniforms[i].name;
+       i = (i + 1) & mask) {
+    r_uniform_entry* entry = &_r_uniforms[i];
+    if (entry->shader == shader && entry->hash == hash &&
+        !strcmp(entry->name, name)) {
+      return (int32_t)i;
+    }
+  }
+
+  return -1;
+}
+
+static void r_uniform_place(r_uniform_entry entry) {
+  uint32_t mask = _r_uniform_capacity - 1;
+  uint32_t i    = r_uniform_slot(entry.shader, entry.hash);
+
+  while (_r_uniforms[i].name) {
+    i = (i + 1) & mask;
+  }
+
+  _r_uniforms[i] = entry;
+  ++_r_uniform_count;
+}
+
+/* Rebuild the cache with a new capacity, dropping a shader's uniforms
+ * drop - the shader to drop, none = 0
+ * returns: success = 1, fail = 0 */
+static uint8_t r_uniform_rebuild(uint32_t capacity, r_shader drop) {
+  r_uniform_entry* old          = _r_uniforms;
+  uint32_t         old_capacity = _r_uniform_capacity;
+
+  r_uniform_entry* entries =
+      (r_uniform_entry*)calloc(capacity, sizeof(r_uniform_entry));
+
+  if (!entries) {
+    ASTERA_FUNC_DBG("unable to allocate %i uniform slots\n", capacity);
+    return 0;
+  }
+
+  _r_uniforms         = entries;
+  _r_uniform_capacity = capacity;
+  _r_uniform_count    = 0;
+
+  for (uint32_t i = 0; i < old_capacity; ++i) {
+    if (!old[i].name) {
+      continue;
+    }
+
+    if (drop && old[i].shader == drop) {
+      free(old[i].name);
+    } else {
+      r_uniform_place(old[i]);
+    }
+  }
+
+  free(old);
+  return 1;
+}
+
+static void r_uniform_insert(r_shader shader, const char* name, uint32_t hash,
+                             int32_t loc) {
+  // Keep the cache at most half full
+  if ((_r_uniform_count + 1) * 2 > _r_uniform_capacity) {
+    uint32_t capacity = _r_uniform_capacity ? _r_uniform_capacity * 2 : 64;
+    if (!r_uniform_rebuild(capacity, 0)) {
+      return;
+    }
+  }
+
+  size_t length = strlen(name);
+  char*  copy   = (char*)malloc(length + 1);
+
+  if (!copy) {
+    return;
+  }
+
+  memcpy(copy, name, length + 1);
+  r_uniform_place((r_uniform_entry){
+      .shader = shader, .hash = hash, .loc = loc, .name = copy});
+}
+
+static int r_uniform_loc(r_shader shader, const char* name, uint32_t hash) {
+  int32_t index = r_uniform_find(shader, name, hash);
+
+  if (index != -1) {
+    return _r_uniforms[index].loc;
+  }
+
+  // Names the shader doesn't use are cached too (as -1)
+  int loc = glGetUniformLocation(shader, name);
+  r_uniform_insert(shader, name, hash, loc);
+  return loc;
+}
+
+/* Attribute locations share the cache, keyed with a prefix no GLSL name can
+ * start with so they're dropped with the shader's uniforms */
+static int r_attrib_loc(r_shader shader, const char* name) {
+  char key[64];
+  snprintf(key, sizeof(key), "@%s", name);
+
+  uint32_t hash  = r_uniform_hash(key);
+  int32_t  index = r_uniform_find(shader, key, hash);
+
+  if (index != -1) {
+    return _r_uniforms[index].loc;
+  }
+
+  int loc = glGetAttribLocation(shader, name);
+  r_uniform_insert(shader, key, hash, loc);
+  return loc;
+}
+
+// Fill the cache with every active uniform in a shader
+static void r_uniform_load(r_shader shader) {
+  GLint count = 0;
+  glGetProgramiv(shader, GL_ACTIVE_UNIFORMS, &count);
+
+  for (GLint i = 0; i < count; ++i) {
+    char    name[128];
+    GLsizei length = 0;
+    GLint   size   = 0;
+    GLenum  type   = 0;
+
+    glGetActiveUniform(shader, (GLuint)i, sizeof(name), &length, &size, &type,
+                       name);
+
+    if (length <= 0) {
+      continue;
+    }
+
+    int loc = glGetUniformLocation(shader, name);
+    r_uniform_insert(shader, name, r_uniform_hash(name), loc);
+
+    // Arrays are listed as name[0], but set by their plain name
+    if (length > 3 && !strcmp(&name[length - 3], "[0]")) {
+      name[length - 3] = 0;
+      r_uniform_insert(shader, name, r_uniform_hash(name), loc);
+    }
+  }
+}
+
+static void r_uniform_forget(r_shader shader) {
+  if (_r_uniform_capacity) {
+    r_uniform_rebuild(_r_uniform_capacity, shader);
+  }
+}
+
+static void r_uniform_clear(void) {
+  for (uint32_t i = 0; i < _r_uniform_capacity; ++i) {
+    free(_r_uniforms[i].name);
+  }
+
+  free(_r_uniforms);
+  _r_uniforms         = 0;
+  _r_uniform_count    = 0;
+  _r_uniform_capacity = 0;
+}
+
+int r_get_uniform(r_shader shader, r_uniform uniform) {
+  if (uniform >= R_UNIFORM_COUNT) {
+    return -1;
+  }
+
+  if (!r_uniform_hashes[uniform]) {
+    r_uniform_hashes[uniform] = r_uniform_hash(r_uniform_names[uniform]);
+  }
+
+  return r_uniform_loc(shader, r_uniform_names[uniform],
+                       r_uniform_hashes[uniform]);
+}
+
+// A tracked binding that isn't known & has to be bound again
+#define R_STATE_UNKNOWN 0xFFFFFFFFu
+
+/* The r_state_* functions bind through the context's tracked state
+ * NOTE: a null ctx always binds */
+static void r_state_shader(r_ctx* ctx, r_shader shader) {
+  if (ctx) {
+    if (ctx->state.shader == shader) {
+      ++ctx->state.skipped;
+      return;
+    }
+
+    ctx->state.shader = shader;
+    ++ctx->state.issued;
+  }
+
+  glUseProgram(shader);
+}
+
+static void r_state_tex(r_ctx* ctx, uint32_t tex) {
+  if (ctx) {
+    if (ctx->state.tex == tex) {
+      ++ctx->state.skipped;
+      return;
+    }
+
+    ctx->state.tex = tex;
+    ++ctx->state.issued;
+  }
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, tex);
+}
+
+static void r_state_vao(r_ctx* ctx, uint32_t vao) {
+  if (ctx) {
+    if (ctx->state.vao == vao) {
+      ++ctx->state.skipped;
+      return;
+    }
+
+    ctx->state.vao = vao;
+    ++ctx->state.issued;
+  }
+
+  glBindVertexArray(vao);
+}
+
+// For functions without a context that bind or delete objects directly
+static void r_state_lost(void) {
+  if (_r_ctx) {
+    r_ctx_reset_state(_r_ctx);
+  }
+}
+
+// Point the packed instance attributes at the bound buffer
+static void r_instance_packed_attribs(void) {
+  GLsizei stride = sizeof(r_instance_packed);
+
+  glEnableVertexAttribArray(R_PACKED_RECT);
+  glVertexAttribPointer(R_PACKED_RECT, 4, GL_FLOAT, GL_FALSE, stride,
+                        (const void*)offsetof(r_instance_packed, x));
+  glVertexAttribDivisor(R_PACKED_RECT, 1);
+
+  glEnableVertexAttribArray(R_PACKED_COORDS);
+  glVertexAttribPointer(R_PACKED_COORDS, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                        (const void*)offsetof(r_instance_packed, coords));
+  glVertexAttribDivisor(R_PACKED_COORDS, 1);
+
+  glEnableVertexAttribArray(R_PACKED_COLOR);
+  glVertexAttribPointer(R_PACKED_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                        (const void*)offsetof(r_instance_packed, color));
+  glVertexAttribDivisor(R_PACKED_COLOR, 1);
+
+  glEnableVertexAttribArray(R_PACKED_ROTATION);
+  glVertexAttribIPointer(R_PACKED_ROTATION, 1, GL_UNSIGNED_SHORT, stride,
+                         (const void*)offsetof(r_instance_packed, rotation));
+  glVertexAttribDivisor(R_PACKED_ROTATION, 1);
+
+  glEnableVertexAttribArray(R_PACKED_MISC);
+  glVertexAttribIPointer(R_PACKED_MISC, 2, GL_UNSIGNED_BYTE, stride,
+                         (const void*)offsetof(r_instance_packed, layer));
+  glVertexAttribDivisor(R_PACKED_MISC, 1);
+}
+
+static r_instance_ring r_instance_ring_create(r_quad quad, uint32_t capacity,
+                                              uint8_t packed) {
+  GLsizei stride = packed ? sizeof(r_instance_packed) : sizeof(r_instance);
+  r_instance_ring ring =
+      (r_instance_ring){.capacity = capacity, .stride = (uint32_t)stride};
+
+  glGenVertexArrays(ASTERA_RENDER_INSTANCE_BUFFERS, ring.vaos);
+  glGenBuffers(ASTERA_RENDER_INSTANCE_BUFFERS, ring.buffers);
+
+  for (uint32_t i = 0; i < ASTERA_RENDER_INSTANCE_BUFFERS; ++i) {
+    glBindVertexArray(ring.vaos[i]);
+
+    // The quad's vertices, same as r_quad_create (interleaved)
+    glBindBuffer(GL_ARRAY_BUFFER, quad.vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad.vboi);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, (const void*)0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, (const void*)12);
+
+    glBindBuffer(GL_ARRAY_BUFFER, ring.buffers[i]);
+    glBufferData(GL_ARRAY_BUFFER, stride * capacity, 0, GL_STREAM_DRAW);
+
+    if (packed) {
+      r_instance_packed_attribs();
+      continue;
+    }
+
+    // A mat4 attribute takes up a location per column
+    for (uint32_t col = 0; col < 4; ++col) {
+      glEnableVertexAttribArray(R_INSTANCE_MODEL + col);
+      glVertexAttribPointer(
+          R_INSTANCE_MODEL + col, 4, GL_FLOAT, GL_FALSE, stride,
+          (const void*)(offsetof(r_instance, model) + sizeof(vec4) * col));
+      glVertexAttribDivisor(R_INSTANCE_MODEL + col, 1);
+    }
+
+    glEnableVertexAttribArray(R_INSTANCE_COORDS);
+    glVertexAttribPointer(R_INSTANCE_COORDS, 4, GL_FLOAT, GL_FALSE, stride,
+                          (const void*)offsetof(r_instance, coords));
+    glVertexAttribDivisor(R_INSTANCE_COORDS, 1);
+
+    glEnableVertexAttribArray(R_INSTANCE_COLOR);
+    glVertexAttribPointer(R_INSTANCE_COLOR, 4, GL_FLOAT, GL_FALSE, stride,
+                          (const void*)offsetof(r_instance, color));
+    glVertexAttribDivisor(R_INSTANCE_COLOR, 1);
+
+    glEnableVertexAttribArray(R_INSTANCE_FLIP);
+    glVertexAttribPointer(R_INSTANCE_FLIP, 2, GL_FLOAT, GL_FALSE, stride,
+                          (const void*)offsetof(r_instance, flip));
+    glVertexAttribDivisor(R_INSTANCE_FLIP, 1);
+  }
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  r_state_lost();
+
+  return ring;
+}
+
+static void r_instance_ring_destroy(r_instance_ring* ring) {
+  if (!ring->capacity) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < ASTERA_RENDER_INSTANCE_BUFFERS; ++i) {
+    if (ring->fences[i]) {
+      glDeleteSync((GLsync)ring->fences[i]);
+    }
+  }
+
+  glDeleteVertexArrays(ASTERA_RENDER_INSTANCE_BUFFERS, ring->vaos);
+  glDeleteBuffers(ASTERA_RENDER_INSTANCE_BUFFERS, ring->buffers);
+  *ring = (r_instance_ring){0};
+  r_state_lost();
+}
+
+/* Copy instances into the next buffer of the ring, without waiting on draws
+ * returns: the vertex array to draw the instances with */
+static uint32_t r_instance_ring_write(r_instance_ring* ring,
+                                      const void* instances, uint32_t count) {
+  uint32_t   slot  = ring->current;
+  GLsizeiptr size  = (GLsizeiptr)ring->stride * count;
+  ring->current    = (slot + 1) % ASTERA_RENDER_INSTANCE_BUFFERS;
+
+  glBindBuffer(GL_ARRAY_BUFFER, ring->buffers[slot]);
+
+  if (ring->fences[slot]) {
+    GLenum state = glClientWaitSync((GLsync)ring->fences[slot], 0, 0);
+
+    // Still being drawn from, let the driver hand out new storage instead
+    if (state == GL_TIMEOUT_EXPIRED) {
+      glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)ring->stride * ring->capacity,
+                   0, GL_STREAM_DRAW);
+      ++ring->orphans;
+    }
+
+    glDeleteSync((GLsync)ring->fences[slot]);
+    ring->fences[slot] = 0;
+  }
+
+  void* dst = glMapBufferRange(GL_ARRAY_BUFFER, 0, size,
+                               GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                                   GL_MAP_UNSYNCHRONIZED_BIT);
+
+  if (dst) {
+    memcpy(dst, instances, size);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  } else {
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return ring->vaos[slot];
+}
+
+// Set the fence for the buffer last written, once its draw is issued
+static void r_instance_ring_fence(r_instance_ring* ring) {
+  uint32_t slot = (ring->current + ASTERA_RENDER_INSTANCE_BUFFERS - 1) %
+                  ASTERA_RENDER_INSTANCE_BUFFERS;
+  ring->fences[slot] = (void*)glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
 static void r_batch_clear(r_batch* batch) {
+  if (batch->use_instances || batch->use_packed) {
+    batch->count = 0;
+    return;
+  }
+
   memset(batch->mats, 0, sizeof(mat4x4) * batch->count);
   memset(batch->coords, 0, sizeof(vec4) * batch->count);
   memset(batch->colors, 0, sizeof(vec4) * batch->count);
@@ -99,11 +560,45 @@ static void r_batch_clear(r_batch* batch) {
   batch->count = 0;
 }
 
-static void r_batch_check(r_batch* batch) {
+static void r_batch_check(r_ctx* ctx, r_batch* batch) {
   if (!batch) {
     return;
   }
 
+  // Shaders with per instance attributes get their data from the ring, the
+  // locations are cached since batches are checked for every run of sprites
+  batch->use_packed = r_attrib_loc(batch->shader, "in_rect") == R_PACKED_RECT;
+  batch->use_instances =
+      !batch->use_packed &&
+      r_attrib_loc(batch->shader, "in_model") == R_INSTANCE_MODEL;
+
+  if (batch->use_instances || batch->use_packed) {
+    uint32_t stride = batch->use_packed ? sizeof(r_instance_packed)
+                                        : sizeof(r_instance);
+
+    if (batch->use_packed && !batch->packed) {
+      batch->packed = (r_instance_packed*)calloc(batch->capacity,
+                                                 sizeof(r_instance_packed));
+    }
+
+    if (batch->use_instances && !batch->instances) {
+      batch->instances =
+          (r_instance*)calloc(batch->capacity, sizeof(r_instance));
+    }
+
+    // The batch went from one instance layout to the other
+    if (batch->ring.capacity && batch->ring.stride != stride) {
+      r_instance_ring_destroy(&batch->ring);
+    }
+
+    if (!batch->ring.capacity) {
+      batch->ring = r_instance_ring_create(ctx->default_quad, batch->capacity,
+                                           batch->use_packed);
+    }
+
+    return;
+  }
+
   if (!batch->mats) {
     batch->mats = (mat4x4*)calloc(batch->capacity, sizeof(mat4x4));
   }
@@ -125,53 +620,124 @@ static void r_batch_check(r_batch* batch) {
   }
 }
 
-static void r_batch_add(r_batch* batch, r_sprite* sprite) {
-  batch->flip_x[batch->count] = sprite->flip_x;
-  batch->flip_y[batch->count] = sprite->flip_y;
+// Rotation of r_instance_packed as a fraction of a turn
+#define R_PACKED_TURN 65536.f
 
-  mat4x4_dup(batch->mats[batch->count], sprite->model);
-  vec4_dup(batch->colors[batch->count], sprite->color);
+// Pack a [0, 1] float into a normalized byte or short
+static uint8_t r_pack_unorm8(float value) {
+  value = value < 0.f ? 0.f : value > 1.f ? 1.f : value;
+  return (uint8_t)(value * 255.f + 0.5f);
+}
 
-  if (sprite->animated) {
-    vec4_dup(batch->coords[batch->count],
-             batch->sheet
-                 ->subtexs[sprite->render.anim.anim
-                               ->frames[sprite->render.anim.curr]]
-                 .coords);
+static uint16_t r_pack_unorm16(float value) {
+  value = value < 0.f ? 0.f : value > 1.f ? 1.f : value;
+  return (uint16_t)(value * 65535.f + 0.5f);
+}
+
+static void r_instance_pack(r_instance_packed* dst, mat4x4 model,
+                            vec4 coords, vec4 color, uint8_t layer,
+                            uint8_t flip_x, uint8_t flip_y) {
+  dst->x = model[3][0];
+  dst->y = model[3][1];
+
+  // Most sprites aren't rotated, skip the trig for them
+  if (model[0][1] == 0.f && model[1][0] == 0.f) {
+    dst->w        = fabsf(model[0][0]);
+    dst->h        = fabsf(model[1][1]);
+    dst->rotation = 0;
   } else {
-    vec4_dup(batch->coords[batch->count],
-             batch->sheet->subtexs[sprite->render.tex].coords);
+    float angle = atan2f(model[0][1], model[0][0]);
+    if (angle < 0.f) {
+      angle += 2.f * (float)M_PI;
+    }
+
+    float turn = angle / (2.f * (float)M_PI) * R_PACKED_TURN;
+
+    dst->w        = sqrtf((model[0][0] * model[0][0]) +
+                   (model[0][1] * model[0][1]));
+    dst->h        = sqrtf((model[1][0] * model[1][0]) +
+                   (model[1][1] * model[1][1]));
+    dst->rotation = (uint16_t)((uint32_t)turn & 0xFFFF);
   }
 
-  ++batch->count;
+  for (uint8_t i = 0; i < 4; ++i) {
+    dst->coords[i] = r_pack_unorm16(coords[i]);
+    dst->color[i]  = r_pack_unorm8(color[i]);
+  }
+
+  dst->layer = layer;
+  dst->flags = (flip_x ? R_INSTANCE_PACKED_FLIP_X : 0) |
+               (flip_y ? R_INSTANCE_PACKED_FLIP_Y : 0);
 }
 
-static uint32_t r_batch_add_multi(r_batch* batch, r_sprite* sprites,
-                                  uint32_t count) {
-  for (uint32_t i = 0; i < count; ++i) {
-    if (batch->count == batch->capacity)
-      return i;
-    batch->flip_x[batch->count] = sprites[i].flip_x;
-    batch->flip_y[batch->count] = sprites[i].flip_y;
-
-    mat4x4_dup(batch->mats[batch->count], sprites[i].model);
-    vec4_dup(batch->colors[batch->count], sprites[i].color);
-
-    if (sprites[i].animated) {
-      vec4_dup(batch->coords[batch->count],
-               batch->sheet
-                   ->subtexs[sprites[i].render.anim.anim->frames
-                                 [sprites[i].render.anim.curr]]
-                   .coords);
-    } else {
-      vec4_dup(batch->coords[batch->count],
-               batch->sheet->subtexs[sprites[i].render.tex].coords);
+// Expand a packed instance for shaders that take a full r_instance
+static void r_instance_unpack(r_instance* dst, r_instance_packed* src) {
+  float* model = &dst->model[0][0];
+  float  c = 1.f, s = 0.f;
+
+  if (src->rotation) {
+    float angle = src->rotation * (2.f * (float)M_PI / R_PACKED_TURN);
+    c           = cosf(angle);
+    s           = sinf(angle);
+  }
+
+  memset(model, 0, sizeof(mat4x4));
+  model[0]  = c * src->w;
+  model[1]  = s * src->w;
+  model[4]  = -s * src->h;
+  model[5]  = c * src->h;
+  model[10] = 1.f;
+  model[12] = src->x;
+  model[13] = src->y;
+  model[14] = src->layer * ASTERA_RENDER_LAYER_MOD;
+  model[15] = 1.f;
+
+  for (uint8_t i = 0; i < 4; ++i) {
+    dst->coords[i] = src->coords[i] / 65535.f;
+    dst->color[i]  = src->color[i] / 255.f;
+  }
+
+  dst->flip[0] = (src->flags & R_INSTANCE_PACKED_FLIP_X) ? 1.f : 0.f;
+  dst->flip[1] = (src->flags & R_INSTANCE_PACKED_FLIP_Y) ? 1.f : 0.f;
+}
+
+/* Add a queued sprite to a batch, full instances are only packed for packed
+ * shaders & packed ones only expanded for the others */
+static void r_batch_add(r_batch* batch, r_command_buffer* buffer,
+                        r_command* command) {
+  r_instance* instance = &buffer->instances[command->instance];
+  r_instance  expanded;
+
+  if (command->packed) {
+    r_instance_packed* packed = &buffer->packed[command->instance];
+
+    if (batch->use_packed) {
+      batch->packed[batch->count] = *packed;
+      ++batch->count;
+      return;
     }
 
-    ++batch->count;
+    r_instance_unpack(&expanded, packed);
+    instance = &expanded;
+  }
+
+  if (batch->use_packed) {
+    r_instance_pack(&batch->packed[batch->count], instance->model,
+                    instance->coords, instance->color,
+                    (uint8_t)(command->key >> 56), instance->flip[0] != 0.f,
+                    instance->flip[1] != 0.f);
+  } else if (batch->use_instances) {
+    batch->instances[batch->count] = *instance;
+  } else {
+    batch->flip_x[batch->count] = (int)instance->flip[0];
+    batch->flip_y[batch->count] = (int)instance->flip[1];
+
+    mat4x4_dup(batch->mats[batch->count], instance->model);
+    vec4_dup(batch->colors[batch->count], instance->color);
+    vec4_dup(batch->coords[batch->count], instance->coords);
   }
 
-  return count;
+  ++batch->count;
 }
 
 static r_batch* r_batch_get(r_ctx* ctx, r_sheet* sheet, r_shader shader) {
@@ -189,9 +755,9 @@ static r_batch* r_batch_get(r_ctx* ctx, r_sheet* sheet, r_shader shader) {
     r_batch* batch = &ctx->batches[i];
 
     if (batch->count == 0) {
-      r_batch_check(batch);
       batch->sheet  = sheet;
       batch->shader = shader;
+      r_batch_check(ctx, batch);
 
       return batch;
     }
@@ -201,13 +767,13 @@ static r_batch* r_batch_get(r_ctx* ctx, r_sheet* sheet, r_shader shader) {
 }
 
 static void r_batch_draw(r_ctx* ctx, r_batch* batch) {
-  if (!batch->count) {
-    ASTERA_FUNC_DBG("nothing in batch to draw.\n");
+  if (!batch || !ctx) {
+    ASTERA_FUNC_DBG("incomplete arguments passed.\n");
     return;
   }
 
-  if (!batch || !ctx) {
-    ASTERA_FUNC_DBG("incomplete arguments passed.\n");
+  if (!batch->count) {
+    ASTERA_FUNC_DBG("nothing in batch to draw.\n");
     return;
   }
 
@@ -216,55 +782,313 @@ static void r_batch_draw(r_ctx* ctx, r_batch* batch) {
     return;
   }
 
-  r_shader_bind(batch->shader);
-  r_tex_bind(batch->sheet->id);
+  r_state_shader(ctx, batch->shader);
+  r_state_tex(ctx, batch->sheet->id);
 
-  vec2 sheet_size = {(float)batch->sheet->width, (float)batch->sheet->height};
-  r_set_v2(batch->shader, "sheet_size", sheet_size);
+  r_shader shader     = batch->shader;
+  vec2     sheet_size = {(float)batch->sheet->width,
+                     (float)batch->sheet->height};
+  r_set_v2i(r_get_uniform(shader, R_UNIFORM_SHEET_SIZE), sheet_size);
 
-  r_set_m4(batch->shader, "view", ctx->camera.view);
-  r_set_m4(batch->shader, "projection", ctx->camera.projection);
+  r_set_m4i(r_get_uniform(shader, R_UNIFORM_VIEW), ctx->camera.view);
+  r_set_m4i(r_get_uniform(shader, R_UNIFORM_PROJECTION),
+            ctx->camera.projection);
 
-  r_set_ix(batch->shader, batch->count, "flip_x", (int*)batch->flip_x);
-  r_set_ix(batch->shader, batch->count, "flip_y", (int*)batch->flip_y);
-  r_set_v4x(batch->shader, batch->count, "coords", batch->coords);
-  r_set_v4x(batch->shader, batch->count, "colors", batch->colors);
-  r_set_m4x(batch->shader, batch->count, "mats", batch->mats);
+  if (batch->use_instances || batch->use_packed) {
+    const void* data = batch->instances;
 
-  glBindVertexArray(ctx->default_quad.vao);
-  glBindBuffer(GL_ARRAY_BUFFER, ctx->default_quad.vbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->default_quad.vboi);
+    if (batch->use_packed) {
+      data = batch->packed;
+      r_set_uniformfi(r_get_uniform(shader, R_UNIFORM_LAYER_MOD),
+                      ASTERA_RENDER_LAYER_MOD);
+    }
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, (const void*)0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, (const void*)12);
+    uint32_t vao = r_instance_ring_write(&batch->ring, data, batch->count);
 
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
+    r_state_vao(ctx, vao);
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0,
+                            batch->count);
+    r_instance_ring_fence(&batch->ring);
+  } else {
+    r_set_ixi(r_get_uniform(shader, R_UNIFORM_FLIP_X), batch->count,
+              batch->flip_x);
+    r_set_ixi(r_get_uniform(shader, R_UNIFORM_FLIP_Y), batch->count,
+              batch->flip_y);
+    r_set_v4xi(r_get_uniform(shader, R_UNIFORM_COORDS), batch->count,
+               batch->coords);
+    r_set_v4xi(r_get_uniform(shader, R_UNIFORM_COLORS), batch->count,
+               batch->colors);
+    r_set_m4xi(r_get_uniform(shader, R_UNIFORM_MATS), batch->count,
+               batch->mats);
+
+    // The quad's vertex array holds its buffers & attribute layout
+    r_state_vao(ctx, ctx->default_quad.vao);
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0,
+                            batch->count);
+  }
 
-  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, batch->count);
+  r_batch_clear(batch);
+}
 
-  glDisableVertexAttribArray(0);
-  glDisableVertexAttribArray(1);
+static uint8_t r_commands_grow(r_command_buffer* buffer) {
+  uint32_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
 
-  r_batch_clear(batch);
+  r_command* commands =
+      (r_command*)realloc(buffer->commands, sizeof(r_command) * capacity);
+  if (!commands) {
+    return 0;
+  }
+  buffer->commands = commands;
 
-  glBindVertexArray(0);
-  r_tex_bind(0);
-  r_shader_bind(0);
+  r_command* sorted =
+      (r_command*)realloc(buffer->sorted, sizeof(r_command) * capacity);
+  if (!sorted) {
+    return 0;
+  }
+  buffer->sorted = sorted;
+
+  r_instance* instances =
+      (r_instance*)realloc(buffer->instances, sizeof(r_instance) * capacity);
+  if (!instances) {
+    return 0;
+  }
+  buffer->instances = instances;
+
+  r_instance_packed* packed = (r_instance_packed*)realloc(
+      buffer->packed, sizeof(r_instance_packed) * capacity);
+  if (!packed) {
+    return 0;
+  }
+  buffer->packed = packed;
+
+  buffer->capacity = capacity;
+  return 1;
 }
 
-uint32_t r_check_error(void) {
-  return glGetError();
+static void r_commands_destroy(r_command_buffer* buffer) {
+  free(buffer->commands);
+  free(buffer->sorted);
+  free(buffer->instances);
+  free(buffer->packed);
+  *buffer = (r_command_buffer){0};
 }
 
-uint32_t r_check_error_loc(const char* loc) {
-  uint32_t error = glGetError();
+// The amount of sprites tested against the camera at a time
+#define R_CULL_BLOCK 64
 
-  if (error != GL_NO_ERROR) {
-    ASTERA_DBG("GL Error: %i at location: %s\n", error, loc);
-  }
+// Get the center & half size of a sprite's quad from its model matrix
+static void r_sprite_extents(r_sprite* sprite, float* x, float* y,
+                             float* half_w, float* half_h) {
+  vec4* model = sprite->model;
 
-  return error;
+  *x      = model[3][0];
+  *y      = model[3][1];
+  *half_w = 0.5f * (fabsf(model[0][0]) + fabsf(model[1][0]));
+  *half_h = 0.5f * (fabsf(model[0][1]) + fabsf(model[1][1]));
+}
+
+// The index bits of a command's key, the order it was queued in
+#define R_COMMAND_INDEX 0xFFFFFFull
+
+static uint64_t r_commands_key(uint8_t layer, r_shader shader, r_sheet* sheet,
+                               uint32_t index) {
+  return ((uint64_t)layer << 56) | ((uint64_t)(shader & 0xFFFF) << 40) |
+         ((uint64_t)(sheet->id & 0xFFFF) << 24) | (index & R_COMMAND_INDEX);
+}
+
+// Grow the buffer until it can hold count commands
+// returns: success = 1, fail = 0
+static uint8_t r_commands_fit(r_command_buffer* buffer, uint32_t count) {
+  while (buffer->capacity < count) {
+    if (!r_commands_grow(buffer)) {
+      ASTERA_FUNC_DBG("unable to grow command buffer.\n");
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/* Queue a packed command, leaving its instance data for the caller to fill
+ * returns: the instance to fill, fail = 0 */
+static r_instance_packed* r_commands_reserve(r_ctx* ctx, uint8_t layer,
+                                             r_shader shader,
+                                             r_sheet* sheet) {
+  r_command_buffer* buffer = &ctx->commands;
+
+  if (!r_commands_fit(buffer, buffer->count + 1)) {
+    return 0;
+  }
+
+  uint32_t index = buffer->count;
+
+  buffer->commands[index] =
+      (r_command){.key      = r_commands_key(layer, shader, sheet, index),
+                  .sheet    = sheet,
+                  .shader   = shader,
+                  .instance = index,
+                  .packed   = 1};
+
+  ++buffer->count;
+  return &buffer->packed[index];
+}
+
+/* Write a sprite's command & instance into a slot the buffer already holds
+ * NOTE: this only touches the slot, so threads can fill separate slots */
+static void r_commands_write(r_command_buffer* buffer, uint32_t index,
+                             r_sprite* sprite) {
+  r_sheet* sheet = sprite->sheet;
+
+  buffer->commands[index] = (r_command){
+      .key      = r_commands_key(sprite->layer, sprite->shader, sheet, index),
+      .sheet    = sheet,
+      .shader   = sprite->shader,
+      .instance = index};
+
+  uint32_t subtex = sprite->animated ? sprite->render.anim.anim
+                                           ->frames[sprite->render.anim.curr]
+                                     : sprite->render.tex;
+
+  r_instance* instance = &buffer->instances[index];
+
+  mat4x4_dup(instance->model, sprite->model);
+  vec4_dup(instance->coords, sheet->subtexs[subtex].coords);
+  vec4_dup(instance->color, sprite->color);
+  instance->flip[0] = (float)sprite->flip_x;
+  instance->flip[1] = (float)sprite->flip_y;
+}
+
+/* Move count queued commands & their instances down from src to dst
+ * NOTE: only for commands written by r_commands_write (full instances) */
+static void r_commands_move(r_command_buffer* buffer, uint32_t dst,
+                            uint32_t src, uint32_t count) {
+  if (dst == src || !count) {
+    return;
+  }
+
+  memmove(&buffer->commands[dst], &buffer->commands[src],
+          sizeof(r_command) * count);
+  memmove(&buffer->instances[dst], &buffer->instances[src],
+          sizeof(r_instance) * count);
+
+  for (uint32_t i = dst; i < dst + count; ++i) {
+    r_command* command = &buffer->commands[i];
+    command->key = (command->key & ~R_COMMAND_INDEX) | (i & R_COMMAND_INDEX);
+    command->instance  = i;
+  }
+}
+
+// returns: success = 1, fail = 0
+static uint8_t r_commands_push(r_ctx* ctx, r_sprite* sprite) {
+  r_command_buffer* buffer = &ctx->commands;
+
+  if (!sprite->sheet) {
+    ASTERA_FUNC_DBG("sprite has no sheet.\n");
+    return 0;
+  }
+
+  if (!r_commands_fit(buffer, buffer->count + 1)) {
+    return 0;
+  }
+
+  r_commands_write(buffer, buffer->count, sprite);
+  ++buffer->count;
+
+  return 1;
+}
+
+/* Radix sort the commands by key, a byte at a time, skipping bytes every key
+ * shares (i.e layers when everything is on one)
+ * returns: the sorted commands (either commands or temp) */
+static r_command* r_commands_sort(r_command* commands, r_command* temp,
+                                  uint32_t count) {
+  r_command* src = commands;
+  r_command* dst = temp;
+
+  for (uint32_t shift = 0; shift < 64; shift += 8) {
+    uint32_t offsets[256] = {0};
+
+    for (uint32_t i = 0; i < count; ++i) {
+      ++offsets[(src[i].key >> shift) & 0xFF];
+    }
+
+    if (offsets[(src[0].key >> shift) & 0xFF] == count) {
+      continue;
+    }
+
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t size = offsets[i];
+      offsets[i]    = total;
+      total += size;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+      dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+    }
+
+    r_command* swap = src;
+    src             = dst;
+    dst             = swap;
+  }
+
+  return src;
+}
+
+// Draw the queued sprites, one batch per run of the same shader & sheet
+static void r_commands_draw(r_ctx* ctx) {
+  r_command_buffer* buffer = &ctx->commands;
+
+  if (!buffer->count) {
+    return;
+  }
+
+  r_command* sorted =
+      r_commands_sort(buffer->commands, buffer->sorted, buffer->count);
+  r_batch* batch = 0;
+
+  for (uint32_t i = 0; i < buffer->count; ++i) {
+    r_command* command = &sorted[i];
+
+    if (batch && (batch->shader != command->shader ||
+                  batch->sheet->id != command->sheet->id ||
+                  batch->count == batch->capacity)) {
+      r_batch_draw(ctx, batch);
+      batch = 0;
+    }
+
+    if (!batch) {
+      batch = r_batch_get(ctx, command->sheet, command->shader);
+
+      if (!batch || !batch->capacity) {
+        ASTERA_FUNC_DBG("no batch to draw with.\n");
+        batch = 0;
+        break;
+      }
+    }
+
+    r_batch_add(batch, buffer, command);
+  }
+
+  if (batch && batch->count) {
+    r_batch_draw(ctx, batch);
+  }
+
+  buffer->count = 0;
+}
+
+uint32_t r_check_error(void) {
+  return glGetError();
+}
+
+uint32_t r_check_error_loc(const char* loc) {
+  uint32_t error = glGetError();
+
+  if (error != GL_NO_ERROR) {
+    ASTERA_DBG("GL Error: %i at location: %s\n", error, loc);
+  }
+
+  return error;
 }
 
 r_quad r_quad_create(float width, float height, uint8_t use_vto) {
@@ -322,6 +1146,7 @@ r_quad r_quad_create(float width, float height, uint8_t use_vto) {
                GL_STATIC_DRAW);
 
   glBindVertexArray(0);
+  r_state_lost();
 
   return (r_quad){.vao     = vao,
                   .vbo     = vbo,
@@ -333,30 +1158,17 @@ r_quad r_quad_create(float width, float height, uint8_t use_vto) {
 }
 
 void r_quad_draw(r_quad quad) {
-  glBindVertexArray(quad.vao);
-
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
-
+  r_state_vao(_r_ctx, quad.vao);
   glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
-
-  glBindVertexArray(0);
-  glUseProgram(0);
 }
 
 void r_quad_draw_instanced(r_quad quad, uint32_t count) {
-  glBindVertexArray(quad.vao);
-
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
-
+  r_state_vao(_r_ctx, quad.vao);
   glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, count);
-
-  glBindVertexArray(0);
-  glUseProgram(0);
 }
 
 void r_quad_destroy(r_quad* quad) {
+  r_state_lost();
   glDeleteVertexArrays(1, &quad->vao);
   glDeleteBuffers(1, &quad->vbo);
   glDeleteBuffers(1, &quad->vboi);
@@ -435,6 +1247,8 @@ r_ctx* r_ctx_create(r_window_params params, uint8_t batch_count,
   ctx->shader_capacity = shader_map_size;
 
   ctx->default_quad = r_quad_create(1.f, 1.f, 0);
+  r_ctx_reset_state(ctx);
+  ctx->culling = 1;
 
   vec3 camera_position = {0.f, 0.f, 0.f};
   vec2 camera_size     = {(float)params.width, (float)params.height};
@@ -455,6 +1269,56 @@ void r_ctx_set_i_ctx(r_ctx* ctx, i_ctx* input) {
   ctx->input_ctx = input;
 }
 
+void r_ctx_reset_state(r_ctx* ctx) {
+  ctx->state.shader = R_STATE_UNKNOWN;
+  ctx->state.tex    = R_STATE_UNKNOWN;
+  ctx->state.vao    = R_STATE_UNKNOWN;
+}
+
+void r_ctx_set_culling(r_ctx* ctx, uint8_t enabled) {
+  ctx->culling = enabled;
+}
+
+uint8_t r_ctx_set_threads(r_ctx* ctx, uint32_t threads) {
+  if (ctx->jobs) {
+    s_pool_destroy(ctx->jobs);
+    ctx->jobs = 0;
+  }
+
+  if (!threads) {
+    return 1;
+  }
+
+  ctx->jobs = s_pool_create(threads);
+
+  if (!ctx->jobs) {
+    ASTERA_FUNC_DBG("unable to start %i worker threads\n", threads);
+    return 0;
+  }
+
+  return 1;
+}
+
+void r_ctx_get_culled(r_ctx* ctx, uint32_t* drawn, uint32_t* culled) {
+  if (drawn) {
+    *drawn = ctx->drawn;
+  }
+
+  if (culled) {
+    *culled = ctx->culled;
+  }
+}
+
+void r_ctx_get_binds(r_ctx* ctx, uint32_t* issued, uint32_t* skipped) {
+  if (issued) {
+    *issued = ctx->state.issued;
+  }
+
+  if (skipped) {
+    *skipped = ctx->state.skipped;
+  }
+}
+
 void r_ctx_destroy(r_ctx* ctx) {
   if (ctx->anims) {
     for (int i = 0; i < ctx->anim_count; ++i) {
@@ -499,12 +1363,28 @@ void r_ctx_destroy(r_ctx* ctx) {
 
       if (ctx->batches[i].flip_y)
         free(ctx->batches[i].flip_y);
+
+      if (ctx->batches[i].instances)
+        free(ctx->batches[i].instances);
+
+      if (ctx->batches[i].packed)
+        free(ctx->batches[i].packed);
+
+      r_instance_ring_destroy(&ctx->batches[i].ring);
     }
 
     free(ctx->batches);
   }
 
+  r_commands_destroy(&ctx->commands);
+  s_pool_destroy(ctx->jobs);
+
   r_quad_destroy(&ctx->default_quad);
+  r_uniform_clear();
+
+  if (_r_ctx == ctx) {
+    _r_ctx = 0;
+  }
 
   r_window_destroy(ctx);
   glfwTerminate();
@@ -517,6 +1397,8 @@ void r_ctx_update(r_ctx* ctx) {
 }
 
 void r_ctx_draw(r_ctx* ctx) {
+  r_commands_draw(ctx);
+
   for (uint32_t i = 0; i < ctx->batch_capacity; ++i) {
     r_batch* batch = &ctx->batches[i];
 
@@ -587,6 +1469,45 @@ void r_camera_center_to(r_camera* camera, vec2 point) {
   r_camera_update(camera);
 }
 
+void r_camera_get_bounds(r_camera* camera, vec4 dst) {
+  float half_w = camera->size[0] * 0.5f, half_h = camera->size[1] * 0.5f;
+  float center_x = camera->position[0] + half_w;
+  float center_y = camera->position[1] + half_h;
+
+  if (camera->rotation != 0.f) {
+    float c = fabsf(cosf(camera->rotation));
+    float s = fabsf(sinf(camera->rotation));
+
+    float rotated_w = (half_w * c) + (half_h * s);
+    half_h          = (half_w * s) + (half_h * c);
+    half_w          = rotated_w;
+  }
+
+  dst[0] = center_x - half_w;
+  dst[1] = center_y - half_h;
+  dst[2] = center_x + half_w;
+  dst[3] = center_y + half_h;
+}
+
+uint32_t r_cull_boxes(vec4 bounds, const float* x, const float* y,
+                      const float* half_w, const float* half_h,
+                      uint8_t* visible, uint32_t count) {
+  float    min_x = bounds[0], min_y = bounds[1];
+  float    max_x = bounds[2], max_y = bounds[3];
+  uint32_t inside = 0;
+
+  // No branches, so the compiler can test several boxes at once
+  for (uint32_t i = 0; i < count; ++i) {
+    uint8_t in = (x[i] + half_w[i] >= min_x) & (x[i] - half_w[i] <= max_x) &
+                 (y[i] + half_h[i] >= min_y) & (y[i] - half_h[i] <= max_y);
+
+    visible[i] = in;
+    inside += in;
+  }
+
+  return inside;
+}
+
 void r_camera_update(r_camera* camera) {
   mat4x4_identity(camera->view);
   mat4x4_translate(camera->view, -camera->position[0], -camera->position[1],
@@ -684,6 +1605,7 @@ r_framebuffer r_framebuffer_create(uint32_t width, uint32_t height,
                GL_STREAM_DRAW);
 
   glBindVertexArray(0);
+  r_state_lost();
 
   mat4x4_identity(fbo.model);
 
@@ -695,6 +1617,7 @@ void r_framebuffer_unbind(void) {
 }
 
 void r_framebuffer_destroy(r_framebuffer fbo) {
+  r_state_lost();
   glDeleteFramebuffers(1, &fbo.fbo);
   glDeleteTextures(1, &fbo.tex);
   glDeleteBuffers(1, &fbo.vbo);
@@ -710,38 +1633,18 @@ void r_framebuffer_bind(r_framebuffer fbo) {
 }
 
 void r_framebuffer_draw(r_ctx* ctx, r_framebuffer fbo) {
-  glBindVertexArray(fbo.vao);
-  glUseProgram(fbo.shader);
+  r_state_vao(ctx, fbo.vao);
+  r_state_shader(ctx, fbo.shader);
 
   r_set_uniformf(fbo.shader, "gamma", ctx->window.params.gamma);
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, fbo.tex);
-
-  glBindBuffer(GL_ARRAY_BUFFER, fbo.vbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fbo.vboi);
-
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, (const void*)0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, (const void*)12);
-
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
+  r_state_tex(ctx, fbo.tex);
 
   glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
-
-  glDisableVertexAttribArray(0);
-  glDisableVertexAttribArray(1);
-
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-  glBindVertexArray(0);
-  glUseProgram(0);
 }
 
 void r_tex_bind(uint32_t tex) {
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, tex);
+  r_state_tex(_r_ctx, tex);
 }
 
 r_tex r_tex_create(unsigned char* data, uint32_t length) {
@@ -758,6 +1661,7 @@ r_tex r_tex_create(unsigned char* data, uint32_t length) {
 
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE,
                img);
+  r_state_lost();
 
   stbi_image_free(img);
 
@@ -765,6 +1669,7 @@ r_tex r_tex_create(unsigned char* data, uint32_t length) {
 }
 
 void r_tex_destroy(r_tex* tex) {
+  r_state_lost();
   glDeleteTextures(1, &tex->id);
 }
 
@@ -794,6 +1699,7 @@ r_sheet r_sheet_create(unsigned char* data, uint32_t length, vec4* sub_sprites,
                img);
 
   glBindTexture(GL_TEXTURE_2D, 0);
+  r_state_lost();
 
   stbi_image_free(img);
 
@@ -828,6 +1734,7 @@ r_sheet r_sheet_create_tiled(unsigned char* data, uint32_t length,
                img);
 
   glBindTexture(GL_TEXTURE_2D, 0);
+  r_state_lost();
 
   stbi_image_free(img);
 
@@ -872,102 +1779,737 @@ r_sheet r_sheet_create_tiled(unsigned char* data, uint32_t length,
 }
 
 void r_sheet_destroy(r_sheet* sheet) {
+  r_state_lost();
   glDeleteTextures(1, &sheet->id);
   free(sheet->subtexs);
 }
 
-r_baked_sheet r_baked_sheet_create(r_sheet* sheet, r_baked_quad* quads,
-                                   uint32_t quad_count, vec2 position) {
-  if (!quads || !quad_count) {
-    ASTERA_FUNC_DBG("invalid quad parameters.\n");
-    return (r_baked_sheet){0};
+// Returned by r_atlas_fit when an image doesn't fit
+#define R_ATLAS_NO_FIT 0xFFFFFFFF
+
+/* Find how high an image sits if its left edge is at a skyline node
+ * returns: the y of the image's top edge, fail = R_ATLAS_NO_FIT */
+static uint32_t r_atlas_fit(r_atlas_page* page, uint32_t index,
+                            uint32_t width, uint32_t height) {
+  if (page->skyline[index].x + width > page->sheet.width) {
+    return R_ATLAS_NO_FIT;
   }
 
-  // vert: (x, y, z, s, t)
-  uint32_t vert_cap = quad_count * 4 * 5, vert_count = 0;
-  // ind: (0, 1, 2, 2, 3, 0)
-  uint32_t ind_cap = quad_count * 6, ind_count = 0;
-  // unique verts added (for ind offset calculation)
-  uint32_t uvert_count = 0;
+  uint32_t y = 0, left = width;
 
-  float*    verts = (float*)calloc(vert_cap, sizeof(float));
-  uint32_t* inds  = (uint32_t*)calloc(ind_cap, sizeof(uint32_t));
+  for (uint32_t i = index; left > 0 && i < page->node_count; ++i) {
+    r_atlas_node* node = &page->skyline[i];
 
-  uint32_t _inds[6]  = {0, 1, 2, 2, 3, 0};
-  float    _verts[8] = {-0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f, -0.5f, -0.5f};
-  float    _texcs[8] = {0.f, 1.f, 1.f, 1.f, 1.f, 0.f, 0.f, 0.f};
+    if (node->y > y) {
+      y = node->y;
+    }
 
-  vec4 bounds = {0.f, 0.f, 0.f, 0.f};
+    if (y + height > page->sheet.height) {
+      return R_ATLAS_NO_FIT;
+    }
 
-  for (uint32_t i = 0; i < quad_count; ++i) {
-    r_baked_quad* quad = &quads[i];
+    left = (node->width >= left) ? 0 : left - node->width;
+  }
 
-    if (quad->subtex >= sheet->count) {
-      continue;
-    }
+  return left ? R_ATLAS_NO_FIT : y;
+}
 
-    r_subtex* subtex = &sheet->subtexs[quad->subtex];
+// returns: success = 1, fail = 0
+static uint8_t r_atlas_node_insert(r_atlas_page* page, uint32_t index,
+                                   r_atlas_node node) {
+  if (page->node_count == page->node_capacity) {
+    uint32_t      capacity = page->node_capacity ? page->node_capacity * 2 : 16;
+    r_atlas_node* skyline  = (r_atlas_node*)realloc(
+        page->skyline, sizeof(r_atlas_node) * capacity);
 
-    vec2 _offset = {quad->x, quad->y};
-    vec2 _size   = {quad->width, quad->height};
+    if (!skyline) {
+      ASTERA_FUNC_DBG("unable to grow skyline to %i nodes.\n", capacity);
+      return 0;
+    }
 
-    vec2 _tex_offset = {subtex->coords[0], subtex->coords[1]};
-    vec2 _tex_size   = {subtex->coords[2], subtex->coords[3]};
-    vec2_sub(_tex_size, _tex_size, _tex_offset);
+    page->skyline       = skyline;
+    page->node_capacity = capacity;
+  }
 
-    for (uint8_t j = 0; j < 4; ++j) {
-      verts[vert_count]     = (_verts[j * 2] * _size[0]) + _offset[0];
-      verts[vert_count + 1] = (_verts[(j * 2) + 1] * _size[1]) + _offset[1];
-      verts[vert_count + 2] = (float)(quad->layer * ASTERA_RENDER_LAYER_MOD);
+  memmove(&page->skyline[index + 1], &page->skyline[index],
+          sizeof(r_atlas_node) * (page->node_count - index));
+  page->skyline[index] = node;
+  ++page->node_count;
 
-      float sample_x = _texcs[j * 2];
-      float sample_y = _texcs[(j * 2) + 1];
+  return 1;
+}
 
-      if (quad->flip_x) {
-        sample_x = 1.f - sample_x;
-      }
+static void r_atlas_node_remove(r_atlas_page* page, uint32_t index) {
+  --page->node_count;
+  memmove(&page->skyline[index], &page->skyline[index + 1],
+          sizeof(r_atlas_node) * (page->node_count - index));
+}
 
-      if (quad->flip_y) {
-        sample_y = 1.f - sample_y;
-      }
+/* Raise the skyline over a placed image
+ * returns: success = 1, fail = 0 */
+static uint8_t r_atlas_node_place(r_atlas_page* page, uint32_t index,
+                                  uint32_t y, uint32_t width,
+                                  uint32_t height) {
+  r_atlas_node node = {page->skyline[index].x, y + height, width};
 
-      verts[vert_count + 3] = (sample_x * _tex_size[0]) + _tex_offset[0];
-      verts[vert_count + 4] = (sample_y * _tex_size[1]) + _tex_offset[1];
+  if (!r_atlas_node_insert(page, index, node)) {
+    return 0;
+  }
 
-      vert_count += 5;
+  // Cut the nodes the image now covers
+  uint32_t right = node.x + node.width;
+  while (index + 1 < page->node_count) {
+    r_atlas_node* next = &page->skyline[index + 1];
+
+    if (next->x >= right) {
+      break;
     }
 
-    for (uint8_t j = 0; j < 6; ++j) {
-      inds[ind_count] = _inds[j] + uvert_count;
-      ++ind_count;
+    uint32_t covered = right - next->x;
+    if (next->width > covered) {
+      next->x += covered;
+      next->width -= covered;
+      break;
     }
-    uvert_count += 4;
+
+    r_atlas_node_remove(page, index + 1);
   }
 
-  uint32_t vao, vbo, vboi;
-  glGenVertexArrays(1, &vao);
-  glBindVertexArray(vao);
+  // Join neighbours at the same height
+  for (uint32_t i = 0; i + 1 < page->node_count;) {
+    if (page->skyline[i].y == page->skyline[i + 1].y) {
+      page->skyline[i].width += page->skyline[i + 1].width;
+      r_atlas_node_remove(page, i + 1);
+    } else {
+      ++i;
+    }
+  }
 
-  glGenBuffers(1, &vbo);
-  glGenBuffers(1, &vboi);
+  return 1;
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vert_count, verts,
-               GL_STATIC_DRAW);
+uint8_t r_atlas_page_pack(r_atlas_page* page, uint32_t width, uint32_t height,
+                          uint32_t* x, uint32_t* y) {
+  // Empty pages are one run along the bottom
+  if (!page->node_count) {
+    r_atlas_node node = {0, 0, page->sheet.width};
 
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, (const void*)0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, (const void*)12);
+    if (!r_atlas_node_insert(page, 0, node)) {
+      return 0;
+    }
+  }
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboi);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * ind_count, inds,
-               GL_STREAM_DRAW);
+  // Take the lowest spot, leftmost on ties
+  uint32_t best = R_ATLAS_NO_FIT, index = 0;
 
-  glBindVertexArray(0);
+  for (uint32_t i = 0; i < page->node_count; ++i) {
+    uint32_t top = r_atlas_fit(page, i, width, height);
 
-  free(verts);
-  free(inds);
+    if (top != R_ATLAS_NO_FIT && (best == R_ATLAS_NO_FIT || top < best)) {
+      best  = top;
+      index = i;
+    }
+  }
+
+  if (best == R_ATLAS_NO_FIT) {
+    return 0;
+  }
+
+  *x = page->skyline[index].x;
+  *y = best;
+
+  return r_atlas_node_place(page, index, best, width, height);
+}
+
+static uint32_t r_atlas_texture(uint32_t width, uint32_t height) {
+  uint32_t id;
+  glGenTextures(1, &id);
+  glBindTexture(GL_TEXTURE_2D, id);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, 0);
+
+  return id;
+}
+
+static void r_subtex_coords(r_sheet* sheet, r_subtex* subtex) {
+  float w = (float)sheet->width, h = (float)sheet->height;
+
+  vec4 coords = {subtex->x / w, subtex->y / h, (subtex->x + subtex->width) / w,
+                 (subtex->y + subtex->height) / h};
+  vec4_dup(subtex->coords, coords);
+}
+
+/* Resize a page's texture, copying what's packed into it so far
+ * returns: success = 1, fail = 0 */
+static uint8_t r_atlas_page_resize(r_atlas_page* page, uint32_t width,
+                                   uint32_t height) {
+  r_sheet* sheet = &page->sheet;
+  uint32_t id    = r_atlas_texture(width, height);
+
+  if (!id) {
+    ASTERA_FUNC_DBG("unable to create %ix%i page.\n", width, height);
+    return 0;
+  }
+
+  // Read the old texture thru a framebuffer into the new one
+  GLint  read = 0;
+  GLuint fbo;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read);
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                         GL_TEXTURE_2D, sheet->id, 0);
+  glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, sheet->width,
+                      sheet->height);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, read);
+  glDeleteFramebuffers(1, &fbo);
+
+  glDeleteTextures(1, &sheet->id);
+  r_state_lost();
+
+  // The skyline's open to the right of the old width
+  if (width > sheet->width && page->node_count) {
+    r_atlas_node node = {sheet->width, 0, width - sheet->width};
+
+    if (!r_atlas_node_insert(page, page->node_count, node)) {
+      return 0;
+    }
+  }
+
+  sheet->id     = id;
+  sheet->width  = width;
+  sheet->height = height;
+
+  for (uint32_t i = 0; i < sheet->count; ++i) {
+    r_subtex_coords(sheet, &sheet->subtexs[i]);
+  }
+
+  return 1;
+}
+
+/* Double the page's shorter side, as long as it stays under max_size
+ * returns: success = 1, fail = 0 */
+static uint8_t r_atlas_page_grow(r_atlas* atlas, r_atlas_page* page) {
+  uint32_t width = page->sheet.width, height = page->sheet.height;
+
+  if (width <= height && width * 2 <= atlas->max_size) {
+    width *= 2;
+  } else if (height * 2 <= atlas->max_size) {
+    height *= 2;
+  } else if (width * 2 <= atlas->max_size) {
+    width *= 2;
+  } else {
+    return 0;
+  }
+
+  return r_atlas_page_resize(page, width, height);
+}
+
+static r_atlas_page* r_atlas_page_add(r_atlas* atlas) {
+  if (atlas->page_count == atlas->page_capacity) {
+    uint32_t capacity = atlas->page_capacity ? atlas->page_capacity * 2 : 4;
+    r_atlas_page** pages = (r_atlas_page**)realloc(
+        atlas->pages, sizeof(r_atlas_page*) * capacity);
+
+    if (!pages) {
+      ASTERA_FUNC_DBG("unable to grow atlas to %i pages.\n", capacity);
+      return 0;
+    }
+
+    atlas->pages         = pages;
+    atlas->page_capacity = capacity;
+  }
+
+  r_atlas_page* page = (r_atlas_page*)calloc(1, sizeof(r_atlas_page));
+
+  if (!page) {
+    ASTERA_FUNC_DBG("unable to allocate atlas page.\n");
+    return 0;
+  }
+
+  page->sheet.id     = r_atlas_texture(atlas->page_size, atlas->page_size);
+  page->sheet.width  = atlas->page_size;
+  page->sheet.height = atlas->page_size;
+  r_state_lost();
+
+  atlas->pages[atlas->page_count++] = page;
+  return page;
+}
+
+/* Find room for an image: in any page, then by growing the newest page,
+ * then in a new page
+ * returns: the page with the image's area taken, fail = 0 */
+static r_atlas_page* r_atlas_place(r_atlas* atlas, uint32_t width,
+                                   uint32_t height, uint32_t* x,
+                                   uint32_t* y) {
+  uint32_t w = width + atlas->padding, h = height + atlas->padding;
+
+  if (w > atlas->max_size || h > atlas->max_size) {
+    ASTERA_FUNC_DBG("%ix%i is larger than the max page size.\n", width,
+                    height);
+    return 0;
+  }
+
+  for (uint32_t i = 0; i < atlas->page_count; ++i) {
+    if (r_atlas_page_pack(atlas->pages[i], w, h, x, y)) {
+      return atlas->pages[i];
+    }
+  }
+
+  if (atlas->page_count) {
+    r_atlas_page* last = atlas->pages[atlas->page_count - 1];
+
+    while (r_atlas_page_grow(atlas, last)) {
+      if (r_atlas_page_pack(last, w, h, x, y)) {
+        return last;
+      }
+    }
+  }
+
+  r_atlas_page* page = r_atlas_page_add(atlas);
+
+  if (!page) {
+    return 0;
+  }
+
+  // Images larger than page_size grow their page until they fit
+  while (!r_atlas_page_pack(page, w, h, x, y)) {
+    if (!r_atlas_page_grow(atlas, page)) {
+      return 0;
+    }
+  }
+
+  return page;
+}
+
+// Set a sub texture to an area of a sheet, with its origin at the center
+static void r_subtex_init(r_sheet* sheet, r_subtex* subtex, uint32_t x,
+                          uint32_t y, uint32_t width, uint32_t height) {
+  uint32_t ox = width / 2, oy = height / 2;
+
+  *subtex = (r_subtex){.x      = x,
+                       .y      = y,
+                       .width  = width,
+                       .height = height,
+                       .ox     = ox,
+                       .oy     = oy};
+
+  vec2 o_offset = {(float)ox / width, (float)oy / height};
+  vec2_dup(subtex->o_offset, o_offset);
+  r_subtex_coords(sheet, subtex);
+}
+
+// returns: the new sub texture's index, fail = R_ATLAS_NO_FIT
+static uint32_t r_atlas_subtex_add(r_atlas_page* page, uint32_t x, uint32_t y,
+                                   uint32_t width, uint32_t height) {
+  r_sheet* sheet = &page->sheet;
+
+  if (sheet->count == sheet->capacity) {
+    uint32_t  capacity = sheet->capacity ? sheet->capacity * 2 : 16;
+    r_subtex* subtexs  =
+        (r_subtex*)realloc(sheet->subtexs, sizeof(r_subtex) * capacity);
+
+    if (!subtexs) {
+      ASTERA_FUNC_DBG("unable to grow sheet to %i sub textures.\n",
+                      capacity);
+      return R_ATLAS_NO_FIT;
+    }
+
+    sheet->subtexs  = subtexs;
+    sheet->capacity = capacity;
+  }
+
+  r_subtex_init(sheet, &sheet->subtexs[sheet->count], x, y, width, height);
+  return sheet->count++;
+}
+
+r_atlas r_atlas_create(uint32_t page_size, uint32_t max_size,
+                       uint32_t padding) {
+  GLint gl_max = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &gl_max);
+
+  if (!max_size || (gl_max > 0 && max_size > (uint32_t)gl_max)) {
+    max_size = (gl_max > 0) ? (uint32_t)gl_max : 2048;
+  }
+
+  if (!page_size || page_size > max_size) {
+    ASTERA_FUNC_DBG("invalid page size %i.\n", page_size);
+    return (r_atlas){0};
+  }
+
+  return (r_atlas){
+      .page_size = page_size, .max_size = max_size, .padding = padding};
+}
+
+// Pack pixels into the atlas, leaving the sub textures to the caller
+static r_atlas_page* r_atlas_upload(r_atlas* atlas, unsigned char* pixels,
+                                    uint32_t width, uint32_t height,
+                                    uint32_t* x, uint32_t* y) {
+  if (!atlas || !atlas->page_size || !pixels || !width || !height) {
+    ASTERA_FUNC_DBG("invalid parameters passed.\n");
+    return 0;
+  }
+
+  r_atlas_page* page = r_atlas_place(atlas, width, height, x, y);
+
+  if (!page) {
+    return 0;
+  }
+
+  glBindTexture(GL_TEXTURE_2D, page->sheet.id);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, *x, *y, width, height, GL_RGBA,
+                  GL_UNSIGNED_BYTE, pixels);
+  r_state_lost();
+
+  return page;
+}
+
+r_atlas_region r_atlas_add_pixels(r_atlas* atlas, unsigned char* pixels,
+                                  uint32_t width, uint32_t height) {
+  uint32_t      x, y;
+  r_atlas_page* page = r_atlas_upload(atlas, pixels, width, height, &x, &y);
+
+  if (!page) {
+    return (r_atlas_region){0};
+  }
+
+  uint32_t subtex = r_atlas_subtex_add(page, x, y, width, height);
+
+  if (subtex == R_ATLAS_NO_FIT) {
+    return (r_atlas_region){0};
+  }
+
+  return (r_atlas_region){.sheet = &page->sheet, .subtex = subtex};
+}
+
+r_atlas_region r_atlas_add(r_atlas* atlas, unsigned char* data,
+                           uint32_t length) {
+  return r_atlas_add_tiled(atlas, data, length, 0, 0);
+}
+
+r_atlas_region r_atlas_add_tiled(r_atlas* atlas, unsigned char* data,
+                                 uint32_t length, uint32_t sub_width,
+                                 uint32_t sub_height) {
+  if (!data || !length) {
+    ASTERA_FUNC_DBG("invalid texture data passed.\n");
+    return (r_atlas_region){0};
+  }
+
+  int32_t        w, h, ch;
+  unsigned char* img = stbi_load_from_memory(data, length, &w, &h, &ch, 4);
+
+  if (!img) {
+    ASTERA_FUNC_DBG("unable to decode image.\n");
+    return (r_atlas_region){0};
+  }
+
+  // Untiled images are one tile the size of the image
+  if (!sub_width || !sub_height) {
+    sub_width  = (uint32_t)w;
+    sub_height = (uint32_t)h;
+  }
+
+  uint32_t      x, y;
+  r_atlas_page* page =
+      r_atlas_upload(atlas, img, (uint32_t)w, (uint32_t)h, &x, &y);
+  stbi_image_free(img);
+
+  if (!page) {
+    return (r_atlas_region){0};
+  }
+
+  uint32_t per_width = (uint32_t)w / sub_width;
+  uint32_t rows      = (uint32_t)h / sub_height;
+  uint32_t first     = page->sheet.count;
+
+  for (uint32_t i = 0; i < per_width * rows; ++i) {
+    uint32_t tile_x = x + (i % per_width) * sub_width;
+    uint32_t tile_y = y + (i / per_width) * sub_height;
+
+    if (r_atlas_subtex_add(page, tile_x, tile_y, sub_width, sub_height) ==
+        R_ATLAS_NO_FIT) {
+      return (r_atlas_region){0};
+    }
+  }
+
+  return (r_atlas_region){.sheet = &page->sheet, .subtex = first};
+}
+
+void r_atlas_destroy(r_atlas* atlas) {
+  for (uint32_t i = 0; i < atlas->page_count; ++i) {
+    r_atlas_page* page = atlas->pages[i];
+
+    r_sheet_destroy(&page->sheet);
+    free(page->skyline);
+    free(page);
+  }
+
+  free(atlas->pages);
+  *atlas = (r_atlas){0};
+}
+
+// GL_EXT_texture_compression_s3tc isn't in the core profile glad loads
+#define R_GL_COMPRESSED_RGBA_S3TC_DXT5 0x83F3
+
+uint64_t r_tex_level_size(r_tex_format format, uint32_t width,
+                          uint32_t height) {
+  if (format == R_TEX_BC3) {
+    return (((uint64_t)width + 3) / 4) * (((uint64_t)height + 3) / 4) * 16;
+  }
+
+  return (uint64_t)width * height * 4;
+}
+
+static uint8_t r_has_extension(const char* name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+  for (GLint i = 0; i < count; ++i) {
+    const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+
+    if (ext && !strcmp(ext, name)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+r_sheet r_sheet_create_packed(unsigned char* data, uint32_t length) {
+  r_tex_header header;
+
+  if (!data || length < sizeof(r_tex_header)) {
+    ASTERA_FUNC_DBG("invalid texture data passed.\n");
+    return (r_sheet){0};
+  }
+
+  // The pak's data isn't aligned for the header, so copy it out
+  memcpy(&header, data, sizeof(r_tex_header));
+
+  if (memcmp(header.magic, R_TEX_MAGIC, 4) != 0 ||
+      header.version != R_TEX_VERSION) {
+    ASTERA_FUNC_DBG("not a pre-decoded texture.\n");
+    return (r_sheet){0};
+  }
+
+  if (header.format > R_TEX_BC3 || !header.width || !header.height ||
+      !header.levels || header.levels > 32) {
+    ASTERA_FUNC_DBG("invalid texture header.\n");
+    return (r_sheet){0};
+  }
+
+  if (header.format == R_TEX_BC3 &&
+      !r_has_extension("GL_EXT_texture_compression_s3tc")) {
+    ASTERA_FUNC_DBG("block compressed textures aren't supported.\n");
+    return (r_sheet){0};
+  }
+
+  // Also keeps the level sizes from overflowing below
+  GLint gl_max = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &gl_max);
+
+  uint32_t max_size = (gl_max > 0) ? (uint32_t)gl_max : 2048;
+  if (header.width > max_size || header.height > max_size) {
+    ASTERA_FUNC_DBG("texture is bigger than the max size %i.\n", max_size);
+    return (r_sheet){0};
+  }
+
+  // Check every level is there before touching OpenGL
+  uint64_t table = sizeof(r_tex_header);
+  uint64_t start = table + (uint64_t)sizeof(r_tex_region) * header.subtex_count;
+  uint64_t end   = start;
+
+  for (uint32_t i = 0, w = header.width, h = header.height; i < header.levels;
+       ++i) {
+    end += r_tex_level_size((r_tex_format)header.format, w, h);
+    w = (w > 1) ? w / 2 : 1;
+    h = (h > 1) ? h / 2 : 1;
+  }
+
+  if (end > length) {
+    ASTERA_FUNC_DBG("texture data is truncated.\n");
+    return (r_sheet){0};
+  }
+
+  r_sheet sheet = (r_sheet){.width    = header.width,
+                            .height   = header.height,
+                            .count    = header.subtex_count,
+                            .capacity = header.subtex_count};
+
+  if (header.subtex_count) {
+    sheet.subtexs = (r_subtex*)calloc(header.subtex_count, sizeof(r_subtex));
+
+    if (!sheet.subtexs) {
+      ASTERA_FUNC_DBG("unable to allocate %i sub textures.\n",
+                      header.subtex_count);
+      return (r_sheet){0};
+    }
+  }
+
+  for (uint32_t i = 0; i < header.subtex_count; ++i) {
+    r_tex_region region;
+    memcpy(&region, data + table + (sizeof(r_tex_region) * i),
+           sizeof(r_tex_region));
+
+    if (!region.width || !region.height ||
+        (uint64_t)region.x + region.width > header.width ||
+        (uint64_t)region.y + region.height > header.height) {
+      ASTERA_FUNC_DBG("sub texture %i is out of bounds.\n", i);
+      free(sheet.subtexs);
+      return (r_sheet){0};
+    }
+
+    r_subtex_init(&sheet, &sheet.subtexs[i], region.x, region.y, region.width,
+                  region.height);
+  }
+
+  glGenTextures(1, &sheet.id);
+  glBindTexture(GL_TEXTURE_2D, sheet.id);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  (header.levels > 1) ? GL_NEAREST_MIPMAP_NEAREST
+                                      : GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.levels - 1);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  uint64_t offset = start;
+  for (uint32_t i = 0, w = header.width, h = header.height; i < header.levels;
+       ++i) {
+    uint64_t size = r_tex_level_size((r_tex_format)header.format, w, h);
+
+    if (header.format == R_TEX_BC3) {
+      glCompressedTexImage2D(GL_TEXTURE_2D, i, R_GL_COMPRESSED_RGBA_S3TC_DXT5,
+                             w, h, 0, (GLsizei)size, data + offset);
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, w, h, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, data + offset);
+    }
+
+    offset += size;
+    w = (w > 1) ? w / 2 : 1;
+    h = (h > 1) ? h / 2 : 1;
+  }
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  r_state_lost();
+
+  return sheet;
+}
+
+r_baked_sheet r_baked_sheet_create(r_sheet* sheet, r_baked_quad* quads,
+                                   uint32_t quad_count, vec2 position) {
+  if (!quads || !quad_count) {
+    ASTERA_FUNC_DBG("invalid quad parameters.\n");
+    return (r_baked_sheet){0};
+  }
+
+  // vert: (x, y, z, s, t)
+  uint32_t vert_cap = quad_count * 4 * 5, vert_count = 0;
+  // ind: (0, 1, 2, 2, 3, 0)
+  uint32_t ind_cap = quad_count * 6, ind_count = 0;
+  // unique verts added (for ind offset calculation)
+  uint32_t uvert_count = 0;
+
+  float*    verts = (float*)calloc(vert_cap, sizeof(float));
+  uint32_t* inds  = (uint32_t*)calloc(ind_cap, sizeof(uint32_t));
+
+  uint32_t _inds[6]  = {0, 1, 2, 2, 3, 0};
+  float    _verts[8] = {-0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f, -0.5f, -0.5f};
+  float    _texcs[8] = {0.f, 1.f, 1.f, 1.f, 1.f, 0.f, 0.f, 0.f};
+
+  vec4 bounds = {0.f, 0.f, 0.f, 0.f};
+
+  for (uint32_t i = 0; i < quad_count; ++i) {
+    r_baked_quad* quad = &quads[i];
+
+    if (quad->subtex >= sheet->count) {
+      continue;
+    }
+
+    r_subtex* subtex = &sheet->subtexs[quad->subtex];
+
+    vec2 _offset = {quad->x, quad->y};
+    vec2 _size   = {quad->width, quad->height};
+
+    vec2 _tex_offset = {subtex->coords[0], subtex->coords[1]};
+    vec2 _tex_size   = {subtex->coords[2], subtex->coords[3]};
+    vec2_sub(_tex_size, _tex_size, _tex_offset);
+
+    for (uint8_t j = 0; j < 4; ++j) {
+      verts[vert_count]     = (_verts[j * 2] * _size[0]) + _offset[0];
+      verts[vert_count + 1] = (_verts[(j * 2) + 1] * _size[1]) + _offset[1];
+      verts[vert_count + 2] = (float)(quad->layer * ASTERA_RENDER_LAYER_MOD);
+
+      if (uvert_count == 0 && j == 0) {
+        bounds[0] = bounds[2] = verts[vert_count];
+        bounds[1] = bounds[3] = verts[vert_count + 1];
+      }
+
+      bounds[0] = fminf(bounds[0], verts[vert_count]);
+      bounds[1] = fminf(bounds[1], verts[vert_count + 1]);
+      bounds[2] = fmaxf(bounds[2], verts[vert_count]);
+      bounds[3] = fmaxf(bounds[3], verts[vert_count + 1]);
+
+      float sample_x = _texcs[j * 2];
+      float sample_y = _texcs[(j * 2) + 1];
+
+      if (quad->flip_x) {
+        sample_x = 1.f - sample_x;
+      }
+
+      if (quad->flip_y) {
+        sample_y = 1.f - sample_y;
+      }
+
+      verts[vert_count + 3] = (sample_x * _tex_size[0]) + _tex_offset[0];
+      verts[vert_count + 4] = (sample_y * _tex_size[1]) + _tex_offset[1];
+
+      vert_count += 5;
+    }
+
+    for (uint8_t j = 0; j < 6; ++j) {
+      inds[ind_count] = _inds[j] + uvert_count;
+      ++ind_count;
+    }
+    uvert_count += 4;
+  }
+
+  uint32_t vao, vbo, vboi;
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+
+  glGenBuffers(1, &vbo);
+  glGenBuffers(1, &vboi);
+
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vert_count, verts,
+               GL_STATIC_DRAW);
+
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, (const void*)0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, (const void*)12);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboi);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * ind_count, inds,
+               GL_STREAM_DRAW);
+
+  glBindVertexArray(0);
+  r_state_lost();
+
+  free(verts);
+  free(inds);
 
   r_baked_sheet baked_sheet = (r_baked_sheet){
       .vao        = vao,
@@ -977,556 +2519,1977 @@ r_baked_sheet r_baked_sheet_create(r_sheet* sheet, r_baked_quad* quads,
       .sheet      = sheet,
   };
 
-  vec2 sheet_size = {bounds[2] - bounds[0], bounds[3] - bounds[1]};
-  vec2_dup(baked_sheet.size, sheet_size);
-  vec2_dup(baked_sheet.position, position);
+  vec2 sheet_size = {bounds[2] - bounds[0], bounds[3] - bounds[1]};
+  vec2_dup(baked_sheet.size, sheet_size);
+  vec2_dup(baked_sheet.position, position);
+  vec4_dup(baked_sheet.bounds, bounds);
+
+  mat4x4_identity(baked_sheet.model);
+  mat4x4_translate(baked_sheet.model, position[0], position[1], 0.f);
+  mat4x4_scale_aniso(baked_sheet.model, baked_sheet.model, 1.f, 1.f, 1.f);
+
+  return baked_sheet;
+}
+
+void r_baked_sheet_draw(r_ctx* ctx, r_shader shader, r_baked_sheet* sheet) {
+  if (shader == 0) {
+    ASTERA_FUNC_DBG("invalid shader.\n");
+    return;
+  }
+
+  if (ctx->culling) {
+    vec4 bounds;
+    r_camera_get_bounds(&ctx->camera, bounds);
+
+    float half_w = (sheet->bounds[2] - sheet->bounds[0]) * 0.5f;
+    float half_h = (sheet->bounds[3] - sheet->bounds[1]) * 0.5f;
+    float x      = sheet->position[0] + sheet->bounds[0] + half_w;
+    float y      = sheet->position[1] + sheet->bounds[1] + half_h;
+
+    uint8_t inside;
+    if (!r_cull_boxes(bounds, &x, &y, &half_w, &half_h, &inside, 1)) {
+      ++ctx->culled;
+      return;
+    }
+
+    ++ctx->drawn;
+  }
+
+  r_state_shader(ctx, shader);
+
+  r_set_m4i(r_get_uniform(shader, R_UNIFORM_PROJECTION),
+            ctx->camera.projection);
+  r_set_m4i(r_get_uniform(shader, R_UNIFORM_VIEW), ctx->camera.view);
+  r_set_m4i(r_get_uniform(shader, R_UNIFORM_MODEL), sheet->model);
+
+  r_state_tex(ctx, sheet->sheet->id);
+  r_state_vao(ctx, sheet->vao);
+
+  glDrawElements(GL_TRIANGLES, sheet->quad_count * 8, GL_UNSIGNED_INT, 0);
+}
+
+void r_baked_sheet_destroy(r_baked_sheet* sheet) {
+  r_state_lost();
+  glDeleteBuffers(1, &sheet->vbo);
+  glDeleteBuffers(1, &sheet->vto);
+  glDeleteBuffers(1, &sheet->vboi);
+  glDeleteVertexArrays(1, &sheet->vao);
+}
+
+// Round a count up to fill the last group of 4 for the SIMD kernels
+static uint32_t r_padded4(uint32_t count) {
+  return (count + 3) & ~3u;
+}
+
+/* Age 4 particles by delta & move them by their velocity over it
+ * NOTE: Particles that die are moved too, r_particles_kill removes them */
+static inline void r_particles_step4(float* life, float* x, float* y,
+                                     const float* vx, const float* vy,
+                                     float delta) {
+#if defined(R_SIMD_SSE)
+  __m128 step = _mm_set1_ps(delta);
+
+  _mm_storeu_ps(life, _mm_sub_ps(_mm_loadu_ps(life), step));
+  _mm_storeu_ps(x, _mm_add_ps(_mm_loadu_ps(x),
+                              _mm_mul_ps(_mm_loadu_ps(vx), step)));
+  _mm_storeu_ps(y, _mm_add_ps(_mm_loadu_ps(y),
+                              _mm_mul_ps(_mm_loadu_ps(vy), step)));
+#elif defined(R_SIMD_NEON)
+  vst1q_f32(life, vsubq_f32(vld1q_f32(life), vdupq_n_f32(delta)));
+  vst1q_f32(x, vaddq_f32(vld1q_f32(x), vmulq_n_f32(vld1q_f32(vx), delta)));
+  vst1q_f32(y, vaddq_f32(vld1q_f32(y), vmulq_n_f32(vld1q_f32(vy), delta)));
+#else
+  for (uint32_t i = 0; i < 4; ++i) {
+    life[i] -= delta;
+    x[i] += vx[i] * delta;
+    y[i] += vy[i] * delta;
+  }
+#endif
+}
+
+// returns: a bit for each of 4 particles with no life left
+static inline uint32_t r_particles_dead4(const float* life) {
+#if defined(R_SIMD_SSE)
+  return (uint32_t)_mm_movemask_ps(
+      _mm_cmple_ps(_mm_loadu_ps(life), _mm_setzero_ps()));
+#elif defined(R_SIMD_NEON)
+  static const uint32_t bits[4] = {1, 2, 4, 8};
+
+  uint32x4_t dead =
+      vandq_u32(vcleq_f32(vld1q_f32(life), vdupq_n_f32(0.f)), vld1q_u32(bits));
+  uint32x2_t sum = vadd_u32(vget_low_u32(dead), vget_high_u32(dead));
+  return vget_lane_u32(vpadd_u32(sum, sum), 0);
+#else
+  uint32_t dead = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    dead |= (uint32_t)(life[i] <= 0.f) << i;
+  }
+  return dead;
+#endif
+}
+
+/* Find the animation frame of 4 particles from how long they've lived, like
+ * r_anim_frame_at, but with the frame ends summed up front (once per update)
+ * rate - the length of each frame, 0 if the frames have their own lengths
+ * total - the length of the whole animation if the frames have lengths
+ * max - the highest frame to return */
+static inline void r_particles_frames4(uint32_t* frames, const float* life,
+                                       float particle_life, r_anim* anim,
+                                       float rate, float total, uint32_t max) {
+#if defined(R_SIMD_SSE2)
+  __m128 zero = _mm_setzero_ps();
+  __m128 time =
+      _mm_max_ps(_mm_sub_ps(_mm_set1_ps(particle_life), _mm_loadu_ps(life)),
+                 zero);
+
+  // Wrap a value by a length (a - b * trunc(a / b), corrected for rounding)
+  __m128 length = rate > 0.f ? _mm_set1_ps((float)anim->count)
+                             : _mm_set1_ps(total);
+  __m128 value  = time;
+  if (rate > 0.f) {
+    value = _mm_cvtepi32_ps(
+        _mm_cvttps_epi32(_mm_mul_ps(time, _mm_set1_ps(1.f / rate))));
+  }
+
+  __m128 loops = _mm_cvtepi32_ps(
+      _mm_cvttps_epi32(_mm_div_ps(value, length)));
+  __m128 rest  = _mm_sub_ps(value, _mm_mul_ps(loops, length));
+  rest = _mm_add_ps(rest, _mm_and_ps(_mm_cmplt_ps(rest, zero), length));
+  rest = _mm_sub_ps(rest, _mm_and_ps(_mm_cmpge_ps(rest, length), length));
+
+  __m128 frame = rest;
+  if (rate <= 0.f) {
+    // Only looping animations wrap, & only once they're past the end
+    if (anim->loop) {
+      __m128 over = _mm_cmpgt_ps(time, length);
+      time        = _mm_or_ps(_mm_and_ps(over, rest),
+                              _mm_andnot_ps(over, time));
+    }
+
+    __m128 one = _mm_set1_ps(1.f);
+    float  end = 0.f;
+
+    frame = zero;
+    for (uint32_t i = 0; i < anim->count; ++i) {
+      end += (float)anim->lengths[i];
+      frame = _mm_add_ps(frame,
+                         _mm_and_ps(_mm_cmplt_ps(_mm_set1_ps(end), time), one));
+    }
+  }
+
+  frame = _mm_min_ps(frame, _mm_set1_ps((float)max));
+  _mm_storeu_si128((__m128i*)frames, _mm_cvttps_epi32(frame));
+#elif defined(R_SIMD_NEON)
+  float32x4_t zero = vdupq_n_f32(0.f);
+  float32x4_t time =
+      vmaxq_f32(vsubq_f32(vdupq_n_f32(particle_life), vld1q_f32(life)), zero);
+
+  // Wrap a value by a length (a - b * trunc(a / b), corrected for rounding)
+  float       size   = rate > 0.f ? (float)anim->count : total;
+  float32x4_t length = vdupq_n_f32(size);
+  float32x4_t value  = time;
+  if (rate > 0.f) {
+    value = vcvtq_f32_s32(vcvtq_s32_f32(vmulq_n_f32(time, 1.f / rate)));
+  }
+
+  float32x4_t loops =
+      vcvtq_f32_s32(vcvtq_s32_f32(vmulq_n_f32(value, 1.f / size)));
+  float32x4_t rest = vsubq_f32(value, vmulq_f32(loops, length));
+  rest = vaddq_f32(rest, vreinterpretq_f32_u32(
+                             vandq_u32(vcltq_f32(rest, zero),
+                                       vreinterpretq_u32_f32(length))));
+  rest = vsubq_f32(rest, vreinterpretq_f32_u32(
+                             vandq_u32(vcgeq_f32(rest, length),
+                                       vreinterpretq_u32_f32(length))));
+
+  float32x4_t frame = rest;
+  if (rate <= 0.f) {
+    // Only looping animations wrap, & only once they're past the end
+    if (anim->loop) {
+      time = vbslq_f32(vcgtq_f32(time, length), rest, time);
+    }
+
+    float32x4_t one = vdupq_n_f32(1.f);
+    float       end = 0.f;
+
+    frame = zero;
+    for (uint32_t i = 0; i < anim->count; ++i) {
+      end += (float)anim->lengths[i];
+      frame = vaddq_f32(
+          frame, vreinterpretq_f32_u32(
+                     vandq_u32(vcltq_f32(vdupq_n_f32(end), time),
+                               vreinterpretq_u32_f32(one))));
+    }
+  }
+
+  frame = vminq_f32(frame, vdupq_n_f32((float)max));
+  vst1q_u32(frames, vcvtq_u32_f32(frame));
+#else
+  float size = rate > 0.f ? (float)anim->count : total;
+
+  for (uint32_t j = 0; j < 4; ++j) {
+    float time = particle_life - life[j];
+    if (time < 0.f) {
+      time = 0.f;
+    }
+
+    // Wrap a value by a length (a - b * trunc(a / b), corrected for rounding)
+    float value = rate > 0.f ? (float)(int32_t)(time * (1.f / rate)) : time;
+    float rest  = value - (float)(int32_t)(value / size) * size;
+    if (rest < 0.f) {
+      rest += size;
+    }
+    if (rest >= size) {
+      rest -= size;
+    }
+
+    float frame = rest;
+    if (rate <= 0.f) {
+      // Only looping animations wrap, & only once they're past the end
+      if (anim->loop && time > size) {
+        time = rest;
+      }
+
+      float end = 0.f;
+
+      frame = 0.f;
+      for (uint32_t i = 0; i < anim->count; ++i) {
+        end += (float)anim->lengths[i];
+        frame += (float)(end < time);
+      }
+    }
+
+    frames[j] = (uint32_t)(frame < (float)max ? frame : (float)max);
+  }
+#endif
+}
+
+// Copy a particle out of a system's arrays
+static void r_particle_get(r_particle_arrays* data, uint32_t index,
+                           r_particle* particle) {
+  *particle = (r_particle){0};
+
+  particle->life         = data->life[index];
+  particle->rotation     = data->rotation[index];
+  particle->position[0]  = data->x[index];
+  particle->position[1]  = data->y[index];
+  particle->size[0]      = data->width[index];
+  particle->size[1]      = data->height[index];
+  particle->velocity[0]  = data->vx[index];
+  particle->velocity[1]  = data->vy[index];
+  particle->direction[0] = data->dir_x[index];
+  particle->direction[1] = data->dir_y[index];
+  particle->layer        = data->layers[index];
+  particle->frame        = data->frames[index];
+  vec4_dup(particle->color, data->colors[index]);
+}
+
+// Copy a particle into a system's arrays
+static void r_particle_set(r_particle_arrays* data, uint32_t index,
+                           r_particle* particle) {
+  data->life[index]     = particle->life;
+  data->rotation[index] = particle->rotation;
+  data->x[index]        = particle->position[0];
+  data->y[index]        = particle->position[1];
+  data->width[index]    = particle->size[0];
+  data->height[index]   = particle->size[1];
+  data->vx[index]       = particle->velocity[0];
+  data->vy[index]       = particle->velocity[1];
+  data->dir_x[index]    = particle->direction[0];
+  data->dir_y[index]    = particle->direction[1];
+  data->layers[index]   = particle->layer;
+  data->frames[index]   = particle->frame;
+  vec4_dup(data->colors[index], particle->color);
+}
+
+// Copy one particle over another within a system's arrays
+static void r_particle_copy(r_particle_arrays* data, uint32_t dst,
+                            uint32_t src) {
+  data->life[dst]     = data->life[src];
+  data->rotation[dst] = data->rotation[src];
+  data->x[dst]        = data->x[src];
+  data->y[dst]        = data->y[src];
+  data->width[dst]    = data->width[src];
+  data->height[dst]   = data->height[src];
+  data->vx[dst]       = data->vx[src];
+  data->vy[dst]       = data->vy[src];
+  data->dir_x[dst]    = data->dir_x[src];
+  data->dir_y[dst]    = data->dir_y[src];
+  data->layers[dst]   = data->layers[src];
+  data->frames[dst]   = data->frames[src];
+  vec4_dup(data->colors[dst], data->colors[src]);
+}
+
+static void r_particle_arrays_destroy(r_particle_arrays* data) {
+  free(data->x);
+  free(data->y);
+  free(data->vx);
+  free(data->vy);
+  free(data->life);
+  free(data->rotation);
+  free(data->width);
+  free(data->height);
+  free(data->dir_x);
+  free(data->dir_y);
+  free(data->frames);
+  free(data->colors);
+  free(data->layers);
+  *data = (r_particle_arrays){0};
+}
+
+// returns: success = 1, fail = 0
+static uint8_t r_particle_arrays_create(r_particle_arrays* data,
+                                        uint32_t           capacity) {
+  uint32_t padded = r_padded4(capacity);
+
+  data->x        = (float*)calloc(padded, sizeof(float));
+  data->y        = (float*)calloc(padded, sizeof(float));
+  data->vx       = (float*)calloc(padded, sizeof(float));
+  data->vy       = (float*)calloc(padded, sizeof(float));
+  data->life     = (float*)calloc(padded, sizeof(float));
+  data->rotation = (float*)calloc(padded, sizeof(float));
+  data->width    = (float*)calloc(padded, sizeof(float));
+  data->height   = (float*)calloc(padded, sizeof(float));
+  data->dir_x    = (float*)calloc(padded, sizeof(float));
+  data->dir_y    = (float*)calloc(padded, sizeof(float));
+  data->frames   = (uint32_t*)calloc(padded, sizeof(uint32_t));
+  data->colors   = (vec4*)calloc(padded, sizeof(vec4));
+  data->layers   = (uint8_t*)calloc(padded, sizeof(uint8_t));
+
+  if (!data->x || !data->y || !data->vx || !data->vy || !data->life ||
+      !data->rotation || !data->width || !data->height || !data->dir_x ||
+      !data->dir_y || !data->frames || !data->colors || !data->layers) {
+    r_particle_arrays_destroy(data);
+    return 0;
+  }
+
+  return 1;
+}
+
+// Swap the last live particle into each one that has died
+static void r_particles_kill(r_particles* system) {
+  r_particle_arrays* data  = &system->data;
+  uint32_t           group = 0;
+
+  while (group < system->count) {
+    uint32_t dead = r_particles_dead4(&data->life[group]);
+
+    // The rest of the last group is padding or particles that already died
+    if (system->count - group < 4) {
+      dead &= (1u << (system->count - group)) - 1;
+    }
+
+    if (!dead) {
+      group += 4;
+      continue;
+    }
+
+    uint32_t lane = 0;
+    while (!(dead & (1u << lane))) {
+      ++lane;
+    }
+
+    // Test the group again, the particle moved in might have died too
+    --system->count;
+    r_particle_copy(data, group + lane, system->count);
+  }
+}
+
+/* Set the frames of the particles [start, start + count) from their life
+ * NOTE: start must be a multiple of 4 */
+static void r_particles_frames(r_particles* system, uint32_t start,
+                               uint32_t count) {
+  r_anim* anim = system->render.anim.anim;
+
+  if (!anim || !anim->count) {
+    return;
+  }
+
+  float rate = 0.f, total = 0.f;
+  if (anim->rate > 0.f || !anim->lengths) {
+    rate = (float)anim->rate;
+  } else {
+    for (uint32_t i = 0; i < anim->count; ++i) {
+      total += (float)anim->lengths[i];
+    }
+  }
+
+  uint32_t* frames = system->data.frames;
+  if (rate <= 0.f && total <= 0.f) {
+    memset(&frames[start], 0, sizeof(uint32_t) * count);
+    return;
+  }
+
+  // Groups past the end of the range fall within the padding
+  for (uint32_t i = start; i < start + count; i += 4) {
+    r_particles_frames4(&frames[i], &system->data.life[i],
+                        system->particle_life, anim, rate, total,
+                        system->render.anim.count);
+  }
+}
+
+// Seeds particle systems in the order they're created
+static uint64_t r_particles_seeds = 0;
+
+r_particles r_particles_create(uint32_t emit_rate, float particle_life,
+                               uint32_t particle_capacity, uint32_t emit_count,
+                               int8_t particle_type, int8_t calculate,
+                               uint16_t uniform_cap) {
+  r_particles particles = (r_particles){0};
+
+  if (!particle_capacity) {
+    return particles;
+  }
+
+  particles.time       = 0;
+  particles.spawn_time = 0;
+  particles.alive      = 0;
+  particles.spawn_rate = MS_TO_SEC / emit_rate;
+
+  particles.calculate      = calculate;
+  particles.max_emission   = emit_count;
+  particles.emission_count = 0;
+
+  if (calculate) {
+    particles.mats   = (mat4x4*)malloc(sizeof(mat4x4) * uniform_cap);
+    particles.colors = (vec4*)malloc(sizeof(vec4) * uniform_cap);
+    particles.coords = (vec4*)malloc(sizeof(vec4) * uniform_cap);
+  }
+
+  particles.uniform_cap  = uniform_cap;
+  particles.uniform_size = calculate ? uniform_cap : 0;
+
+  particles.particle_life = particle_life;
+
+  particles.type = particle_type;
+
+  particles.particle_size[0] = 1.f;
+  particles.particle_size[1] = 1.f;
+
+  particles.position[0] = 0.f;
+  particles.position[1] = 0.f;
+
+  particles.size[0] = 0.f;
+  particles.size[1] = 0.f;
+
+  if (!r_particle_arrays_create(&particles.data, particle_capacity)) {
+    ASTERA_FUNC_DBG("unable to allocate %i particles.\n", particle_capacity);
+    r_particles_destroy(&particles);
+    return (r_particles){0};
+  }
+
+  particles.capacity = particle_capacity;
+  particles.count    = 0;
+
+  r_particles_set_seed(&particles, r_particles_seeds++);
+
+  return particles;
+}
+
+void r_particles_set_seed(r_particles* system, uint64_t seed) {
+  system->seed = seed;
+  system->rng  = s_rand_create(seed, 0);
+}
+
+void r_particles_start(r_particles* particles) {
+  r_particles_reset(particles);
+  particles->alive = 1;
+}
+
+void r_particles_stop(r_particles* particles) {
+  particles->alive = 0;
+}
+
+void r_particles_resume(r_particles* particles) {
+  particles->alive = 1;
+}
+
+void r_particles_reset(r_particles* particles) {
+  particles->time           = 0.f;
+  particles->spawn_time     = 0.f;
+  particles->count          = 0;
+  particles->emission_count = 0;
+  particles->uniform_count  = 0;
+  particles->alive          = 0;
+  particles->prepared       = 0;
+  particles->rng            = s_rand_create(particles->seed, 0);
+
+  if (particles->calculate) {
+    memset(particles->mats, 0, sizeof(mat4x4) * particles->uniform_cap);
+    memset(particles->colors, 0, sizeof(vec4) * particles->uniform_cap);
+    memset(particles->coords, 0, sizeof(vec4) * particles->uniform_cap);
+  }
+}
+
+uint8_t r_particles_finished(r_particles* particles) {
+  return !particles->alive;
+}
+
+uint32_t r_particles_frame_at(r_particles* system, time_s time) {
+  if (system->type == PARTICLE_ANIMATED) {
+    return r_anim_frame_at(system->render.anim.anim, time);
+  } else {
+    return system->render.subtex;
+  }
+}
+
+void r_particles_set_system(r_particles* system, float lifetime,
+                            float prespawn) {
+  system->system_life = lifetime;
+
+  float change = prespawn;
+  if (system->prespawn != 0.f) {
+    change -= system->prespawn;
+  }
+
+  system->prespawn = prespawn;
+
+  if (change > 0.f) {
+    uint32_t rounds = (uint32_t)(change / 100.f);
+    for (uint32_t i = 0; i < rounds; ++i) {
+      r_particles_update(system, (change > 100.f) ? 100.f : change);
+      change -= 100.f;
+    }
+  }
+}
+
+void r_particles_set_position(r_particles* system, vec2 position) {
+  vec2_dup(system->position, position);
+}
+
+void r_particles_set_size(r_particles* system, vec2 size) {
+  vec2_dup(system->size, size);
+}
+
+void r_particles_set_particle(r_particles* system, vec4 color,
+                              float particle_life, vec2 particle_size,
+                              vec2 particle_velocity) {
+  if (!system)
+    return;
+
+  if (color) {
+    vec4_dup(system->color, color);
+  }
+
+  if (particle_life != 0.f) {
+    system->particle_life = particle_life;
+  }
+
+  if (particle_size) {
+    vec2_dup(system->particle_size, particle_size);
+  }
+
+  if (particle_velocity) {
+    vec2_dup(system->particle_velocity, particle_velocity);
+  }
+}
+
+/* Advance a system's timers by delta & find how many particles are due
+ * live - the amount of particles still alive (or 1 if unknown), the system
+ *        ends once it's past its life (or emission) with none left
+ * room - the most particles there's space to spawn
+ * returns: the amount of particles to spawn */
+static uint32_t r_particles_due(r_particles* system, time_s delta,
+                                uint32_t live, uint32_t room) {
+  if (!system->alive) {
+    return 0;
+  }
+
+  system->time += (float)delta;
+  system->spawn_time += (float)delta;
+  int32_t to_spawn = (int32_t)system->spawn_time / system->spawn_rate;
+
+  // cap to the room left in the system's buffers
+  if (to_spawn >= (int32_t)room) {
+    to_spawn = room;
+  }
+
+  // cap to max emission
+  /*if (system->max_emission) {
+    if (to_spawn + system->emission_count > system->max_emission) {
+      to_spawn = system->max_emission - system->emission_count;
+    }
+  }*/
+
+  system->spawn_time -= system->spawn_rate * to_spawn;
+  if (((system->time > system->system_life && system->system_life > 0.f) ||
+       (system->emission_count > system->max_emission &&
+        system->max_emission > 0))) {
+    if (live == 0) {
+      system->alive = 0;
+      return 0;
+    } else {
+      to_spawn = 0;
+    }
+  }
+
+  uint32_t spawn = to_spawn > 0 ? (uint32_t)to_spawn : 0;
+  return spawn > room ? room : spawn;
+}
+
+// Spawn the particles due over delta
+static void r_particles_spawn(r_particles* system, time_s delta) {
+  if (system->alive) {
+    uint32_t first = system->count;
+    uint32_t spawn = r_particles_due(system, delta, system->count,
+                                     system->capacity - system->count);
+
+    // Live particles are packed at the front, so the next slot is always open
+    for (uint32_t i = 0; i < spawn; ++i) {
+      r_particle open = (r_particle){0};
+
+      open.life = system->particle_life;
+      vec2_dup(open.size, system->particle_size);
+      vec2_dup(open.velocity, system->particle_velocity);
+      vec4_dup(open.color, system->color);
+
+      if (system->use_spawner) {
+        system->spawner_func(system, &open);
+      } else {
+        open.layer = system->particle_layer;
+
+        if (system->type == PARTICLE_ANIMATED) {
+          open.frame = 0;
+        } else if (system->type == PARTICLE_TEXTURED) {
+          open.frame = system->render.subtex;
+        }
+      }
+
+      r_particle_set(&system->data, system->count, &open);
+
+      ++system->emission_count;
+      ++system->count;
+    }
+
+    // Spread the default particles over the system's area
+    if (!system->use_spawner) {
+      s_rand_fill(&system->rng, &system->data.x[first], spawn, 0.f,
+                  system->size[0]);
+      s_rand_fill(&system->rng, &system->data.y[first], spawn, 0.f,
+                  system->size[1]);
+    }
+  }
+}
+
+// Age & move every particle, then drop the ones that died
+static void r_particles_step(r_particles* system, time_s delta) {
+  r_particle_arrays* data   = &system->data;
+  uint32_t           padded = r_padded4(system->count);
+  float              step   = (float)delta;
+
+  for (uint32_t i = 0; i < padded; i += 4) {
+    r_particles_step4(&data->life[i], &data->x[i], &data->y[i], &data->vx[i],
+                      &data->vy[i], step);
+  }
+
+  r_particles_kill(system);
+}
+
+/* Run the animator (or find the frames) of the particles
+ * [start, start + count)
+ * NOTE: start must be a multiple of 4 */
+static void r_particles_animate(r_particles* system, uint32_t start,
+                                uint32_t count) {
+  r_particle_arrays* data = &system->data;
+
+  if (system->use_animator) {
+    if (system->batch_animator_func) {
+      (*system->batch_animator_func)(system, start, count);
+    } else {
+      for (uint32_t i = start; i < start + count; ++i) {
+        r_particle particle;
+        r_particle_get(data, i, &particle);
+        (*system->animator_func)(system, &particle);
+        r_particle_set(data, i, &particle);
+      }
+    }
+  } else if (system->type == PARTICLE_ANIMATED) {
+    r_particles_frames(system, start, count);
+  }
+}
+
+void r_particles_update(r_particles* system, time_s delta) {
+  r_particles_spawn(system, delta);
+  r_particles_step(system, delta);
+  r_particles_animate(system, 0, system->count);
+  system->prepared = 0;
+}
+
+void r_particles_set_anim(r_particles* particles, r_anim* anim) {
+  if (!particles)
+    return;
+
+  particles->sheet       = anim->sheet;
+  particles->render.anim = r_anim_create_viewer(anim);
+}
+
+void r_particles_set_subtex(r_particles* particles, r_sheet* sheet,
+                            uint32_t subtex) {
+  if (!particles)
+    return;
+
+  particles->sheet         = sheet;
+  particles->render.subtex = subtex;
+}
+
+void r_particles_set_color(r_particles* particles, vec4 color,
+                           uint8_t color_only) {
+  if (!particles || !color)
+    return;
+
+  vec4_dup(particles->color, color);
+
+  if (color_only) {
+    particles->type = PARTICLE_COLORED;
+  }
+}
+
+void r_particles_destroy(r_particles* particles) {
+  r_particle_arrays_destroy(&particles->data);
+
+  if (particles->calculate) {
+    free(particles->colors);
+    free(particles->coords);
+    free(particles->mats);
+  }
+
+  particles->capacity = 0;
+  particles->count    = 0;
+}
+
+// Draw count particles from the uniform arrays, starting at first
+static void r_particles_render(r_ctx* ctx, r_particles* particles,
+                               r_shader shader, uint32_t first,
+                               uint32_t count) {
+  r_state_shader(ctx, shader);
+  if ((particles->type == PARTICLE_ANIMATED ||
+       particles->type == PARTICLE_TEXTURED) &&
+      particles->sheet) {
+    r_state_tex(ctx, particles->sheet->id);
+    r_set_uniformii(r_get_uniform(shader, R_UNIFORM_USE_TEX), 1);
+  } else {
+    r_set_uniformii(r_get_uniform(shader, R_UNIFORM_USE_TEX), 0);
+  }
+
+  r_set_m4i(r_get_uniform(shader, R_UNIFORM_VIEW), ctx->camera.view);
+  r_set_m4i(r_get_uniform(shader, R_UNIFORM_PROJECTION),
+            ctx->camera.projection);
+  // r_set_m4(shader, "model", system->model);
+
+  r_set_v4xi(r_get_uniform(shader, R_UNIFORM_COORDS), count,
+             &particles->coords[first]);
+  r_set_v4xi(r_get_uniform(shader, R_UNIFORM_COLORS), count,
+             &particles->colors[first]);
+  r_set_m4xi(r_get_uniform(shader, R_UNIFORM_MATS), count,
+             &particles->mats[first]);
+
+  r_state_vao(ctx, ctx->default_quad.vao);
+  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, count);
+}
+
+// Draw the particles waiting in the uniform arrays & clear them out
+static void r_particles_flush(r_ctx* ctx, r_particles* particles,
+                              r_shader shader) {
+  r_particles_render(ctx, particles, shader, 0, particles->uniform_count);
+
+  // Clear out the uniforms for the next draw call
+  memset(particles->mats, 0, sizeof(mat4x4) * particles->uniform_count);
+  memset(particles->colors, 0, sizeof(vec4) * particles->uniform_count);
+  memset(particles->coords, 0, sizeof(vec4) * particles->uniform_count);
+  particles->uniform_count = 0;
+}
+
+/* Cull the particles [start, start + count) & write the visible ones into
+ * the uniform arrays from slot on
+ * bounds - the camera's bounds
+ * culling - whether to cull the particles
+ * returns: the amount of particles written */
+static uint32_t r_particles_prepare(r_particles* particles, vec4 bounds,
+                                    uint8_t culling, uint32_t start,
+                                    uint32_t count, uint32_t slot) {
+  r_particle_arrays* data  = &particles->data;
+  r_sheet*           sheet = particles->sheet;
+  uint8_t            textured =
+      sheet && (particles->type == PARTICLE_TEXTURED ||
+                particles->type == PARTICLE_ANIMATED);
+
+  // Particles are relative to the system, so move the camera instead
+  vec4 local = {bounds[0] - particles->position[0],
+                bounds[1] - particles->position[1],
+                bounds[2] - particles->position[0],
+                bounds[3] - particles->position[1]};
+
+  float    half[R_CULL_BLOCK];
+  uint8_t  inside[R_CULL_BLOCK];
+  uint32_t written = 0;
+
+  for (uint32_t block = start; block < start + count; block += R_CULL_BLOCK) {
+    uint32_t size = start + count - block;
+    if (size > R_CULL_BLOCK) {
+      size = R_CULL_BLOCK;
+    }
+
+    if (culling) {
+      // Half of width + height covers the particle at any rotation
+      for (uint32_t j = 0; j < size; ++j) {
+        half[j] = (data->width[block + j] + data->height[block + j]) * 0.5f;
+      }
+
+      r_cull_boxes(local, &data->x[block], &data->y[block], half, half, inside,
+                   size);
+    } else {
+      memset(inside, 1, size);
+    }
+
+    for (uint32_t j = 0; j < size; ++j) {
+      uint32_t i = block + j;
+
+      if (!inside[j]) {
+        continue;
+      }
+
+      uint32_t to  = slot + written;
+      mat4x4*  mat = &particles->mats[to];
+
+      mat4x4_identity(*mat);
+      mat4x4_translate(*mat, particles->position[0] + data->x[i],
+                       particles->position[1] + data->y[i],
+                       data->layers[i] * ASTERA_RENDER_LAYER_MOD);
+      mat4x4_scale_aniso(*mat, *mat, data->width[i], data->height[i], 1.f);
+      mat4x4_rotate_z(*mat, *mat, data->rotation[i]);
+
+      vec4_dup(particles->colors[to], data->colors[i]);
+
+      if (textured) {
+        vec4_dup(particles->coords[to], sheet->subtexs[data->frames[i]].coords);
+      }
+
+      ++written;
+    }
+  }
+
+  return written;
+}
+
+void r_particles_draw(r_ctx* ctx, r_particles* particles, r_shader shader) {
+  if (particles->calculate && particles->prepared) {
+    mat4x4_translate(particles->model, particles->position[0],
+                     particles->position[1], 0);
+
+    // r_particles_update_many wrote every visible particle already
+    for (uint32_t first = 0; first < particles->uniform_count;
+         first += particles->uniform_cap) {
+      uint32_t count = particles->uniform_count - first;
+      if (count > particles->uniform_cap) {
+        count = particles->uniform_cap;
+      }
+
+      r_particles_render(ctx, particles, shader, first, count);
+    }
+
+    particles->uniform_count = 0;
+    particles->prepared      = 0;
+  } else if (particles->calculate && particles->uniform_cap) {
+    mat4x4_translate(particles->model, particles->position[0],
+                     particles->position[1], 0);
 
-  mat4x4_identity(baked_sheet.model);
-  mat4x4_translate(baked_sheet.model, position[0], position[1], 0.f);
-  mat4x4_scale_aniso(baked_sheet.model, baked_sheet.model, 1.f, 1.f, 1.f);
+    vec4 bounds;
+    r_camera_get_bounds(&ctx->camera, bounds);
 
-  return baked_sheet;
+    // Write as many particles as the arrays have room for between draws
+    for (uint32_t start = 0; start < particles->count;) {
+      uint32_t count = particles->uniform_cap - particles->uniform_count;
+      if (count > particles->count - start) {
+        count = particles->count - start;
+      }
+
+      uint32_t written =
+          r_particles_prepare(particles, bounds, ctx->culling, start, count,
+                              particles->uniform_count);
+      particles->uniform_count += written;
+      start += count;
+
+      if (ctx->culling) {
+        ctx->drawn += written;
+        ctx->culled += count - written;
+      }
+
+      if (particles->uniform_count == particles->uniform_cap) {
+        r_particles_flush(ctx, particles, shader);
+      }
+    }
+
+    if (particles->uniform_count != 0) {
+      r_particles_flush(ctx, particles, shader);
+    }
+  } else {
+    r_particles_flush(ctx, particles, shader);
+  }
 }
 
-void r_baked_sheet_draw(r_ctx* ctx, r_shader shader, r_baked_sheet* sheet) {
-  if (shader == 0) {
-    ASTERA_FUNC_DBG("invalid shader.\n");
-    return;
+void r_particles_set_spawner(r_particles* system, r_particle_spawner spawner) {
+  system->use_spawner  = 1;
+  system->spawner_func = spawner;
+}
+
+void r_particles_set_animator(r_particles*        system,
+                              r_particle_animator animator) {
+  system->use_animator        = 1;
+  system->animator_func       = animator;
+  system->batch_animator_func = 0;
+}
+
+void r_particles_set_batch_animator(r_particles*              system,
+                                    r_particle_batch_animator animator) {
+  system->use_animator        = 1;
+  system->animator_func       = 0;
+  system->batch_animator_func = animator;
+}
+
+void r_particles_remove_spawner(r_particles* system) {
+  system->use_spawner  = 0;
+  system->spawner_func = 0;
+}
+
+void r_particles_remove_animator(r_particles* system) {
+  system->use_animator        = 0;
+  system->animator_func       = 0;
+  system->batch_animator_func = 0;
+}
+
+/* Point the particle state attributes at the bound buffer
+ * divisor - 0 to read a particle per vertex, 1 per instance */
+static void r_particles_gpu_attribs(GLuint divisor) {
+  GLsizei stride = R_PARTICLES_GPU_STRIDE;
+
+  glEnableVertexAttribArray(R_PARTICLES_GPU_MOTION);
+  glVertexAttribPointer(R_PARTICLES_GPU_MOTION, 4, GL_FLOAT, GL_FALSE, stride,
+                        (const void*)0);
+  glVertexAttribDivisor(R_PARTICLES_GPU_MOTION, divisor);
+
+  glEnableVertexAttribArray(R_PARTICLES_GPU_LIFE);
+  glVertexAttribPointer(R_PARTICLES_GPU_LIFE, 1, GL_FLOAT, GL_FALSE, stride,
+                        (const void*)(sizeof(float) * 4));
+  glVertexAttribDivisor(R_PARTICLES_GPU_LIFE, divisor);
+}
+
+r_particles_gpu r_particles_gpu_create(r_ctx* ctx, r_particles* system,
+                                       r_shader update, uint32_t capacity) {
+  r_particles_gpu particles = (r_particles_gpu){0};
+
+  if (!ctx || !system || !update || !capacity) {
+    ASTERA_FUNC_DBG("invalid system, shader or capacity passed.\n");
+    return particles;
   }
 
-  r_shader_bind(shader);
+  // Particles with no life left aren't drawn, so zeroed buffers start empty
+  void* empty = calloc(capacity, R_PARTICLES_GPU_STRIDE);
 
-  r_set_m4(shader, "projection", ctx->camera.projection);
-  r_set_m4(shader, "view", ctx->camera.view);
-  r_set_m4(shader, "model", sheet->model);
+  if (!empty) {
+    ASTERA_FUNC_DBG("unable to allocate %i particles.\n", capacity);
+    return particles;
+  }
 
-  r_tex_bind(sheet->sheet->id);
+  particles.system   = system;
+  particles.update   = update;
+  particles.capacity = capacity;
 
-  glBindVertexArray(sheet->vao);
+  glGenVertexArrays(2, particles.vaos);
+  glGenVertexArrays(2, particles.draw_vaos);
+  glGenBuffers(2, particles.buffers);
 
-  glBindBuffer(GL_ARRAY_BUFFER, sheet->vbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sheet->vboi);
+  for (uint32_t i = 0; i < 2; ++i) {
+    glBindBuffer(GL_ARRAY_BUFFER, particles.buffers[i]);
+    glBufferData(GL_ARRAY_BUFFER, R_PARTICLES_GPU_STRIDE * capacity, empty,
+                 GL_DYNAMIC_COPY);
 
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, (const void*)0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, (const void*)12);
+    glBindVertexArray(particles.vaos[i]);
+    r_particles_gpu_attribs(0);
 
-  glDrawElements(GL_TRIANGLES, sheet->quad_count * 8, GL_UNSIGNED_INT, 0);
+    // The quad's vertices, same as r_quad_create (interleaved)
+    glBindVertexArray(particles.draw_vaos[i]);
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->default_quad.vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->default_quad.vboi);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, (const void*)0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, (const void*)12);
 
-  glDisableVertexAttribArray(0);
-  glDisableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, particles.buffers[i]);
+    r_particles_gpu_attribs(1);
+  }
 
   glBindVertexArray(0);
-  r_tex_bind(0);
-  r_shader_bind(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  r_state_lost();
+
+  free(empty);
+  return particles;
 }
 
-void r_baked_sheet_destroy(r_baked_sheet* sheet) {
-  glDeleteBuffers(1, &sheet->vbo);
-  glDeleteBuffers(1, &sheet->vto);
-  glDeleteBuffers(1, &sheet->vboi);
-  glDeleteVertexArrays(1, &sheet->vao);
+void r_particles_gpu_update(r_ctx* ctx, r_particles_gpu* particles,
+                            time_s delta) {
+  r_particles* system = particles->system;
+
+  if (!system || !particles->capacity) {
+    ASTERA_FUNC_DBG("invalid GPU particle system passed.\n");
+    return;
+  }
+
+  // Slots are reused in spawn order, so there's always room to spawn
+  uint32_t live  = particles->remaining > 0.f;
+  uint32_t spawn = r_particles_due(system, delta, live, particles->capacity);
+
+  if (spawn) {
+    particles->remaining = system->particle_life;
+  } else if (!live) {
+    return;
+  }
+
+  particles->remaining -= (float)delta;
+
+  r_shader shader = particles->update;
+  uint64_t seed   = system->seed;
+
+  r_state_shader(ctx, shader);
+  r_set_uniformf(shader, "delta", (float)delta);
+  r_set_uniformf(shader, "life", system->particle_life);
+  r_set_v2(shader, "area", system->size);
+  r_set_v2(shader, "velocity", system->particle_velocity);
+  r_set_uniformi(shader, "spawn_first", (int)particles->next);
+  r_set_uniformi(shader, "spawn_count", (int)spawn);
+  r_set_uniformi(shader, "capacity", (int)particles->capacity);
+  r_set_uniformi(shader, "emitted", (int)system->emission_count);
+  r_set_uniformi(shader, "seed", (int)(uint32_t)(seed ^ (seed >> 32)));
+
+  uint32_t target = particles->current ^ 1;
+
+  // Only the outputs are wanted, nothing is drawn
+  glEnable(GL_RASTERIZER_DISCARD);
+  r_state_vao(ctx, particles->vaos[particles->current]);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, particles->buffers[target]);
+
+  glBeginTransformFeedback(GL_POINTS);
+  glDrawArrays(GL_POINTS, 0, (GLsizei)particles->capacity);
+  glEndTransformFeedback();
+
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  glDisable(GL_RASTERIZER_DISCARD);
+
+  particles->current = target;
+  particles->next    = (particles->next + spawn) % particles->capacity;
+  system->emission_count += spawn;
 }
 
-r_particles r_particles_create(uint32_t emit_rate, float particle_life,
-                               uint32_t particle_capacity, uint32_t emit_count,
-                               int8_t particle_type, int8_t calculate,
-                               uint16_t uniform_cap) {
-  r_particles particles = (r_particles){0};
+// Set the frames (or sub texture) to draw a GPU particle system with
+static void r_particles_gpu_frames(r_particles* system, r_shader shader) {
+  vec4     coords[ASTERA_PARTICLES_GPU_FRAMES];
+  float    ends[ASTERA_PARTICLES_GPU_FRAMES] = {0};
+  uint32_t count = 1;
+  float    rate  = 0.f;
+  r_sheet* sheet = system->sheet;
+  r_anim*  anim  = system->render.anim.anim;
 
-  if (!particle_capacity) {
-    return particles;
+  if (system->type == PARTICLE_ANIMATED && anim && anim->count) {
+    count = anim->count;
+    if (count > ASTERA_PARTICLES_GPU_FRAMES) {
+      count = ASTERA_PARTICLES_GPU_FRAMES;
+    }
+
+    if (anim->rate > 0.f || !anim->lengths) {
+      rate = (float)anim->rate;
+    }
+
+    float end = 0.f;
+    for (uint32_t i = 0; i < count; ++i) {
+      vec4_dup(coords[i], sheet->subtexs[anim->frames[i]].coords);
+
+      if (rate <= 0.f) {
+        end += (float)anim->lengths[i];
+        ends[i] = end;
+      }
+    }
+  } else {
+    vec4_dup(coords[0], sheet->subtexs[system->render.subtex].coords);
   }
 
-  particles.time       = 0;
-  particles.spawn_time = 0;
-  particles.alive      = 0;
-  particles.spawn_rate = MS_TO_SEC / emit_rate;
+  r_set_v4x(shader, count, "frame_coords", coords);
+  r_set_fx(shader, count, "frame_ends", ends);
+  r_set_uniformi(shader, "frame_count", (int)count);
+  r_set_uniformf(shader, "frame_rate", rate);
+  r_set_uniformi(shader, "frame_loop", anim ? anim->loop : 0);
+}
 
-  particles.calculate      = calculate;
-  particles.max_emission   = emit_count;
-  particles.emission_count = 0;
+void r_particles_gpu_draw(r_ctx* ctx, r_particles_gpu* particles,
+                          r_shader shader) {
+  r_particles* system = particles->system;
 
-  if (calculate) {
-    particles.mats   = (mat4x4*)malloc(sizeof(mat4x4) * uniform_cap);
-    particles.colors = (vec4*)malloc(sizeof(vec4) * uniform_cap);
-    particles.coords = (vec4*)malloc(sizeof(vec4) * uniform_cap);
+  if (!system || !particles->capacity) {
+    ASTERA_FUNC_DBG("invalid GPU particle system passed.\n");
+    return;
   }
 
-  particles.uniform_cap = uniform_cap;
+  // Every particle has died
+  if (particles->remaining <= 0.f) {
+    return;
+  }
 
-  particles.particle_life = particle_life;
+  r_state_shader(ctx, shader);
+  if ((system->type == PARTICLE_ANIMATED ||
+       system->type == PARTICLE_TEXTURED) &&
+      system->sheet) {
+    r_state_tex(ctx, system->sheet->id);
+    r_set_uniformii(r_get_uniform(shader, R_UNIFORM_USE_TEX), 1);
+    r_particles_gpu_frames(system, shader);
+  } else {
+    r_set_uniformii(r_get_uniform(shader, R_UNIFORM_USE_TEX), 0);
+  }
 
-  particles.type = particle_type;
+  r_set_m4i(r_get_uniform(shader, R_UNIFORM_VIEW), ctx->camera.view);
+  r_set_m4i(r_get_uniform(shader, R_UNIFORM_PROJECTION),
+            ctx->camera.projection);
+  r_set_v4i(r_get_uniform(shader, R_UNIFORM_COLOR), system->color);
 
-  particles.particle_size[0] = 1.f;
-  particles.particle_size[1] = 1.f;
+  r_set_v2(shader, "origin", system->position);
+  r_set_v2(shader, "size", system->particle_size);
+  r_set_uniformf(shader, "depth",
+                 system->particle_layer * ASTERA_RENDER_LAYER_MOD);
+  r_set_uniformf(shader, "life", system->particle_life);
 
-  particles.position[0] = 0.f;
-  particles.position[1] = 0.f;
+  // Dead particles are drawn outside of the view, so every slot is sent
+  r_state_vao(ctx, particles->draw_vaos[particles->current]);
+  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0,
+                          (GLsizei)particles->capacity);
+}
 
-  particles.size[0] = 0.f;
-  particles.size[1] = 0.f;
+void r_particles_gpu_destroy(r_particles_gpu* particles) {
+  if (!particles->capacity) {
+    return;
+  }
 
-  particles.list = (r_particle*)calloc(particle_capacity, sizeof(r_particle));
+  glDeleteVertexArrays(2, particles->vaos);
+  glDeleteVertexArrays(2, particles->draw_vaos);
+  glDeleteBuffers(2, particles->buffers);
 
-  particles.capacity = particle_capacity;
-  particles.count    = 0;
+  *particles = (r_particles_gpu){0};
+  r_state_lost();
+}
 
-  return particles;
+void r_sprite_move(r_sprite* sprite, vec2 dist) {
+  vec2_add(sprite->position, sprite->position, dist);
 }
 
-void r_particles_start(r_particles* particles) {
-  r_particles_reset(particles);
-  particles->alive = 1;
+void r_sprite_draw(r_ctx* ctx, r_sprite* sprite) {
+  if (!sprite->visible) {
+    return;
+  }
+
+  r_state_shader(ctx, sprite->shader);
+
+  r_sheet* sheet = sprite->sheet;
+  r_state_tex(ctx, sheet->id);
+
+  r_shader shader     = sprite->shader;
+  vec2     sheet_size = {(float)sheet->width, (float)sheet->height};
+  r_set_v2i(r_get_uniform(shader, R_UNIFORM_SHEET_SIZE), sheet_size);
+
+  r_set_m4i(r_get_uniform(shader, R_UNIFORM_VIEW), ctx->camera.view);
+  r_set_m4i(r_get_uniform(shader, R_UNIFORM_PROJECTION),
+            ctx->camera.projection);
+
+  r_set_uniformii(r_get_uniform(shader, R_UNIFORM_FLIP_X), sprite->flip_x);
+  r_set_uniformii(r_get_uniform(shader, R_UNIFORM_FLIP_Y), sprite->flip_y);
+
+  r_set_v4i(r_get_uniform(shader, R_UNIFORM_COLOR), sprite->color);
+  r_set_m4i(r_get_uniform(shader, R_UNIFORM_MODEL), sprite->model);
+
+  if (sprite->animated) {
+    r_set_v4i(r_get_uniform(shader, R_UNIFORM_COORDS),
+              sheet
+                  ->subtexs[sprite->render.anim.anim
+                                ->frames[sprite->render.anim.curr]]
+                  .coords);
+  } else {
+    r_set_v4i(r_get_uniform(shader, R_UNIFORM_COORDS),
+              sheet->subtexs[sprite->render.tex].coords);
+  }
+
+  r_state_vao(ctx, ctx->default_quad.vao);
+  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
 }
 
-void r_particles_stop(r_particles* particles) {
-  particles->alive = 0;
+void r_sprite_draw_batch(r_ctx* ctx, r_sprite* sprite) {
+  if (!sprite->visible) {
+    return;
+  }
+
+  if (ctx->culling) {
+    vec4    bounds;
+    float   x, y, half_w, half_h;
+    uint8_t inside;
+
+    r_camera_get_bounds(&ctx->camera, bounds);
+    r_sprite_extents(sprite, &x, &y, &half_w, &half_h);
+
+    if (!r_cull_boxes(bounds, &x, &y, &half_w, &half_h, &inside, 1)) {
+      ++ctx->culled;
+      return;
+    }
+
+    ++ctx->drawn;
+  }
+
+  r_commands_push(ctx, sprite);
 }
 
-void r_particles_resume(r_particles* particles) {
-  particles->alive = 1;
+// The least amount of sprites worth handing to a worker thread
+#define R_JOB_MIN 2048
+// The most jobs a list of sprites is split into
+#define R_JOB_MAX 64
+
+typedef struct {
+  r_sprite* sprites;
+  uint32_t  count;
+  long      delta;
+} r_sprite_update_job;
+
+typedef struct {
+  r_command_buffer* buffer;
+  r_sprite*         sprites;
+  uint32_t          count;
+
+  /* bounds - the camera's bounds to cull against
+   * culling - whether to cull the sprites */
+  vec4    bounds;
+  uint8_t culling;
+
+  /* first - the first slot of the command buffer this job writes to
+   * handled - the sprites gone thru before one without a sheet stopped it
+   * written - the amount of commands written from first on */
+  uint32_t first, handled, written;
+  uint32_t drawn, culled;
+} r_sprite_draw_job;
+
+/* Split a list between the worker threads & the calling thread
+ * count - the amount of items in the list
+ * size - set to the amount of items in each job, the last can have less
+ * returns: the amount of jobs */
+static uint32_t r_jobs_split(r_ctx* ctx, uint32_t count, uint32_t* size) {
+  uint32_t jobs = s_pool_thread_count(ctx->jobs) + 1;
+  uint32_t most = (count + R_JOB_MIN - 1) / R_JOB_MIN;
+
+  if (jobs > most) {
+    jobs = most;
+  }
+
+  if (jobs > R_JOB_MAX) {
+    jobs = R_JOB_MAX;
+  }
+
+  if (jobs < 1) {
+    jobs = 1;
+  }
+
+  // Keep whole cull blocks in each job
+  *size = (count + jobs - 1) / jobs;
+  *size = ((*size + R_CULL_BLOCK - 1) / R_CULL_BLOCK) * R_CULL_BLOCK;
+
+  return (count + *size - 1) / *size;
 }
 
-void r_particles_reset(r_particles* particles) {
-  particles->time           = 0.f;
-  particles->spawn_time     = 0.f;
-  particles->count          = 0;
-  particles->emission_count = 0;
-  particles->uniform_count  = 0;
-  particles->alive          = 0;
-  memset(particles->mats, 0, sizeof(mat4x4) * particles->uniform_cap);
-  memset(particles->colors, 0, sizeof(vec4) * particles->uniform_cap);
-  memset(particles->coords, 0, sizeof(vec4) * particles->uniform_cap);
+// Run jobs on the worker threads, the first on the calling thread
+static void r_jobs_run(r_ctx* ctx, s_job_func func, void* jobs, size_t stride,
+                       uint32_t count) {
+  for (uint32_t i = 1; i < count; ++i) {
+    void* job = (char*)jobs + (stride * i);
+
+    if (!ctx->jobs || !s_pool_push(ctx->jobs, func, job, 0)) {
+      func(job);
+    }
+  }
+
+  func(jobs);
+  s_pool_wait(ctx->jobs);
 }
 
-uint8_t r_particles_finished(r_particles* particles) {
-  return !particles->alive;
+static void r_sprite_update_job_run(void* data) {
+  r_sprite_update_job* job = (r_sprite_update_job*)data;
+
+  for (uint32_t i = 0; i < job->count; ++i) {
+    r_sprite_update(&job->sprites[i], job->delta);
+  }
 }
 
-uint32_t r_particles_frame_at(r_particles* system, time_s time) {
-  if (system->type == PARTICLE_ANIMATED) {
-    return r_anim_frame_at(system->render.anim.anim, time);
-  } else {
-    return system->render.subtex;
+// Cull & write a run of sprites into the job's slots of the command buffer
+static void r_sprite_draw_job_run(void* data) {
+  r_sprite_draw_job* job = (r_sprite_draw_job*)data;
+
+  float   x[R_CULL_BLOCK], y[R_CULL_BLOCK];
+  float   half_w[R_CULL_BLOCK], half_h[R_CULL_BLOCK];
+  uint8_t inside[R_CULL_BLOCK];
+
+  job->handled = job->count;
+
+  for (uint32_t start = 0; start < job->count; start += R_CULL_BLOCK) {
+    r_sprite* block = &job->sprites[start];
+    uint32_t  count = job->count - start;
+    if (count > R_CULL_BLOCK) {
+      count = R_CULL_BLOCK;
+    }
+
+    if (job->culling) {
+      for (uint32_t i = 0; i < count; ++i) {
+        r_sprite_extents(&block[i], &x[i], &y[i], &half_w[i], &half_h[i]);
+      }
+
+      uint32_t drawn =
+          r_cull_boxes(job->bounds, x, y, half_w, half_h, inside, count);
+      job->drawn += drawn;
+      job->culled += count - drawn;
+    } else {
+      memset(inside, 1, count);
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+      r_sprite* sprite = &block[i];
+
+      if (!inside[i] || !sprite->visible) {
+        continue;
+      }
+
+      if (!sprite->sheet) {
+        ASTERA_FUNC_DBG("sprite has no sheet.\n");
+        job->handled = start + i;
+        return;
+      }
+
+      r_commands_write(job->buffer, job->first + job->written, sprite);
+      ++job->written;
+    }
   }
 }
 
-void r_particles_set_system(r_particles* system, float lifetime,
-                            float prespawn) {
-  system->system_life = lifetime;
+void r_sprites_update(r_ctx* ctx, r_sprite* sprites, uint32_t sprite_count,
+                      long delta) {
+  if (!ctx || !sprites || !sprite_count) {
+    ASTERA_FUNC_DBG("no sprites passed.\n");
+    return;
+  }
 
-  float change = prespawn;
-  if (system->prespawn != 0.f) {
-    change -= system->prespawn;
+  r_sprite_update_job jobs[R_JOB_MAX];
+  uint32_t            size  = 0;
+  uint32_t            count = r_jobs_split(ctx, sprite_count, &size);
+
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t start = i * size;
+    uint32_t left  = sprite_count - start;
+
+    jobs[i] = (r_sprite_update_job){.sprites = &sprites[start],
+                                    .count   = (left < size) ? left : size,
+                                    .delta   = delta};
+  }
+
+  r_jobs_run(ctx, r_sprite_update_job_run, jobs, sizeof(r_sprite_update_job),
+             count);
+}
+
+uint32_t r_sprites_draw(r_ctx* ctx, r_sprite* sprites, uint32_t sprite_count) {
+  if (!sprites || !sprite_count || !ctx) {
+    ASTERA_FUNC_DBG("no sprites passed.\n");
+    return 0;
+  }
+
+  r_command_buffer* buffer = &ctx->commands;
+  uint32_t          base   = buffer->count;
+
+  // Every job gets room for all of its sprites, so none of them grow it
+  if (!r_commands_fit(buffer, base + sprite_count)) {
+    return 0;
+  }
+
+  vec4 bounds;
+  r_camera_get_bounds(&ctx->camera, bounds);
+
+  r_sprite_draw_job jobs[R_JOB_MAX];
+  uint32_t          size  = 0;
+  uint32_t          count = r_jobs_split(ctx, sprite_count, &size);
+
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t start = i * size;
+    uint32_t left  = sprite_count - start;
+
+    jobs[i] = (r_sprite_draw_job){.buffer  = buffer,
+                                  .sprites = &sprites[start],
+                                  .count   = (left < size) ? left : size,
+                                  .culling = ctx->culling,
+                                  .first   = base + start};
+
+    vec4_dup(jobs[i].bounds, bounds);
   }
 
-  system->prespawn = prespawn;
+  r_jobs_run(ctx, r_sprite_draw_job_run, jobs, sizeof(r_sprite_draw_job),
+             count);
+
+  // Close the gaps culled sprites left between the jobs' slots
+  for (uint32_t i = 0; i < count; ++i) {
+    r_sprite_draw_job* job = &jobs[i];
+
+    r_commands_move(buffer, buffer->count, job->first, job->written);
+    buffer->count += job->written;
 
-  if (change > 0.f) {
-    uint32_t rounds = (uint32_t)(change / 100.f);
-    for (uint32_t i = 0; i < rounds; ++i) {
-      r_particles_update(system, (change > 100.f) ? 100.f : change);
-      change -= 100.f;
+    ctx->drawn += job->drawn;
+    ctx->culled += job->culled;
+
+    if (job->handled < job->count) {
+      return (job->first - base) + job->handled;
     }
   }
-}
-
-void r_particles_set_position(r_particles* system, vec2 position) {
-  vec2_dup(system->position, position);
-}
 
-void r_particles_set_size(r_particles* system, vec2 size) {
-  vec2_dup(system->size, size);
-}
+  return sprite_count;
+}
+
+typedef struct {
+  r_particles* systems;
+  uint32_t     count;
+  time_s       delta;
+
+  /* bounds - the camera's bounds to cull against
+   * culling - whether to cull the particles
+   * whole - the most particles a system can have to be finished in this
+   *         job, larger ones are split with r_particles_chunk_job */
+  vec4     bounds;
+  uint8_t  culling;
+  uint32_t whole;
+  uint32_t drawn, culled;
+} r_particles_update_job;
+
+typedef struct {
+  r_particles* system;
+  uint32_t     start, count;
+
+  /* bounds - the camera's bounds to cull against
+   * culling - whether to cull the particles
+   * prepare - whether to write the draw data of the particles
+   * written - the amount of particles written from start on */
+  vec4     bounds;
+  uint8_t  culling, prepare;
+  uint32_t written;
+} r_particles_chunk_job;
+
+/* Grow a system's uniform arrays to hold every particle it can have
+ * returns: success = 1, fail = 0 */
+static uint8_t r_particles_fit(r_particles* system) {
+  if (!system->calculate || !system->uniform_cap) {
+    return 0;
+  }
 
-void r_particles_set_particle(r_particles* system, vec4 color,
-                              float particle_life, vec2 particle_size,
-                              vec2 particle_velocity) {
-  if (!system)
-    return;
+  if (system->uniform_size >= system->capacity) {
+    return 1;
+  }
 
-  if (color) {
-    vec4_dup(system->color, color);
+  mat4x4* mats =
+      (mat4x4*)realloc(system->mats, sizeof(mat4x4) * system->capacity);
+  if (mats) {
+    system->mats = mats;
   }
 
-  if (particle_life != 0.f) {
-    system->particle_life = particle_life;
+  vec4* colors =
+      (vec4*)realloc(system->colors, sizeof(vec4) * system->capacity);
+  if (colors) {
+    system->colors = colors;
   }
 
-  if (particle_size) {
-    vec2_dup(system->particle_size, particle_size);
+  vec4* coords =
+      (vec4*)realloc(system->coords, sizeof(vec4) * system->capacity);
+  if (coords) {
+    system->coords = coords;
   }
 
-  if (particle_velocity) {
-    vec2_dup(system->particle_velocity, particle_velocity);
+  if (!mats || !colors || !coords) {
+    ASTERA_FUNC_DBG("unable to grow uniforms to %i.\n", system->capacity);
+    return 0;
   }
+
+  system->uniform_size = system->capacity;
+  return 1;
 }
 
-void r_particles_update(r_particles* system, time_s delta) {
-  if (system->alive) {
-    system->time += (float)delta;
-    system->spawn_time += (float)delta;
-    int32_t to_spawn = (int32_t)system->spawn_time / system->spawn_rate;
+static void r_particles_update_job_run(void* data) {
+  r_particles_update_job* job = (r_particles_update_job*)data;
 
-    // cap to capacity of the particle system's bufferse
-    if (system->count + to_spawn >= system->capacity) {
-      to_spawn = system->capacity - system->count;
-    }
+  for (uint32_t i = 0; i < job->count; ++i) {
+    r_particles* system = &job->systems[i];
+    system->prepared    = 0;
 
-    // cap to max emission
-    /*if (system->max_emission) {
-      if (to_spawn + system->emission_count > system->max_emission) {
-        to_spawn = system->max_emission - system->emission_count;
-      }
-    }*/
-
-    system->spawn_time -= system->spawn_rate * to_spawn;
-    if (((system->time > system->system_life && system->system_life > 0.f) ||
-         (system->emission_count > system->max_emission &&
-          system->max_emission > 0))) {
-      if (system->count == 0) {
-        system->alive = 0;
-        return;
-      } else {
-        to_spawn = 0;
-      }
+    // Finished (or never started) systems have nothing left to update
+    if (!system->alive && !system->count) {
+      continue;
     }
 
-    for (int i = 0; i < to_spawn; ++i) {
-      r_particle* open = 0;
-
-      for (uint32_t j = 0; j < system->capacity; ++j) {
-        if (system->list[j].life <= 0.f) {
-          open = &system->list[j];
-          break;
-        }
-      }
+    r_particles_spawn(system, job->delta);
+    r_particles_step(system, job->delta);
 
-      if (!open) {
-        break;
-      }
+    uint8_t prepare = r_particles_fit(system);
 
-      open->life = system->particle_life;
-      vec2_dup(open->size, system->particle_size);
-      vec2_dup(open->velocity, system->particle_velocity);
-      vec4_dup(open->color, system->color);
+    if (system->count > job->whole) {
+      continue;
+    }
 
-      if (system->use_spawner) {
-        system->spawner_func(system, open);
-      } else {
-        open->position[0] = fmodf((float)rand(), system->size[0]);
-        open->position[1] = fmodf((float)rand(), system->size[1]);
+    r_particles_animate(system, 0, system->count);
 
-        open->layer = system->particle_layer;
+    if (prepare) {
+      uint32_t written = r_particles_prepare(system, job->bounds, job->culling,
+                                             0, system->count, 0);
 
-        if (system->type == PARTICLE_ANIMATED) {
-          open->frame = 0;
-        } else if (system->type == PARTICLE_TEXTURED) {
-          open->frame = system->render.subtex;
-        }
+      if (job->culling) {
+        job->drawn += written;
+        job->culled += system->count - written;
       }
 
-      ++system->emission_count;
-      ++system->count;
+      system->uniform_count = written;
+      system->prepared      = 1;
     }
   }
+}
 
-  if (system->count > 0) {
-    // Update particles
-    for (uint32_t i = 0; i < system->capacity; ++i) {
-      r_particle* particle = &system->list[i];
-      if (particle->life > 0.f) {
-        particle->life -= (float)delta;
-      } else {
-        continue;
-      }
+// Animate & write a run of a system's particles into the same slots
+static void r_particles_chunk_job_run(void* data) {
+  r_particles_chunk_job* job = (r_particles_chunk_job*)data;
 
-      if (particle->life <= 0.f) {
-        particle->life = 0.f;
-        --system->count;
-        continue;
-      }
+  r_particles_animate(job->system, job->start, job->count);
 
-      vec2 movement = {0.f, 0.f};
-      vec2_scale(movement, particle->velocity, (const float)delta);
-      vec2_add(particle->position, particle->position, movement);
-
-      if (system->use_animator) {
-        (*system->animator_func)(system, &system->list[i]);
-      } else if (system->type == PARTICLE_ANIMATED) {
-        float lifespan  = system->particle_life - particle->life;
-        particle->frame = r_anim_frame_at(system->render.anim.anim, lifespan);
-        if (particle->frame > system->render.anim.count) {
-          particle->frame = system->render.anim.count;
-        }
-      }
-    }
+  if (job->prepare) {
+    job->written =
+        r_particles_prepare(job->system, job->bounds, job->culling,
+                            job->start, job->count, job->start);
   }
 }
 
-void r_particles_set_anim(r_particles* particles, r_anim* anim) {
-  if (!particles)
-    return;
+// Finish a system too large for one job, split between the threads
+static void r_particles_update_split(r_ctx* ctx, r_particles* system,
+                                     vec4 bounds) {
+  r_particles_chunk_job jobs[R_JOB_MAX];
+  uint32_t              size  = 0;
+  uint32_t              count = r_jobs_split(ctx, system->count, &size);
+  uint8_t               prepare =
+      system->calculate && system->uniform_size >= system->capacity;
 
-  particles->sheet       = anim->sheet;
-  particles->render.anim = r_anim_create_viewer(anim);
-}
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t start = i * size;
+    uint32_t left  = system->count - start;
 
-void r_particles_set_subtex(r_particles* particles, r_sheet* sheet,
-                            uint32_t subtex) {
-  if (!particles)
-    return;
+    jobs[i] = (r_particles_chunk_job){
+        .system  = system,
+        .start   = start,
+        .count   = left < size ? left : size,
+        .culling = ctx->culling,
+        .prepare = prepare,
+    };
+    vec4_dup(jobs[i].bounds, bounds);
+  }
 
-  particles->sheet         = sheet;
-  particles->render.subtex = subtex;
-}
+  r_jobs_run(ctx, r_particles_chunk_job_run, jobs,
+             sizeof(r_particles_chunk_job), count);
 
-void r_particles_set_color(r_particles* particles, vec4 color,
-                           uint8_t color_only) {
-  if (!particles || !color)
+  if (!prepare) {
     return;
+  }
 
-  vec4_dup(particles->color, color);
+  // Pack each job's particles after the last
+  uint32_t written = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    r_particles_chunk_job* job = &jobs[i];
+
+    if (written != job->start) {
+      memmove(&system->mats[written], &system->mats[job->start],
+              sizeof(mat4x4) * job->written);
+      memmove(&system->colors[written], &system->colors[job->start],
+              sizeof(vec4) * job->written);
+      memmove(&system->coords[written], &system->coords[job->start],
+              sizeof(vec4) * job->written);
+    }
 
-  if (color_only) {
-    particles->type = PARTICLE_COLORED;
+    written += job->written;
   }
-}
 
-void r_particles_destroy(r_particles* particles) {
-  free(particles->list);
-
-  if (particles->calculate) {
-    free(particles->colors);
-    free(particles->coords);
-    free(particles->mats);
+  if (ctx->culling) {
+    ctx->drawn += written;
+    ctx->culled += system->count - written;
   }
 
-  particles->capacity = 0;
-  particles->count    = 0;
+  system->uniform_count = written;
+  system->prepared      = 1;
 }
 
-static void r_particles_render(r_ctx* ctx, r_particles* particles,
-                               r_shader shader) {
-  r_shader_bind(shader);
-  if ((particles->type == PARTICLE_ANIMATED ||
-       particles->type == PARTICLE_TEXTURED) &&
-      particles->sheet) {
-    r_tex_bind(particles->sheet->id);
-    r_set_uniformi(shader, "use_tex", 1);
-  } else {
-    r_set_uniformi(shader, "use_tex", 0);
+void r_particles_update_many(r_ctx* ctx, r_particles* systems, uint32_t count,
+                             time_s delta) {
+  if (!ctx || !systems || !count) {
+    ASTERA_FUNC_DBG("no particle systems passed.\n");
+    return;
   }
 
-  r_set_m4(shader, "view", ctx->camera.view);
-  r_set_m4(shader, "projection", ctx->camera.projection);
-  // r_set_m4(shader, "model", system->model);
-
-  r_set_v4x(shader, particles->uniform_count, "coords", particles->coords);
-  r_set_v4x(shader, particles->uniform_count, "colors", particles->colors);
-  r_set_m4x(shader, particles->uniform_count, "mats", particles->mats);
+  vec4 bounds;
+  r_camera_get_bounds(&ctx->camera, bounds);
 
-  glBindVertexArray(ctx->default_quad.vao);
-  glBindBuffer(GL_ARRAY_BUFFER, ctx->default_quad.vbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->default_quad.vboi);
+  // Only split systems up when there's another thread to take a part
+  uint32_t threads = s_pool_thread_count(ctx->jobs);
+  uint32_t whole   = threads ? R_JOB_MIN : UINT32_MAX;
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, (const void*)0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, (const void*)12);
+  uint32_t jobs = threads + 1;
+  if (jobs > count) {
+    jobs = count;
+  }
 
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
+  if (jobs > R_JOB_MAX) {
+    jobs = R_JOB_MAX;
+  }
 
-  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0,
-                          particles->uniform_count);
+  r_particles_update_job update[R_JOB_MAX];
+  uint32_t               size = (count + jobs - 1) / jobs;
+  jobs                        = (count + size - 1) / size;
 
-  glDisableVertexAttribArray(0);
-  glDisableVertexAttribArray(1);
+  for (uint32_t i = 0; i < jobs; ++i) {
+    uint32_t start = i * size;
+    uint32_t left  = count - start;
 
-  glBindVertexArray(0);
-  r_tex_bind(0);
-  r_shader_bind(0);
+    update[i] = (r_particles_update_job){
+        .systems = &systems[start],
+        .count   = left < size ? left : size,
+        .delta   = delta,
+        .culling = ctx->culling,
+        .whole   = whole,
+    };
+    vec4_dup(update[i].bounds, bounds);
+  }
 
-  // Clear out the uniforms for the next draw call
-  memset(particles->mats, 0, sizeof(mat4x4) * particles->uniform_count);
-  memset(particles->colors, 0, sizeof(vec4) * particles->uniform_count);
-  memset(particles->coords, 0, sizeof(vec4) * particles->uniform_count);
-  particles->uniform_count = 0;
-}
+  r_jobs_run(ctx, r_particles_update_job_run, update,
+             sizeof(r_particles_update_job), jobs);
 
-void r_particles_draw(r_ctx* ctx, r_particles* particles, r_shader shader) {
-  if (particles->calculate) {
-    r_sheet* sheet = particles->sheet;
+  for (uint32_t i = 0; i < jobs; ++i) {
+    ctx->drawn += update[i].drawn;
+    ctx->culled += update[i].culled;
+  }
 
-    mat4x4_translate(particles->model, particles->position[0],
-                     particles->position[1], 0);
+  for (uint32_t i = 0; i < count; ++i) {
+    if (systems[i].count > whole) {
+      r_particles_update_split(ctx, &systems[i], bounds);
+    }
+  }
+}
 
-    for (uint32_t i = 0; i < particles->capacity; ++i) {
-      r_particle* particle = &particles->list[i];
+/* Advance 4 frame timers by delta, leaving ones that aren't animating alone
+ * returns: a bit for each timer that reached the end of its frame */
+static inline uint32_t r_timers_advance4(float* times, const float* rates,
+                                         float delta) {
+#if defined(R_SIMD_SSE)
+  __m128 rate   = _mm_loadu_ps(rates);
+  __m128 active = _mm_cmpgt_ps(rate, _mm_setzero_ps());
+  __m128 time   = _mm_add_ps(_mm_loadu_ps(times),
+                           _mm_and_ps(_mm_set1_ps(delta), active));
+  _mm_storeu_ps(times, time);
+
+  __m128 due = _mm_and_ps(active, _mm_cmpge_ps(time, rate));
+  return (uint32_t)_mm_movemask_ps(due);
+#elif defined(R_SIMD_NEON)
+  static const uint32_t bits[4] = {1, 2, 4, 8};
+
+  float32x4_t rate   = vld1q_f32(rates);
+  uint32x4_t  active = vcgtq_f32(rate, vdupq_n_f32(0.f));
+  float32x4_t step   = vreinterpretq_f32_u32(
+      vandq_u32(active, vreinterpretq_u32_f32(vdupq_n_f32(delta))));
+  float32x4_t time = vaddq_f32(vld1q_f32(times), step);
+  vst1q_f32(times, time);
+
+  uint32x4_t due = vandq_u32(vandq_u32(active, vcgeq_f32(time, rate)),
+                             vld1q_u32(bits));
+  uint32x2_t sum = vadd_u32(vget_low_u32(due), vget_high_u32(due));
+  return vget_lane_u32(vpadd_u32(sum, sum), 0);
+#else
+  uint32_t due = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    if (rates[i] > 0.f) {
+      times[i] += delta;
+      due |= (uint32_t)(times[i] >= rates[i]) << i;
+    }
+  }
+  return due;
+#endif
+}
 
-      if (particle->life > 0.f) {
-        mat4x4* mat = &particles->mats[particles->uniform_count];
+// returns: the length of a frame in an animation
+static float r_anim_frame_length(r_anim* anim, uint32_t frame) {
+  if (anim->rate > 0.f || !anim->lengths) {
+    return (float)anim->rate;
+  }
 
-        mat4x4_identity(*mat);
-        mat4x4_translate(*mat, particles->position[0] + particle->position[0],
-                         particles->position[1] + particle->position[1],
-                         particle->layer * ASTERA_RENDER_LAYER_MOD);
-        mat4x4_scale_aniso(*mat, *mat, particle->size[0], particle->size[1],
-                           1.f);
-        mat4x4_rotate_z(*mat, *mat, particle->rotation);
+  return (float)anim->lengths[frame];
+}
 
-        vec4_dup(particles->colors[particles->uniform_count], particle->color);
+// Step a pool's sprite through the frames its timer has passed
+static void r_sprite_pool_step(r_sprite_pool* pool, uint32_t index) {
+  r_anim* anim = pool->anims[index];
 
-        if (sheet) {
-          if (particles->type == PARTICLE_TEXTURED ||
-              particles->type == PARTICLE_ANIMATED) {
-            vec4_dup(particles->coords[particles->uniform_count],
-                     sheet->subtexs[particle->frame].coords);
-          }
-        }
+  while (pool->rates[index] > 0.f && pool->times[index] >= pool->rates[index]) {
+    pool->times[index] -= pool->rates[index];
 
-        ++particles->uniform_count;
+    if (pool->frames[index] + 1 >= anim->count) {
+      if (!anim->loop) {
+        pool->rates[index] = 0.f;
+        return;
       }
 
-      if (particles->uniform_count == particles->uniform_cap) {
-        r_particles_render(ctx, particles, shader);
-      }
+      pool->frames[index] = 0;
+    } else {
+      ++pool->frames[index];
     }
 
-    if (particles->uniform_count != 0) {
-      r_particles_render(ctx, particles, shader);
-    }
-  } else {
-    r_particles_render(ctx, particles, shader);
+    pool->rates[index] = r_anim_frame_length(anim, pool->frames[index]);
   }
 }
 
-void r_particles_set_spawner(r_particles* system, r_particle_spawner spawner) {
-  system->use_spawner  = 1;
-  system->spawner_func = spawner;
-}
+r_sprite_pool r_sprite_pool_create(r_sheet* sheet, r_shader shader,
+                                   uint32_t capacity) {
+  r_sprite_pool pool = (r_sprite_pool){0};
 
-void r_particles_set_animator(r_particles*        system,
-                              r_particle_animator animator) {
-  system->use_animator  = 1;
-  system->animator_func = animator;
-}
+  if (!sheet || !capacity) {
+    ASTERA_FUNC_DBG("invalid pool parameters.\n");
+    return pool;
+  }
 
-void r_particles_remove_spawner(r_particles* system) {
-  system->use_spawner  = 0;
-  system->spawner_func = 0;
-}
+  uint32_t padded = r_padded4(capacity);
 
-void r_particles_remove_animator(r_particles* system) {
-  system->use_animator  = 0;
-  system->animator_func = 0;
+  pool.x      = (float*)calloc(padded, sizeof(float));
+  pool.y      = (float*)calloc(padded, sizeof(float));
+  pool.half_w = (float*)calloc(padded, sizeof(float));
+  pool.half_h = (float*)calloc(padded, sizeof(float));
+  pool.times  = (float*)calloc(padded, sizeof(float));
+  pool.rates  = (float*)calloc(padded, sizeof(float));
+  pool.anims  = (r_anim**)calloc(padded, sizeof(r_anim*));
+  pool.frames = (uint32_t*)calloc(padded, sizeof(uint32_t));
+  pool.colors = (vec4*)calloc(padded, sizeof(vec4));
+  pool.layers = (uint8_t*)calloc(padded, sizeof(uint8_t));
+  pool.flags  = (uint8_t*)calloc(padded, sizeof(uint8_t));
+
+  if (!pool.x || !pool.y || !pool.half_w || !pool.half_h || !pool.times ||
+      !pool.rates || !pool.anims || !pool.frames || !pool.colors ||
+      !pool.layers || !pool.flags) {
+    ASTERA_FUNC_DBG("unable to allocate pool of %i sprites.\n", capacity);
+    r_sprite_pool_destroy(&pool);
+    return (r_sprite_pool){0};
+  }
+
+  pool.sheet    = sheet;
+  pool.shader   = shader;
+  pool.capacity = capacity;
+
+  return pool;
 }
 
-void r_sprite_move(r_sprite* sprite, vec2 dist) {
-  vec2_add(sprite->position, sprite->position, dist);
+void r_sprite_pool_destroy(r_sprite_pool* pool) {
+  free(pool->x);
+  free(pool->y);
+  free(pool->half_w);
+  free(pool->half_h);
+  free(pool->times);
+  free(pool->rates);
+  free(pool->anims);
+  free(pool->frames);
+  free(pool->colors);
+  free(pool->layers);
+  free(pool->flags);
+  *pool = (r_sprite_pool){0};
 }
 
-void r_sprite_draw(r_ctx* ctx, r_sprite* sprite) {
-  if (!sprite->visible) {
-    return;
+int32_t r_sprite_pool_add(r_sprite_pool* pool, vec2 position, vec2 size,
+                          uint8_t layer, uint32_t tex) {
+  if (pool->count == pool->capacity) {
+    ASTERA_FUNC_DBG("pool is full.\n");
+    return -1;
   }
 
-  r_shader_bind(sprite->shader);
+  uint32_t index = pool->count;
 
-  r_sheet* sheet = sprite->sheet;
-  r_tex_bind(sheet->id);
+  pool->x[index]      = position[0];
+  pool->y[index]      = position[1];
+  pool->half_w[index] = size[0] * 0.5f;
+  pool->half_h[index] = size[1] * 0.5f;
+  pool->times[index]  = 0.f;
+  pool->rates[index]  = 0.f;
+  pool->anims[index]  = 0;
+  pool->frames[index] = tex;
+  pool->layers[index] = layer;
+  pool->flags[index]  = R_SPRITE_POOL_VISIBLE;
 
-  vec2 sheet_size = {(float)sheet->width, (float)sheet->height};
-  r_set_v2(sprite->shader, "sheet_size", sheet_size);
+  vec4 white = {1.f, 1.f, 1.f, 1.f};
+  vec4_dup(pool->colors[index], white);
 
-  r_set_m4(sprite->shader, "view", ctx->camera.view);
-  r_set_m4(sprite->shader, "projection", ctx->camera.projection);
+  ++pool->count;
+  return (int32_t)index;
+}
 
-  r_set_uniformi(sprite->shader, "flip_x", sprite->flip_x);
-  r_set_uniformi(sprite->shader, "flip_y", sprite->flip_y);
+void r_sprite_pool_remove(r_sprite_pool* pool, uint32_t index) {
+  if (index >= pool->count) {
+    return;
+  }
 
-  r_set_v4(sprite->shader, "color", sprite->color);
-  r_set_m4(sprite->shader, "model", sprite->model);
+  uint32_t last = --pool->count;
 
-  if (sprite->animated) {
-    r_set_v4(sprite->shader, "coords",
-             sheet
-                 ->subtexs[sprite->render.anim.anim
-                               ->frames[sprite->render.anim.curr]]
-                 .coords);
-  } else {
-    r_set_v4(sprite->shader, "coords",
-             sheet->subtexs[sprite->render.tex].coords);
+  if (index != last) {
+    pool->x[index]      = pool->x[last];
+    pool->y[index]      = pool->y[last];
+    pool->half_w[index] = pool->half_w[last];
+    pool->half_h[index] = pool->half_h[last];
+    pool->times[index]  = pool->times[last];
+    pool->rates[index]  = pool->rates[last];
+    pool->anims[index]  = pool->anims[last];
+    pool->frames[index] = pool->frames[last];
+    pool->layers[index] = pool->layers[last];
+    pool->flags[index]  = pool->flags[last];
+    vec4_dup(pool->colors[index], pool->colors[last]);
   }
 
-  glBindVertexArray(ctx->default_quad.vao);
-  glBindBuffer(GL_ARRAY_BUFFER, ctx->default_quad.vbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->default_quad.vboi);
+  // Keep the padding past count from animating
+  pool->rates[last] = 0.f;
+}
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, (const void*)0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, (const void*)12);
+void r_sprite_pool_set_pos(r_sprite_pool* pool, uint32_t index,
+                           vec2 position) {
+  pool->x[index] = position[0];
+  pool->y[index] = position[1];
+}
 
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
+void r_sprite_pool_set_size(r_sprite_pool* pool, uint32_t index, vec2 size) {
+  pool->half_w[index] = size[0] * 0.5f;
+  pool->half_h[index] = size[1] * 0.5f;
+}
 
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+void r_sprite_pool_set_color(r_sprite_pool* pool, uint32_t index,
+                             vec4 color) {
+  vec4_dup(pool->colors[index], color);
+}
 
-  glDisableVertexAttribArray(0);
-  glDisableVertexAttribArray(1);
-  glBindVertexArray(0);
-  r_tex_bind(0);
-  r_shader_bind(0);
+void r_sprite_pool_set_flags(r_sprite_pool* pool, uint32_t index,
+                             uint8_t flags) {
+  pool->flags[index] = flags;
 }
 
-void r_sprite_draw_batch(r_ctx* ctx, r_sprite* sprite) {
-  if (!sprite->visible) {
+void r_sprite_pool_set_tex(r_sprite_pool* pool, uint32_t index,
+                           uint32_t tex) {
+  pool->anims[index]  = 0;
+  pool->frames[index] = tex;
+  pool->times[index]  = 0.f;
+  pool->rates[index]  = 0.f;
+}
+
+void r_sprite_pool_set_anim(r_sprite_pool* pool, uint32_t index,
+                            r_anim* anim) {
+  if (!anim || !anim->count) {
+    ASTERA_FUNC_DBG("invalid animation.\n");
     return;
   }
 
-  r_batch* batch = r_batch_get(ctx, sprite->sheet, sprite->shader);
+  pool->anims[index]  = anim;
+  pool->frames[index] = 0;
+  pool->times[index]  = 0.f;
+  pool->rates[index]  = r_anim_frame_length(anim, 0);
+}
+
+void r_sprite_pool_update(r_sprite_pool* pool, time_s delta) {
+  uint32_t padded = r_padded4(pool->count);
+  float    step   = (float)delta;
 
-  if (batch) {
-    if (batch->count == batch->capacity) {
-      r_batch_draw(ctx, batch);
-    }
+  for (uint32_t i = 0; i < padded; i += 4) {
+    uint32_t due = r_timers_advance4(&pool->times[i], &pool->rates[i], step);
+
+    // Only the sprites changing frame leave the kernel
+    while (due) {
+      uint32_t lane = 0;
+      while (!(due & (1u << lane))) {
+        ++lane;
+      }
 
-    r_batch_add(batch, sprite);
+      r_sprite_pool_step(pool, i + lane);
+      due &= ~(1u << lane);
+    }
   }
 }
 
-uint32_t r_sprites_draw(r_ctx* ctx, r_sprite* sprites, uint32_t sprite_count) {
-  if (!sprites || !sprite_count || !ctx) {
-    ASTERA_FUNC_DBG("no sprites passed.\n");
+uint32_t r_sprite_pool_draw(r_ctx* ctx, r_sprite_pool* pool) {
+  if (!ctx || !pool || !pool->count) {
     return 0;
   }
 
-  r_batch* batch = r_batch_get(ctx, sprites[0].sheet, sprites[0].shader);
-
-  if (batch) {
-    uint32_t remaining = sprite_count, used = 0;
-    uint32_t index = 0;
-    while (1) {
-      uint32_t open = batch->capacity - batch->count;
-      used          = (open < remaining) ? open : remaining;
+  vec4 bounds;
+  r_camera_get_bounds(&ctx->camera, bounds);
 
-      uint32_t used_count = r_batch_add_multi(batch, &sprites[index], used);
+  uint8_t  inside[R_CULL_BLOCK];
+  uint32_t queued = 0;
 
-      index += used_count;
-      remaining -= used_count;
+  for (uint32_t start = 0; start < pool->count; start += R_CULL_BLOCK) {
+    uint32_t count = pool->count - start;
+    if (count > R_CULL_BLOCK) {
+      count = R_CULL_BLOCK;
+    }
 
-      if (remaining && used)
-        r_batch_draw(ctx, batch);
-      else
-        break;
+    if (ctx->culling) {
+      uint32_t drawn =
+          r_cull_boxes(bounds, &pool->x[start], &pool->y[start],
+                       &pool->half_w[start], &pool->half_h[start], inside,
+                       count);
+      ctx->drawn += drawn;
+      ctx->culled += count - drawn;
+    } else {
+      memset(inside, 1, count);
     }
 
-    return index;
+    for (uint32_t j = 0; j < count; ++j) {
+      uint32_t i     = start + j;
+      uint8_t  flags = pool->flags[i];
+
+      if (!inside[j] || !(flags & R_SPRITE_POOL_VISIBLE)) {
+        continue;
+      }
+
+      r_instance_packed* instance =
+          r_commands_reserve(ctx, pool->layers[i], pool->shader, pool->sheet);
+
+      if (!instance) {
+        return queued;
+      }
+
+      uint32_t subtex =
+          pool->anims[i] ? pool->anims[i]->frames[pool->frames[i]]
+                         : pool->frames[i];
+      float* coords = pool->sheet->subtexs[subtex].coords;
+      float* color  = pool->colors[i];
+
+      // Sprites only translate & scale, so the instance is written directly
+      instance->x        = pool->x[i];
+      instance->y        = pool->y[i];
+      instance->w        = pool->half_w[i] * 2.f;
+      instance->h        = pool->half_h[i] * 2.f;
+      instance->rotation = 0;
+      instance->layer    = pool->layers[i];
+      instance->flags    = 0;
+
+      if (flags & R_SPRITE_POOL_FLIP_X) {
+        instance->flags |= R_INSTANCE_PACKED_FLIP_X;
+      }
+
+      if (flags & R_SPRITE_POOL_FLIP_Y) {
+        instance->flags |= R_INSTANCE_PACKED_FLIP_Y;
+      }
+
+      for (uint8_t c = 0; c < 4; ++c) {
+        instance->coords[c] = r_pack_unorm16(coords[c]);
+        instance->color[c]  = r_pack_unorm8(color[c]);
+      }
+
+      ++queued;
+    }
   }
 
-  ASTERA_FUNC_DBG("No batch found\n");
-  return 0;
+  return queued;
 }
 
 uint8_t r_sprite_get_anim_state(r_sprite* sprite) {
@@ -1592,15 +4555,8 @@ r_shader r_shader_get(r_ctx* ctx, const char* name) {
   return 0;
 }
 
-r_shader r_shader_create(unsigned char* vert_data, unsigned char* frag_data) {
-  GLuint v = r_shader_create_sub(vert_data, GL_VERTEX_SHADER);
-  GLuint f = r_shader_create_sub(frag_data, GL_FRAGMENT_SHADER);
-
-  GLuint id = glCreateProgram();
-
-  glAttachShader(id, v);
-  glAttachShader(id, f);
-
+// Link a program & cache the locations of its uniforms
+static void r_shader_link(GLuint id) {
   glLinkProgram(id);
 
   GLint success;
@@ -1616,6 +4572,43 @@ r_shader r_shader_create(unsigned char* vert_data, unsigned char* frag_data) {
     free(log);
   }
 
+  // The ID may have belonged to a program deleted outside of astera
+  r_uniform_forget(id);
+  r_uniform_load(id);
+}
+
+r_shader r_shader_create(unsigned char* vert_data, unsigned char* frag_data) {
+  GLuint v = r_shader_create_sub(vert_data, GL_VERTEX_SHADER);
+  GLuint f = r_shader_create_sub(frag_data, GL_FRAGMENT_SHADER);
+
+  GLuint id = glCreateProgram();
+
+  glAttachShader(id, v);
+  glAttachShader(id, f);
+
+  r_shader_link(id);
+
+  return (r_shader)id;
+}
+
+r_shader r_shader_create_feedback(unsigned char* vert_data,
+                                  const char** varyings, uint32_t count) {
+  if (!vert_data || !varyings || !count) {
+    ASTERA_FUNC_DBG("no shader or varyings passed.\n");
+    return 0;
+  }
+
+  GLuint v  = r_shader_create_sub(vert_data, GL_VERTEX_SHADER);
+  GLuint id = glCreateProgram();
+
+  glAttachShader(id, v);
+
+  // The outputs have to be named before the program is linked
+  glTransformFeedbackVaryings(id, (GLsizei)count, varyings,
+                              GL_INTERLEAVED_ATTRIBS);
+
+  r_shader_link(id);
+
   return (r_shader)id;
 }
 
@@ -1652,11 +4645,16 @@ void r_shader_cache(r_ctx* ctx, r_shader shader, const char* name) {
 }
 
 void r_shader_bind(r_shader shader) {
-  glUseProgram(shader);
+  r_state_shader(_r_ctx, shader);
 }
 
 void r_shader_destroy(r_ctx* ctx, r_shader shader) {
   glDeleteProgram(shader);
+  r_uniform_forget(shader);
+
+  if (ctx->state.shader == shader) {
+    ctx->state.shader = R_STATE_UNKNOWN;
+  }
 
   int8_t start = 0;
   for (uint8_t i = 0; i < ctx->shader_count - 1; ++i) {
@@ -2127,7 +5125,7 @@ void r_sprite_update(r_sprite* sprite, long delta) {
 }
 
 void r_set_uniformf(r_shader shader, const char* name, float value) {
-  glUniform1f(glGetUniformLocation(shader, name), value);
+  glUniform1f(r_get_loc(shader, name), value);
 }
 
 void r_set_uniformfi(int loc, float value) {
@@ -2135,7 +5133,7 @@ void r_set_uniformfi(int loc, float value) {
 }
 
 void r_set_uniformi(r_shader shader, const char* name, int value) {
-  glUniform1i(glGetUniformLocation(shader, name), value);
+  glUniform1i(r_get_loc(shader, name), value);
 }
 
 void r_set_uniformii(int loc, int val) {
@@ -2143,7 +5141,7 @@ void r_set_uniformii(int loc, int val) {
 }
 
 void r_set_v4(r_shader shader, const char* name, vec4 value) {
-  glUniform4f(glGetUniformLocation(shader, name), value[0], value[1], value[2],
+  glUniform4f(r_get_loc(shader, name), value[0], value[1], value[2],
               value[3]);
 }
 
@@ -2152,7 +5150,7 @@ void r_set_v4i(int loc, vec4 value) {
 }
 
 void r_set_v3(r_shader shader, const char* name, vec3 value) {
-  glUniform3f(glGetUniformLocation(shader, name), value[0], value[1], value[2]);
+  glUniform3f(r_get_loc(shader, name), value[0], value[1], value[2]);
 }
 
 void r_set_v3i(int loc, vec3 val) {
@@ -2160,7 +5158,7 @@ void r_set_v3i(int loc, vec3 val) {
 }
 
 void r_set_v2(r_shader shader, const char* name, vec2 value) {
-  glUniform2f(glGetUniformLocation(shader, name), value[0], value[1]);
+  glUniform2f(r_get_loc(shader, name), value[0], value[1]);
 }
 
 void r_set_v2i(int loc, vec2 val) {
@@ -2168,7 +5166,7 @@ void r_set_v2i(int loc, vec2 val) {
 }
 
 void r_set_m4(r_shader shader, const char* name, mat4x4 value) {
-  glUniformMatrix4fv(glGetUniformLocation(shader, name), 1, GL_FALSE,
+  glUniformMatrix4fv(r_get_loc(shader, name), 1, GL_FALSE,
                      (GLfloat*)value);
 }
 
@@ -2177,28 +5175,28 @@ void r_set_m4i(int loc, mat4x4 val) {
 }
 
 int r_get_loc(r_shader shader, const char* name) {
-  return glGetUniformLocation(shader, name);
+  return r_uniform_loc(shader, name, r_uniform_hash(name));
 }
 
 void r_set_m4x(r_shader shader, uint32_t count, const char* name,
                mat4x4* values) {
   if (!count)
     return;
-  glUniformMatrix4fv(glGetUniformLocation(shader, name), count, GL_FALSE,
+  glUniformMatrix4fv(r_get_loc(shader, name), count, GL_FALSE,
                      (const GLfloat*)values);
 }
 
 void r_set_ix(r_shader shader, uint32_t count, const char* name, int* values) {
   if (!count)
     return;
-  glUniform1iv(glGetUniformLocation(shader, name), count, (const GLint*)values);
+  glUniform1iv(r_get_loc(shader, name), count, (const GLint*)values);
 }
 
 void r_set_fx(r_shader shader, uint32_t count, const char* name,
               float* values) {
   if (!count)
     return;
-  glUniform1fv(glGetUniformLocation(shader, name), count,
+  glUniform1fv(r_get_loc(shader, name), count,
                (const GLfloat*)values);
 }
 
@@ -2207,7 +5205,7 @@ void r_set_v2x(r_shader shader, uint32_t count, const char* name,
   if (!count)
     return;
 
-  glUniform2fv(glGetUniformLocation(shader, name), count,
+  glUniform2fv(r_get_loc(shader, name), count,
                (const GLfloat*)values);
 }
 
@@ -2216,7 +5214,7 @@ void r_set_v3x(r_shader shader, uint32_t count, const char* name,
   if (!count)
     return;
 
-  glUniform3fv(glGetUniformLocation(shader, name), count,
+  glUniform3fv(r_get_loc(shader, name), count,
                (const GLfloat*)values);
 }
 
@@ -2225,7 +5223,7 @@ void r_set_v4x(r_shader shader, uint32_t count, const char* name,
   if (!count)
     return;
 
-  glUniform4fv(glGetUniformLocation(shader, name), count,
+  glUniform4fv(r_get_loc(shader, name), count,
                (const GLfloat*)values);
 }
 
@@ -2786,6 +5784,7 @@ uint8_t r_window_should_close(r_ctx* ctx) {
 
 void r_window_swap_buffers(r_ctx* ctx) {
   glfwSwapBuffers(ctx->window.glfw);
+  r_ctx_reset_state(ctx);
 }
 
 void r_window_clear(void) {
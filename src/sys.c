@@ -12,6 +12,7 @@
 #include <windows.h>
 #else
 #include <time.h>
+#include <pthread.h>
 #endif
 
 #include <stdlib.h>
@@ -109,6 +110,40 @@ s_timer s_timer_create() {
   return (s_timer){s_get_time(), 0};
 }
 
+s_rand s_rand_create(uint64_t seed, uint64_t stream) {
+  s_rand rng = (s_rand){0, (stream << 1u) | 1u};
+  s_rand_next(&rng);
+  rng.state += seed;
+  s_rand_next(&rng);
+  return rng;
+}
+
+uint32_t s_rand_next(s_rand* rng) {
+  uint64_t state = rng->state;
+  rng->state     = state * 6364136223846793005ull + rng->inc;
+
+  uint32_t value  = (uint32_t)(((state >> 18u) ^ state) >> 27u);
+  uint32_t rotate = (uint32_t)(state >> 59u);
+  return (value >> rotate) | (value << ((32u - rotate) & 31u));
+}
+
+// The top 24 bits fit a float's mantissa exactly, so the value stays < 1
+static float s_rand_unit(s_rand* rng) {
+  return (float)(s_rand_next(rng) >> 8) * (1.f / 16777216.f);
+}
+
+float s_rand_range(s_rand* rng, float min, float max) {
+  return min + (max - min) * s_rand_unit(rng);
+}
+
+void s_rand_fill(s_rand* rng, float* dst, uint32_t count, float min,
+                 float max) {
+  float range = max - min;
+  for (uint32_t i = 0; i < count; ++i) {
+    dst[i] = min + range * s_rand_unit(rng);
+  }
+}
+
 /* String reversal */
 static char* s_reverse(char* string, uint32_t length) {
   uint32_t start = 0;
@@ -684,3 +719,466 @@ char* s_buff_get_s(s_buffer_t* buffer, char* dst) {
 }
 
 #endif
+
+#if defined(_WIN32) || defined(_WIN64)
+typedef CRITICAL_SECTION   s_mutex_native;
+typedef CONDITION_VARIABLE s_cond_native;
+typedef HANDLE             s_thread_native;
+#else
+typedef pthread_mutex_t s_mutex_native;
+typedef pthread_cond_t  s_cond_native;
+typedef pthread_t       s_thread_native;
+#endif
+
+struct s_mutex {
+  s_mutex_native native;
+};
+
+typedef struct {
+  s_job_func func;
+  void*      data;
+  int32_t    priority;
+  uint32_t   sequence;
+} s_job;
+
+struct s_pool {
+  /* lock - guards everything below
+   * work - signaled when a job is pushed or the pool stops
+   * idle - signaled when the queue empties & no jobs are running
+   * finished - signaled whenever a job finishes */
+  s_mutex_native lock;
+  s_cond_native  work, idle, finished;
+
+  /* running - the data of the job each thread is running (0 = none) */
+  s_thread_native* threads;
+  void**           running;
+  uint32_t         thread_count;
+
+  /* jobs - max heap ordered by priority, then sequence
+   * active - the number of jobs currently running */
+  s_job*   jobs;
+  uint32_t job_count, job_capacity;
+  uint32_t sequence, active;
+  uint8_t  stop;
+};
+
+static void s_mutex_native_init(s_mutex_native* mutex) {
+#if defined(_WIN32) || defined(_WIN64)
+  InitializeCriticalSection(mutex);
+#else
+  pthread_mutex_init(mutex, 0);
+#endif
+}
+
+static void s_mutex_native_free(s_mutex_native* mutex) {
+#if defined(_WIN32) || defined(_WIN64)
+  DeleteCriticalSection(mutex);
+#else
+  pthread_mutex_destroy(mutex);
+#endif
+}
+
+static void s_mutex_native_lock(s_mutex_native* mutex) {
+#if defined(_WIN32) || defined(_WIN64)
+  EnterCriticalSection(mutex);
+#else
+  pthread_mutex_lock(mutex);
+#endif
+}
+
+static void s_mutex_native_unlock(s_mutex_native* mutex) {
+#if defined(_WIN32) || defined(_WIN64)
+  LeaveCriticalSection(mutex);
+#else
+  pthread_mutex_unlock(mutex);
+#endif
+}
+
+static void s_cond_native_init(s_cond_native* cond) {
+#if defined(_WIN32) || defined(_WIN64)
+  InitializeConditionVariable(cond);
+#else
+  pthread_cond_init(cond, 0);
+#endif
+}
+
+static void s_cond_native_free(s_cond_native* cond) {
+#if defined(_WIN32) || defined(_WIN64)
+  (void)cond;
+#else
+  pthread_cond_destroy(cond);
+#endif
+}
+
+static void s_cond_native_wait(s_cond_native* cond, s_mutex_native* mutex) {
+#if defined(_WIN32) || defined(_WIN64)
+  SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+  pthread_cond_wait(cond, mutex);
+#endif
+}
+
+static void s_cond_native_broadcast(s_cond_native* cond) {
+#if defined(_WIN32) || defined(_WIN64)
+  WakeAllConditionVariable(cond);
+#else
+  pthread_cond_broadcast(cond);
+#endif
+}
+
+static void s_cond_native_signal(s_cond_native* cond) {
+#if defined(_WIN32) || defined(_WIN64)
+  WakeConditionVariable(cond);
+#else
+  pthread_cond_signal(cond);
+#endif
+}
+
+uint32_t s_cpu_count(void) {
+#if defined(_WIN32) || defined(_WIN64)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (info.dwNumberOfProcessors > 0) ? info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return (count > 0) ? (uint32_t)count : 1;
+#else
+  return 1;
+#endif
+}
+
+s_mutex* s_mutex_create(void) {
+  s_mutex* mutex = (s_mutex*)calloc(1, sizeof(s_mutex));
+
+  if (!mutex) {
+    ASTERA_FUNC_DBG("unable to allocate mutex\n");
+    return 0;
+  }
+
+  s_mutex_native_init(&mutex->native);
+  return mutex;
+}
+
+void s_mutex_destroy(s_mutex* mutex) {
+  if (!mutex)
+    return;
+
+  s_mutex_native_free(&mutex->native);
+  free(mutex);
+}
+
+void s_mutex_lock(s_mutex* mutex) {
+  s_mutex_native_lock(&mutex->native);
+}
+
+void s_mutex_unlock(s_mutex* mutex) {
+  s_mutex_native_unlock(&mutex->native);
+}
+
+static uint8_t s_job_before(s_job* a, s_job* b) {
+  if (a->priority != b->priority) {
+    return a->priority > b->priority;
+  }
+
+  return a->sequence < b->sequence;
+}
+
+// Move a job up the heap until its parent comes before it
+static void s_pool_heap_up(s_pool* pool, uint32_t i) {
+  while (i > 0) {
+    uint32_t parent = (i - 1) / 2;
+
+    if (!s_job_before(&pool->jobs[i], &pool->jobs[parent])) {
+      break;
+    }
+
+    s_job tmp          = pool->jobs[i];
+    pool->jobs[i]      = pool->jobs[parent];
+    pool->jobs[parent] = tmp;
+    i                  = parent;
+  }
+}
+
+// Move a job down the heap until it comes before its children
+static void s_pool_heap_down(s_pool* pool, uint32_t i) {
+  while (1) {
+    uint32_t left = (i * 2) + 1, right = left + 1, best = i;
+
+    if (left < pool->job_count &&
+        s_job_before(&pool->jobs[left], &pool->jobs[best])) {
+      best = left;
+    }
+
+    if (right < pool->job_count &&
+        s_job_before(&pool->jobs[right], &pool->jobs[best])) {
+      best = right;
+    }
+
+    if (best == i) {
+      break;
+    }
+
+    s_job tmp        = pool->jobs[i];
+    pool->jobs[i]    = pool->jobs[best];
+    pool->jobs[best] = tmp;
+    i                = best;
+  }
+}
+
+static void s_pool_heap_push(s_pool* pool, s_job job) {
+  uint32_t i    = pool->job_count++;
+  pool->jobs[i] = job;
+
+  s_pool_heap_up(pool, i);
+}
+
+// Take the job at i out of the heap
+static s_job s_pool_heap_take(s_pool* pool, uint32_t i) {
+  s_job job = pool->jobs[i];
+
+  --pool->job_count;
+  if (i < pool->job_count) {
+    pool->jobs[i] = pool->jobs[pool->job_count];
+    s_pool_heap_down(pool, i);
+    s_pool_heap_up(pool, i);
+  }
+
+  return job;
+}
+
+static s_job s_pool_heap_pop(s_pool* pool) {
+  return s_pool_heap_take(pool, 0);
+}
+
+// returns: if a thread of the pool is running the job with data
+static uint8_t s_pool_running(s_pool* pool, void* data) {
+  for (uint32_t i = 0; i < pool->thread_count; ++i) {
+    if (pool->running[i] == data) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+static DWORD WINAPI s_pool_worker(LPVOID arg) {
+#else
+static void* s_pool_worker(void* arg) {
+#endif
+  s_pool* pool = (s_pool*)arg;
+
+  s_mutex_native_lock(&pool->lock);
+
+  while (1) {
+    while (!pool->job_count && !pool->stop) {
+      s_cond_native_wait(&pool->work, &pool->lock);
+    }
+
+    // Queued jobs are always finished before stopping
+    if (!pool->job_count && pool->stop) {
+      break;
+    }
+
+    s_job job = s_pool_heap_pop(pool);
+    ++pool->active;
+
+    // Mark the job running in a free slot, there's one for each thread
+    uint32_t slot = 0;
+    while (pool->running[slot]) {
+      ++slot;
+    }
+    pool->running[slot] = job.data;
+
+    s_mutex_native_unlock(&pool->lock);
+    job.func(job.data);
+    s_mutex_native_lock(&pool->lock);
+
+    pool->running[slot] = 0;
+    --pool->active;
+    s_cond_native_broadcast(&pool->finished);
+
+    if (!pool->job_count && !pool->active) {
+      s_cond_native_broadcast(&pool->idle);
+    }
+  }
+
+  s_mutex_native_unlock(&pool->lock);
+
+  return 0;
+}
+
+s_pool* s_pool_create(uint32_t thread_count) {
+  s_pool* pool = (s_pool*)calloc(1, sizeof(s_pool));
+
+  if (!pool) {
+    ASTERA_FUNC_DBG("unable to allocate pool\n");
+    return 0;
+  }
+
+  s_mutex_native_init(&pool->lock);
+  s_cond_native_init(&pool->work);
+  s_cond_native_init(&pool->idle);
+  s_cond_native_init(&pool->finished);
+
+  if (thread_count) {
+    pool->threads =
+        (s_thread_native*)calloc(thread_count, sizeof(s_thread_native));
+    pool->running = (void**)calloc(thread_count, sizeof(void*));
+
+    if (!pool->threads || !pool->running) {
+      ASTERA_FUNC_DBG("unable to allocate %i threads\n", thread_count);
+      s_pool_destroy(pool);
+      return 0;
+    }
+  }
+
+  for (uint32_t i = 0; i < thread_count; ++i) {
+#if defined(_WIN32) || defined(_WIN64)
+    pool->threads[i] = CreateThread(0, 0, s_pool_worker, pool, 0, 0);
+    uint8_t started  = pool->threads[i] != 0;
+#else
+    uint8_t started =
+        pthread_create(&pool->threads[i], 0, s_pool_worker, pool) == 0;
+#endif
+
+    if (!started) {
+      ASTERA_FUNC_DBG("unable to start thread %i\n", i);
+      s_pool_destroy(pool);
+      return 0;
+    }
+
+    ++pool->thread_count;
+  }
+
+  return pool;
+}
+
+void s_pool_destroy(s_pool* pool) {
+  if (!pool)
+    return;
+
+  s_mutex_native_lock(&pool->lock);
+  pool->stop = 1;
+  s_cond_native_broadcast(&pool->work);
+  s_mutex_native_unlock(&pool->lock);
+
+  for (uint32_t i = 0; i < pool->thread_count; ++i) {
+#if defined(_WIN32) || defined(_WIN64)
+    WaitForSingleObject(pool->threads[i], INFINITE);
+    CloseHandle(pool->threads[i]);
+#else
+    pthread_join(pool->threads[i], 0);
+#endif
+  }
+
+  s_cond_native_free(&pool->finished);
+  s_cond_native_free(&pool->idle);
+  s_cond_native_free(&pool->work);
+  s_mutex_native_free(&pool->lock);
+
+  if (pool->threads)
+    free(pool->threads);
+
+  if (pool->running)
+    free(pool->running);
+
+  if (pool->jobs)
+    free(pool->jobs);
+
+  free(pool);
+}
+
+uint8_t s_pool_push(s_pool* pool, s_job_func func, void* data,
+                    int32_t priority) {
+  if (!pool || !func) {
+    ASTERA_FUNC_DBG("invalid parameters passed\n");
+    return 0;
+  }
+
+  // Without any workers the job is ran right away
+  if (!pool->thread_count) {
+    func(data);
+    return 1;
+  }
+
+  s_mutex_native_lock(&pool->lock);
+
+  if (pool->job_count == pool->job_capacity) {
+    uint32_t capacity = pool->job_capacity ? pool->job_capacity * 2 : 64;
+    s_job*   jobs     = (s_job*)realloc(pool->jobs, sizeof(s_job) * capacity);
+
+    if (!jobs) {
+      ASTERA_FUNC_DBG("unable to grow job queue to %i\n", capacity);
+      s_mutex_native_unlock(&pool->lock);
+      return 0;
+    }
+
+    pool->jobs         = jobs;
+    pool->job_capacity = capacity;
+  }
+
+  s_pool_heap_push(pool, (s_job){.func     = func,
+                                 .data     = data,
+                                 .priority = priority,
+                                 .sequence = pool->sequence++});
+
+  s_cond_native_signal(&pool->work);
+  s_mutex_native_unlock(&pool->lock);
+
+  return 1;
+}
+
+void s_pool_wait(s_pool* pool) {
+  if (!pool)
+    return;
+
+  s_mutex_native_lock(&pool->lock);
+
+  while (pool->job_count || pool->active) {
+    s_cond_native_wait(&pool->idle, &pool->lock);
+  }
+
+  s_mutex_native_unlock(&pool->lock);
+}
+
+void s_pool_finish(s_pool* pool, void* data) {
+  if (!pool || !data)
+    return;
+
+  s_mutex_native_lock(&pool->lock);
+
+  // Not started yet, take it off the queue & run it here
+  for (uint32_t i = 0; i < pool->job_count; ++i) {
+    if (pool->jobs[i].data == data) {
+      s_job job = s_pool_heap_take(pool, i);
+
+      // Counted as running so s_pool_wait doesn't return before it's done
+      ++pool->active;
+
+      s_mutex_native_unlock(&pool->lock);
+      job.func(job.data);
+      s_mutex_native_lock(&pool->lock);
+
+      --pool->active;
+      s_cond_native_broadcast(&pool->finished);
+
+      if (!pool->job_count && !pool->active) {
+        s_cond_native_broadcast(&pool->idle);
+      }
+
+      s_mutex_native_unlock(&pool->lock);
+      return;
+    }
+  }
+
+  while (s_pool_running(pool, data)) {
+    s_cond_native_wait(&pool->finished, &pool->lock);
+  }
+
+  s_mutex_native_unlock(&pool->lock);
+}
+
+uint32_t s_pool_thread_count(s_pool* pool) {
+  return pool ? pool->thread_count : 0;
+}
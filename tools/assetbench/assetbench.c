@@ -0,0 +1,205 @@
+// Stress loading & unloading assets to compare heap & arena allocation
+// usage:
+// assetbench heap|arena levels file ... file n
+// Ex: assetbench arena 100 $(find examples/resources -type f)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAVE_MALLINFO2
+#endif
+
+#include <astera/asset.h>
+#include <astera/sys.h>
+
+// The allocations the rest of a game makes while a level loads
+#define BENCH_CHURN_MIN 32
+#define BENCH_CHURN_MAX 512
+
+// returns: peak resident memory of the process in KB, unknown = 0
+static uint64_t bench_peak_rss(void) {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    return (uint64_t)counters.PeakWorkingSetSize / 1024;
+  }
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return (uint64_t)usage.ru_maxrss / 1024;
+#else
+  return (uint64_t)usage.ru_maxrss;
+#endif
+#endif
+}
+
+/* returns: the share of the heap that's free but stuck between allocations
+ * (free space at the top of the heap can be given back), unknown = -1 */
+static double bench_fragmentation(uint64_t* heap_size) {
+#if defined(HAVE_MALLINFO2)
+  struct mallinfo2 info = mallinfo2();
+  *heap_size            = (uint64_t)info.arena;
+  if (!info.arena) {
+    return 0.0;
+  }
+  return (double)(info.fordblks - info.keepcost) / (double)info.arena;
+#else
+  *heap_size = 0;
+  return -1.0;
+#endif
+}
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    printf("Usage: ./assetbench heap|arena levels file ... file n\n");
+    printf("Ex: ./assetbench arena 100 $(find resources -type f)\n");
+    return 0;
+  }
+
+  uint8_t use_arena = strcmp(argv[1], "arena") == 0;
+  int     levels    = atoi(argv[2]);
+
+  if (!use_arena && strcmp(argv[1], "heap") != 0) {
+    printf("Unknown allocation mode: %s\n", argv[1]);
+    return 1;
+  }
+
+  if (levels <= 0) {
+    printf("Invalid level count: %s\n", argv[2]);
+    return 1;
+  }
+
+  char**   files      = &argv[3];
+  uint32_t file_count = (uint32_t)(argc - 3);
+
+  asset_map_t   map   = asset_map_create(0, "assetbench", file_count, 0);
+  asset_arena_t arena = (asset_arena_t){0};
+
+  if (use_arena) {
+    // Size the arena for one level: every file plus its asset & alignment
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < file_count; ++i) {
+      FILE* f = fopen(files[i], "rb");
+      if (f) {
+        fseek(f, 0, SEEK_END);
+        total += (uint64_t)ftell(f);
+        fclose(f);
+      }
+      total += sizeof(asset_t) + 64;
+    }
+
+    arena = asset_arena_create(0, (uint32_t)total);
+
+    if (!arena.capacity) {
+      printf("Unable to create an arena of %llu bytes\n",
+             (unsigned long long)total);
+      return 1;
+    }
+
+    asset_map_set_arena(&map, &arena);
+  }
+
+  // Allocations that outlive a level, freed a level later
+  void**   churn      = (void**)calloc(file_count * 2, sizeof(void*));
+  uint32_t churn_seed = 1;
+
+  double   worst_frag = 0.0;
+  uint64_t worst_heap = 0;
+  uint64_t loaded     = 0;
+  time_s   load_time = 0.0, unload_time = 0.0;
+
+  for (int level = 0; level < levels; ++level) {
+    uint32_t scope = use_arena ? asset_map_scope_begin(&map) : 0;
+
+    // Free the churn of the level before last
+    void** old_churn = &churn[(level % 2) * file_count];
+    for (uint32_t i = 0; i < file_count; ++i) {
+      free(old_churn[i]);
+      old_churn[i] = 0;
+    }
+
+    time_s start = s_get_time();
+    for (uint32_t i = 0; i < file_count; ++i) {
+      asset_t* asset = asset_map_get(&map, files[i]);
+
+      if (!asset) {
+        printf("Unable to load %s\n", files[i]);
+        return 1;
+      }
+
+      loaded += asset->data_length;
+
+      churn_seed   = churn_seed * 1103515245 + 12345;
+      old_churn[i] = malloc(BENCH_CHURN_MIN +
+                            (churn_seed >> 16) % BENCH_CHURN_MAX);
+    }
+    load_time += s_get_time() - start;
+
+    start = s_get_time();
+    if (use_arena) {
+      asset_map_scope_end(&map, scope);
+    } else {
+      for (uint32_t i = map.count; i > 0; --i) {
+        asset_map_removei(&map, map.live[i - 1]);
+      }
+    }
+    unload_time += s_get_time() - start;
+
+    uint64_t heap = 0;
+    double   frag = bench_fragmentation(&heap);
+    if (frag > worst_frag || frag < 0.0) {
+      worst_frag = frag;
+    }
+    if (heap > worst_heap) {
+      worst_heap = heap;
+    }
+  }
+
+  printf("mode:              %s\n", use_arena ? "arena" : "heap");
+  printf("levels:            %i (%u files, %llu bytes loaded)\n", levels,
+         file_count, (unsigned long long)loaded);
+  printf("load ms / level:   %.3f\n", (double)load_time / levels);
+  printf("unload ms / level: %.3f\n", (double)unload_time / levels);
+  printf("peak rss:          %llu KB\n",
+         (unsigned long long)bench_peak_rss());
+
+  if (worst_frag >= 0.0) {
+    printf("fragmentation:     %.1f%% of the heap free but held (worst)\n",
+           worst_frag * 100.0);
+    printf("heap after unload: %llu KB (largest)\n",
+           (unsigned long long)(worst_heap / 1024));
+  } else {
+    printf("fragmentation:     n/a on this platform\n");
+  }
+
+  if (use_arena) {
+    printf("arena peak:        %u / %u bytes\n", arena.peak, arena.capacity);
+  }
+
+  for (uint32_t i = 0; i < file_count * 2; ++i) {
+    free(churn[i]);
+  }
+  free(churn);
+
+  asset_map_destroy(&map);
+  asset_arena_destroy(&arena);
+
+  return 0;
+}
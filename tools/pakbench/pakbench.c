@@ -0,0 +1,198 @@
+// Compare pak size & load times between compression codecs
+// usage:
+// pakbench iterations file ... file n
+// Ex: pakbench 100 $(find examples/resources -type f)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <astera/asset.h>
+#include <astera/sys.h>
+
+typedef struct {
+  const char* name;
+  const char* path;
+  uint8_t     codec;
+  uint8_t     level;
+} bench_config;
+
+// Open the pak & extract every entry once
+// returns: total bytes extracted
+static uint64_t bench_load(const char* path, uint8_t use_mmap) {
+  pak_t* pak = use_mmap ? pak_open_mmap(path) : pak_open_file(path);
+
+  if (!pak) {
+    return 0;
+  }
+
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < pak_count(pak); ++i) {
+    uint32_t       size = 0;
+    unsigned char* data = pak_extract(pak, i, &size);
+
+    if (!data) {
+      continue;
+    }
+
+    total += size;
+
+    if (!pak->is_mem || pak_compressed(pak, i)) {
+      free(data);
+    }
+  }
+
+  pak_close(pak);
+  return total;
+}
+
+// Open the pak & extract every entry with one batch into a single buffer
+// returns: total bytes extracted
+static uint64_t bench_load_batch(const char* path) {
+  pak_t* pak = pak_open_file(path);
+
+  if (!pak) {
+    return 0;
+  }
+
+  uint32_t        count   = pak_count(pak);
+  uint32_t*       indices = (uint32_t*)malloc(sizeof(uint32_t) * count);
+  uint32_t*       sizes   = (uint32_t*)malloc(sizeof(uint32_t) * count);
+  unsigned char** out =
+      (unsigned char**)calloc(count, sizeof(unsigned char*));
+
+  // Ask in reverse so the batch has to sort them back into place
+  for (uint32_t i = 0; i < count; ++i) {
+    indices[i] = count - 1 - i;
+  }
+
+  uint32_t       cap    = pak_extract_batch_size(pak, indices, count);
+  unsigned char* buffer = (unsigned char*)malloc(cap ? cap : 1);
+
+  uint64_t total = 0;
+  if (pak_extract_batch(pak, indices, count, out, sizes, buffer, cap) ==
+      count) {
+    for (uint32_t i = 0; i < count; ++i) {
+      total += sizes[i];
+    }
+  }
+
+  free(buffer);
+  free(out);
+  free(sizes);
+  free(indices);
+  pak_close(pak);
+  return total;
+}
+
+int main(int argc, char** argv) {
+#if defined(ASTERA_PAK_WRITE)
+  if (argc < 3) {
+    printf("Usage: ./pakbench iterations file ... file n\n");
+    printf("Ex: ./pakbench 100 $(find resources -type f)\n");
+    return 0;
+  }
+
+  int iterations = atoi(argv[1]);
+
+  if (iterations <= 0) {
+    printf("Invalid iteration count: %s\n", argv[1]);
+    return 1;
+  }
+
+  bench_config configs[] = {
+      {"none", "pakbench_none.pak", PAK_CODEC_NONE, 1},
+      {"lz4 -l 1", "pakbench_lz4_1.pak", PAK_CODEC_LZ4, 1},
+      {"lz4 -l 9", "pakbench_lz4_9.pak", PAK_CODEC_LZ4, 9},
+  };
+  uint32_t config_count = sizeof(configs) / sizeof(bench_config);
+
+  printf("%-10s %12s %10s %14s %14s %14s\n", "codec", "size", "build ms",
+         "file load ms", "batch load ms", "mmap load ms");
+
+  for (uint32_t c = 0; c < config_count; ++c) {
+    bench_config* config = &configs[c];
+    pak_write_t*  write  = pak_write_create(config->path);
+
+    if (!write) {
+      return 1;
+    }
+
+    pak_write_set_codec(write, config->codec, config->level);
+
+    for (int i = 2; i < argc; ++i) {
+      if (!pak_write_add_file(write, argv[i], argv[i])) {
+        printf("Unable to add file: %s\n", argv[i]);
+      }
+    }
+
+    time_s start = s_get_time();
+    if (!pak_write_to_file(write)) {
+      printf("Unable to write %s\n", config->path);
+      pak_write_destroy(write);
+      return 1;
+    }
+    time_s build = s_get_time() - start;
+
+    pak_write_destroy(write);
+
+    pak_t* pak = pak_open_file(config->path);
+    if (!pak) {
+      printf("Unable to open %s\n", config->path);
+      return 1;
+    }
+
+    uint64_t stored = 0, raw = 0;
+    for (uint32_t i = 0; i < pak_count(pak); ++i) {
+      stored += pak_stored_size(pak, i);
+      raw += pak_size(pak, i);
+    }
+    uint32_t pak_bytes = pak->data_size;
+    pak_close(pak);
+
+    time_s file_load = 0.0, batch_load = 0.0, mmap_load = 0.0;
+
+    start = s_get_time();
+    for (int i = 0; i < iterations; ++i) {
+      if (bench_load(config->path, 0) != raw) {
+        printf("Mismatched extraction in %s\n", config->path);
+        return 1;
+      }
+    }
+    file_load = (s_get_time() - start) / iterations;
+
+    start = s_get_time();
+    for (int i = 0; i < iterations; ++i) {
+      if (bench_load_batch(config->path) != raw) {
+        printf("Mismatched extraction in %s\n", config->path);
+        return 1;
+      }
+    }
+    batch_load = (s_get_time() - start) / iterations;
+
+    start = s_get_time();
+    for (int i = 0; i < iterations; ++i) {
+      if (bench_load(config->path, 1) != raw) {
+        printf("Mismatched extraction in %s\n", config->path);
+        return 1;
+      }
+    }
+    mmap_load = (s_get_time() - start) / iterations;
+
+    printf("%-10s %12u %10.3f %14.3f %14.3f %14.3f\n", config->name,
+           pak_bytes, (double)build, (double)file_load, (double)batch_load,
+           (double)mmap_load);
+    printf("%-10s ratio: %.3f (%llu / %llu bytes)\n", "",
+           raw ? (double)stored / (double)raw : 0.0,
+           (unsigned long long)stored, (unsigned long long)raw);
+
+    remove(config->path);
+  }
+
+  return 0;
+#else
+  printf("Please enable ASTERA_PAK_WRITE in the build system to get this "
+         "program, thank you!\n");
+  return 0;
+#endif
+}
@@ -1,33 +1,471 @@
 // Use this for all your pak needs
 // usage:
-// pakutil [(m)ake|(c)heck|(d)ata] pak_file_path file ... file n
+// pakutil [(m)ake|(u)pdate|(c)heck|(d)ata] pak_file_path file ... file n
+// pakutil make [-c none|lz4] [-l 1-9] [-j threads] pak_file_path file ... n
+// pakutil update [-c none|lz4] [-l 1-9] [-j threads] pak_file_path file ... n
+// pakutil texture [-f rgba8|bc3] [-m levels] [-p padding] [-s max_size]
+//                 [-t WxH] dst.rtex image ... image n
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <stb_image.h>
+
 #include <astera/asset.h>
+#include <astera/render.h>
+#include <astera/sys.h>
 
 typedef enum {
   NONE = 0,
   MAKE,
+  UPDATE,
   CHECK,
   DATA,
+  TEXTURE,
 } usage_modes;
 
+typedef struct {
+  /* format - the r_tex_format to store
+   * levels - the amount of mip levels to store, 0 = down to 1x1
+   * padding - the empty pixels between images
+   * max_size - the largest the texture can be
+   * tile_width, tile_height - split each image into tiles, 0 = don't */
+  r_tex_format format;
+  uint32_t     levels, padding, max_size;
+  uint32_t     tile_width, tile_height;
+} texture_options;
+
+typedef struct {
+  unsigned char* pixels;
+  uint32_t       width, height;
+  uint32_t       x, y;
+} texture_image;
+
+static const char* codec_name(pak_t* pak, uint32_t index) {
+  switch (pak_codec_of(pak, index)) {
+    case PAK_CODEC_LZ4:
+      return "lz4";
+    case PAK_CODEC_LZ4_CHUNKED:
+      return "lz4 chunked";
+    default:
+      return "none";
+  }
+}
+
+// returns: megabytes per second for bytes over ms
+static double throughput(uint64_t bytes, double ms) {
+  return (ms > 0.0) ? ((double)bytes / (1024.0 * 1024.0)) / (ms / 1000.0)
+                    : 0.0;
+}
+
+static texture_image* sort_images;
+
+// Tallest first, then widest, packs the tightest
+static int texture_image_cmp(const void* a, const void* b) {
+  texture_image* ia = &sort_images[*(const uint32_t*)a];
+  texture_image* ib = &sort_images[*(const uint32_t*)b];
+
+  if (ia->height != ib->height) {
+    return (ia->height < ib->height) ? 1 : -1;
+  }
+
+  if (ia->width != ib->width) {
+    return (ia->width < ib->width) ? 1 : -1;
+  }
+
+  return 0;
+}
+
+/* Pack the images into the smallest texture that holds them, doubling the
+ * shorter side until they fit
+ * returns: success = 1, fail = 0 */
+static uint8_t texture_pack(texture_image* images, uint32_t count,
+                            texture_options* options, uint32_t* width,
+                            uint32_t* height) {
+  uint32_t* order = (uint32_t*)malloc(sizeof(uint32_t) * count);
+  uint64_t  area  = 0;
+  uint32_t  w = 1, h = 1;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t iw = images[i].width + options->padding;
+    uint32_t ih = images[i].height + options->padding;
+
+    order[i] = i;
+    area += (uint64_t)iw * ih;
+
+    while (w < iw) {
+      w *= 2;
+    }
+
+    while (h < ih) {
+      h *= 2;
+    }
+  }
+
+  // No smaller than the area the images cover
+  while ((uint64_t)w * h < area) {
+    if (w <= h) {
+      w *= 2;
+    } else {
+      h *= 2;
+    }
+  }
+
+  sort_images = images;
+  qsort(order, count, sizeof(uint32_t), texture_image_cmp);
+
+  uint8_t packed = 0;
+  while (!packed && w <= options->max_size && h <= options->max_size) {
+    r_atlas_page page = (r_atlas_page){.sheet = {.width = w, .height = h}};
+    packed            = 1;
+
+    for (uint32_t i = 0; i < count && packed; ++i) {
+      texture_image* image = &images[order[i]];
+      packed = r_atlas_page_pack(&page, image->width + options->padding,
+                                 image->height + options->padding, &image->x,
+                                 &image->y);
+    }
+
+    free(page.skyline);
+
+    if (!packed) {
+      if (w <= h) {
+        w *= 2;
+      } else {
+        h *= 2;
+      }
+    }
+  }
+
+  free(order);
+
+  *width  = w;
+  *height = h;
+  return packed;
+}
+
+// Halve a level with a box filter, sides of 1 stay 1
+static unsigned char* texture_downsample(const unsigned char* src, uint32_t w,
+                                         uint32_t h, uint32_t* out_w,
+                                         uint32_t* out_h) {
+  uint32_t       dw  = (w > 1) ? w / 2 : 1, dh = (h > 1) ? h / 2 : 1;
+  unsigned char* dst = (unsigned char*)malloc((size_t)dw * dh * 4);
+
+  for (uint32_t y = 0; y < dh; ++y) {
+    uint32_t y0 = (y * 2 < h) ? y * 2 : h - 1;
+    uint32_t y1 = (y0 + 1 < h) ? y0 + 1 : y0;
+
+    for (uint32_t x = 0; x < dw; ++x) {
+      uint32_t x0 = (x * 2 < w) ? x * 2 : w - 1;
+      uint32_t x1 = (x0 + 1 < w) ? x0 + 1 : x0;
+
+      for (uint32_t c = 0; c < 4; ++c) {
+        uint32_t sum = src[((y0 * w) + x0) * 4 + c] +
+                       src[((y0 * w) + x1) * 4 + c] +
+                       src[((y1 * w) + x0) * 4 + c] +
+                       src[((y1 * w) + x1) * 4 + c];
+        dst[((y * dw) + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+      }
+    }
+  }
+
+  *out_w = dw;
+  *out_h = dh;
+  return dst;
+}
+
+static uint16_t texture_565(const unsigned char* rgb) {
+  return (uint16_t)((((rgb[0] * 31 + 127) / 255) << 11) |
+                    (((rgb[1] * 63 + 127) / 255) << 5) |
+                    ((rgb[2] * 31 + 127) / 255));
+}
+
+static void texture_888(uint16_t color, int* rgb) {
+  int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+/* Encode a 4x4 block of RGBA pixels as BC3 (DXT5), with the endpoints at
+ * the extremes of the block */
+static void texture_bc3_block(unsigned char block[16][4], unsigned char* dst) {
+  unsigned char lo[4] = {255, 255, 255, 255}, hi[4] = {0, 0, 0, 0};
+
+  for (uint32_t p = 0; p < 16; ++p) {
+    for (uint32_t c = 0; c < 4; ++c) {
+      lo[c] = (block[p][c] < lo[c]) ? block[p][c] : lo[c];
+      hi[c] = (block[p][c] > hi[c]) ? block[p][c] : hi[c];
+    }
+  }
+
+  // Alpha: 8 levels from the max to the min
+  int alphas[8] = {hi[3], lo[3]};
+  for (int i = 2; i < 8; ++i) {
+    alphas[i] = ((8 - i) * hi[3] + (i - 1) * lo[3]) / 7;
+  }
+
+  uint64_t alpha_bits = 0;
+  for (uint32_t p = 0; p < 16; ++p) {
+    int best = 0, best_error = 256;
+
+    for (int i = 0; i < 8; ++i) {
+      int error = abs(block[p][3] - alphas[i]);
+
+      if (error < best_error) {
+        best       = i;
+        best_error = error;
+      }
+    }
+
+    alpha_bits |= (uint64_t)best << (3 * p);
+  }
+
+  dst[0] = hi[3];
+  dst[1] = lo[3];
+  for (uint32_t i = 0; i < 6; ++i) {
+    dst[2 + i] = (unsigned char)(alpha_bits >> (8 * i));
+  }
+
+  // Color: 4 points from the box's max corner to its min
+  uint16_t c0 = texture_565(hi), c1 = texture_565(lo);
+  int      colors[4][3];
+
+  texture_888(c0, colors[0]);
+  texture_888(c1, colors[1]);
+  for (uint32_t c = 0; c < 3; ++c) {
+    colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+    colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+  }
+
+  uint32_t color_bits = 0;
+  for (uint32_t p = 0; p < 16; ++p) {
+    int best = 0, best_error = 0x7FFFFFFF;
+
+    for (int i = 0; i < 4; ++i) {
+      int dr = block[p][0] - colors[i][0], dg = block[p][1] - colors[i][1],
+          db    = block[p][2] - colors[i][2];
+      int error = (dr * dr) + (dg * dg) + (db * db);
+
+      if (error < best_error) {
+        best       = i;
+        best_error = error;
+      }
+    }
+
+    color_bits |= (uint32_t)best << (2 * p);
+  }
+
+  dst[8]  = (unsigned char)(c0 & 0xFF);
+  dst[9]  = (unsigned char)(c0 >> 8);
+  dst[10] = (unsigned char)(c1 & 0xFF);
+  dst[11] = (unsigned char)(c1 >> 8);
+  for (uint32_t i = 0; i < 4; ++i) {
+    dst[12 + i] = (unsigned char)(color_bits >> (8 * i));
+  }
+}
+
+// Encode a level, repeating the edge pixels to fill partial blocks
+static void texture_bc3(const unsigned char* src, uint32_t w, uint32_t h,
+                        unsigned char* dst) {
+  unsigned char block[16][4];
+
+  for (uint32_t by = 0; by < h; by += 4) {
+    for (uint32_t bx = 0; bx < w; bx += 4) {
+      for (uint32_t p = 0; p < 16; ++p) {
+        uint32_t x = bx + (p % 4), y = by + (p / 4);
+        x          = (x < w) ? x : w - 1;
+        y          = (y < h) ? y : h - 1;
+        memcpy(block[p], &src[((y * w) + x) * 4], 4);
+      }
+
+      texture_bc3_block(block, dst);
+      dst += 16;
+    }
+  }
+}
+
+/* Pack decoded images & write them as one pre-decoded texture
+ * returns: success = 1, fail = 0 */
+static uint8_t texture_write(const char* dst, texture_image* images,
+                             uint32_t count, texture_options* options) {
+  uint32_t width, height;
+
+  if (!texture_pack(images, count, options, &width, &height)) {
+    printf("Images don't fit in %ux%u, raise -s or split them up\n",
+           options->max_size, options->max_size);
+    return 0;
+  }
+
+  // Sub textures follow the order the images were passed in
+  uint32_t      region_count = 0;
+  r_tex_region* regions      = 0;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    texture_image* image = &images[i];
+    uint32_t tw = options->tile_width ? options->tile_width : image->width;
+    uint32_t th = options->tile_height ? options->tile_height : image->height;
+    uint32_t per_width = image->width / tw;
+    uint32_t tiles     = per_width * (image->height / th);
+
+    r_tex_region* grown = (r_tex_region*)realloc(
+        regions, sizeof(r_tex_region) * (region_count + tiles + 1));
+
+    if (!grown) {
+      free(regions);
+      return 0;
+    }
+
+    regions = grown;
+
+    for (uint32_t t = 0; t < tiles; ++t) {
+      regions[region_count++] =
+          (r_tex_region){.x      = image->x + (t % per_width) * tw,
+                         .y      = image->y + (t / per_width) * th,
+                         .width  = tw,
+                         .height = th};
+    }
+  }
+
+  unsigned char* level = (unsigned char*)calloc((size_t)width * height, 4);
+
+  for (uint32_t i = 0; i < count; ++i) {
+    texture_image* image = &images[i];
+
+    for (uint32_t y = 0; y < image->height; ++y) {
+      memcpy(&level[(((image->y + y) * width) + image->x) * 4],
+             &image->pixels[y * image->width * 4], image->width * 4);
+    }
+  }
+
+  // The full chain goes down to 1x1
+  uint32_t levels = 1;
+  for (uint32_t w = width, h = height; w > 1 || h > 1; ++levels) {
+    w = (w > 1) ? w / 2 : 1;
+    h = (h > 1) ? h / 2 : 1;
+  }
+
+  if (options->levels && options->levels < levels) {
+    levels = options->levels;
+  }
+
+  r_tex_header header = (r_tex_header){.version      = R_TEX_VERSION,
+                                       .format       = options->format,
+                                       .width        = width,
+                                       .height       = height,
+                                       .levels       = levels,
+                                       .subtex_count = region_count};
+  memcpy(header.magic, R_TEX_MAGIC, 4);
+
+  FILE* f = fopen(dst, "wb");
+
+  if (!f) {
+    printf("Unable to open %s\n", dst);
+    free(level);
+    free(regions);
+    return 0;
+  }
+
+  fwrite(&header, sizeof(r_tex_header), 1, f);
+  fwrite(regions, sizeof(r_tex_region), region_count, f);
+
+  uint64_t total = sizeof(r_tex_header) + sizeof(r_tex_region) * region_count;
+  uint32_t w = width, h = height;
+
+  for (uint32_t i = 0; i < levels; ++i) {
+    uint64_t size = r_tex_level_size(options->format, w, h);
+
+    if (options->format == R_TEX_BC3) {
+      unsigned char* blocks = (unsigned char*)malloc(size);
+      texture_bc3(level, w, h, blocks);
+      fwrite(blocks, 1, size, f);
+      free(blocks);
+    } else {
+      fwrite(level, 1, size, f);
+    }
+
+    total += size;
+
+    if (i + 1 < levels) {
+      unsigned char* next = texture_downsample(level, w, h, &w, &h);
+      free(level);
+      level = next;
+    }
+  }
+
+  uint8_t success = !ferror(f);
+  fclose(f);
+  free(level);
+  free(regions);
+
+  printf("%s: %ux%u %s, %u levels, %u sub textures, %llu bytes\n", dst,
+         width, height, (options->format == R_TEX_BC3) ? "bc3" : "rgba8",
+         levels, region_count, (unsigned long long)total);
+
+  return success;
+}
+
+/* Decode images & write them as one pre-decoded texture
+ * returns: success = 1, fail = 0 */
+static uint8_t texture_make(const char* dst, char** files, uint32_t count,
+                            texture_options* options) {
+  texture_image* images =
+      (texture_image*)calloc(count, sizeof(texture_image));
+  uint8_t success = 1;
+  time_s  start   = s_get_time();
+
+  for (uint32_t i = 0; i < count && success; ++i) {
+    int w, h, ch;
+    images[i].pixels = stbi_load(files[i], &w, &h, &ch, 4);
+
+    if (!images[i].pixels) {
+      printf("Unable to load image: %s\n", files[i]);
+      success = 0;
+      break;
+    }
+
+    images[i].width  = (uint32_t)w;
+    images[i].height = (uint32_t)h;
+
+    if ((options->tile_width && images[i].width < options->tile_width) ||
+        (options->tile_height && images[i].height < options->tile_height)) {
+      printf("%s is smaller than a tile\n", files[i]);
+      success = 0;
+    }
+  }
+
+  if (success && texture_write(dst, images, count, options)) {
+    printf("Decoded & packed %u images in %.3f ms\n", count,
+           (double)(s_get_time() - start));
+  } else {
+    success = 0;
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    if (images[i].pixels) {
+      stbi_image_free(images[i].pixels);
+    }
+  }
+
+  free(images);
+  return success;
+}
+
 int main(int argc, char** argv) {
 #if defined(ASTERA_PAK_WRITE)
   if (argc == 1) {
-    printf("Usage: ./pakutil [(m)ake|(c)heck|(d)ata] dst.pak "
-           "file ... "
+    printf("Usage: ./pakutil [(m)ake|(u)pdate|(c)heck|(d)ata|(t)exture] "
+           "dst.pak file ... "
            "file n\n");
     return 0;
   } else if (argc == 2) {
     if (strcmp(argv[1], "h") == 0 || strcmp(argv[1], "help") == 0 ||
         strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "-help") == 0 ||
         strcmp(argv[1], "--h") == 0 || strcmp(argv[1], "--help") == 0) {
-      printf("Usage: ./pakutil [(m)ake|(c)heck|(d)ata] dst.pak "
-             "file ... "
+      printf("Usage: ./pakutil [(m)ake|(u)pdate|(c)heck|(d)ata|(t)exture] "
+             "dst.pak file ... "
              "file n\n");
       return 0;
     }
@@ -37,10 +475,29 @@ int main(int argc, char** argv) {
         !strcmp(argv[1], "--h") || !strcmp(argv[1], "--help")) {
       if (!strcmp(argv[2], "m") || !strcmp(argv[2], "make")) {
         printf("Pak Util Make: Create a pak file\n");
-        printf("Usage: ./pakutil make dst.pak filepath name ... "
-               "filepath n file name n\n");
+        printf("Usage: ./pakutil make [-c codec] [-l level] [-j threads] "
+               "dst.pak filepath name ... filepath n file name n\n");
+        printf("Options:\n"
+               "  -c codec - compression codec to use: none, lz4 (default: "
+               "none)\n"
+               "  -l level - compression level 1 (fastest) to 9 (smallest) "
+               "(default: 1)\n"
+               "  -j threads - worker threads to hash & compress with "
+               "(default: 0)\n");
         printf("Ex: ./pakutil make example.pak resources/shaders/main.vert "
                "main.vert resources/shaders/main.frag main.frag\n");
+        printf("Ex: ./pakutil make -c lz4 -l 9 example.pak "
+               "resources/shaders/main.vert main.vert\n");
+        return 0;
+      } else if (!strcmp(argv[2], "u") || !strcmp(argv[2], "update")) {
+        printf("Pak Util Update: Rebuild a pak file, reusing the files that "
+               "haven't changed since it was made\n");
+        printf("Usage: ./pakutil update [-c codec] [-l level] [-j threads] "
+               "dst.pak filepath name ... filepath n file name n\n");
+        printf("Options: same as make, files stored with a different codec "
+               "are recompressed\n");
+        printf("Ex: ./pakutil update -c lz4 example.pak "
+               "resources/shaders/main.vert main.vert\n");
         return 0;
       } else if (!strcmp(argv[2], "c") || !strcmp(argv[2], "check")) {
         printf("Pak Util Check: Check a pak file for file(s)\n");
@@ -55,6 +512,24 @@ int main(int argc, char** argv) {
                "n\n");
         printf("Ex: ./pakutil data example.pak test2.txt main.vert\n");
         return 0;
+      } else if (!strcmp(argv[2], "t") || !strcmp(argv[2], "texture")) {
+        printf("Pak Util Texture: Decode & pack images into one texture "
+               "that loads without decoding (r_sheet_create_packed), add it "
+               "to a pak with make\n");
+        printf("Usage: ./pakutil texture [-f format] [-m levels] "
+               "[-p padding] [-s max_size] [-t WxH] dst.rtex image ... "
+               "image n\n");
+        printf("Options:\n"
+               "  -f format - rgba8 or bc3 (default: rgba8)\n"
+               "  -m levels - mip levels to store, 0 = all (default: 1)\n"
+               "  -p padding - empty pixels between images (default: 1)\n"
+               "  -s max_size - the largest width & height (default: "
+               "4096)\n"
+               "  -t WxH - split every image into tiles, each its own sub "
+               "texture (default: one per image)\n");
+        printf("Ex: ./pakutil texture -t 16x16 sprites.rtex "
+               "resources/textures/spritesheet.png\n");
+        return 0;
       }
     }
   }
@@ -63,10 +538,14 @@ int main(int argc, char** argv) {
 
   if (strcmp(argv[1], "make") == 0 || strcmp(argv[0], "m") == 0) {
     mode = MAKE;
+  } else if (strcmp(argv[1], "update") == 0 || strcmp(argv[1], "u") == 0) {
+    mode = UPDATE;
   } else if (strcmp(argv[1], "check") == 0 || strcmp(argv[0], "c") == 0) {
     mode = CHECK;
   } else if (strcmp(argv[1], "data") == 0 || strcmp(argv[0], "d") == 0) {
     mode = DATA;
+  } else if (strcmp(argv[1], "texture") == 0 || strcmp(argv[1], "t") == 0) {
+    mode = TEXTURE;
   }
 
   if (mode == NONE) {
@@ -74,29 +553,151 @@ int main(int argc, char** argv) {
     return 0;
   }
 
-  const char* pak_file = argv[2];
+  // Parse out any options between the mode & the pak file
+  int      arg   = 2;
+  uint8_t  codec = PAK_CODEC_NONE, level = 1;
+  uint32_t threads = 0;
+
+  texture_options texture = (texture_options){
+      .format = R_TEX_RGBA8, .levels = 1, .padding = 1, .max_size = 4096};
+
+  while (arg < argc - 1 && argv[arg][0] == '-') {
+    if (!strcmp(argv[arg], "-c")) {
+      const char* name = argv[arg + 1];
+      if (!strcmp(name, "none")) {
+        codec = PAK_CODEC_NONE;
+      } else if (!strcmp(name, "lz4")) {
+        codec = PAK_CODEC_LZ4;
+      } else {
+        printf("Unknown codec: %s\n", name);
+        return 1;
+      }
+    } else if (!strcmp(argv[arg], "-l")) {
+      level = (uint8_t)atoi(argv[arg + 1]);
+    } else if (!strcmp(argv[arg], "-j")) {
+      int count = atoi(argv[arg + 1]);
+      threads   = (count > 0) ? (uint32_t)count : 0;
+    } else if (!strcmp(argv[arg], "-f")) {
+      const char* name = argv[arg + 1];
+      if (!strcmp(name, "rgba8")) {
+        texture.format = R_TEX_RGBA8;
+      } else if (!strcmp(name, "bc3")) {
+        texture.format = R_TEX_BC3;
+      } else {
+        printf("Unknown texture format: %s\n", name);
+        return 1;
+      }
+    } else if (!strcmp(argv[arg], "-m")) {
+      int levels     = atoi(argv[arg + 1]);
+      texture.levels = (levels > 0) ? (uint32_t)levels : 0;
+    } else if (!strcmp(argv[arg], "-p")) {
+      int padding     = atoi(argv[arg + 1]);
+      texture.padding = (padding > 0) ? (uint32_t)padding : 0;
+    } else if (!strcmp(argv[arg], "-s")) {
+      int size = atoi(argv[arg + 1]);
+      if (size <= 0) {
+        printf("Invalid max size: %s\n", argv[arg + 1]);
+        return 1;
+      }
+      texture.max_size = (uint32_t)size;
+    } else if (!strcmp(argv[arg], "-t")) {
+      if (sscanf(argv[arg + 1], "%ux%u", &texture.tile_width,
+                 &texture.tile_height) != 2 ||
+          !texture.tile_width || !texture.tile_height) {
+        printf("Invalid tile size: %s\n", argv[arg + 1]);
+        return 1;
+      }
+    } else {
+      printf("Unknown option: %s\n", argv[arg]);
+      return 1;
+    }
+
+    arg += 2;
+  }
+
+  if (arg >= argc) {
+    printf("No pak file passed\n");
+    return 1;
+  }
+
+  const char* pak_file = argv[arg];
   pak_t*      pak      = 0;
 
   switch (mode) {
-    case MAKE: {
-      pak_write_t* write = pak_write_create(pak_file);
+    case MAKE:
+    case UPDATE: {
+      // Updates are built next to the old pak, which is kept as the base
+      char    temp_file[512];
+      uint8_t update = 0;
+      FILE*   old    = mode == UPDATE ? fopen(pak_file, "rb") : 0;
+
+      if (old) {
+        fclose(old);
+        snprintf(temp_file, sizeof(temp_file), "%s.tmp", pak_file);
+        update = 1;
+      }
+
+      pak_write_t* write = pak_write_create(update ? temp_file : pak_file);
 
       if (!write) {
         return 1;
       }
 
-      for (int i = 3; i < argc - 1; i += 2) {
+      pak_write_set_codec(write, codec, level);
+      pak_write_set_threads(write, threads);
+
+      if (update) {
+        pak_write_set_base(write, pak_file);
+      }
+
+      for (int i = arg + 1; i < argc - 1; i += 2) {
         const char* name = argv[i + 1];
         const char* fp   = argv[i];
-        printf("%s\n", fp);
         if (!pak_write_add_file(write, fp, fp)) {
           printf("Unable to add file: %s\n", fp);
         }
       }
 
-      pak_write_to_file(write);
+      time_s start = s_get_time();
+
+      if (!pak_write_to_file(write)) {
+        printf("Unable to write %s\n", pak_file);
+        pak_write_destroy(write);
+        return 1;
+      }
+
+      double   elapsed = (double)(s_get_time() - start);
+      uint64_t raw = 0, stored = 0;
+
+      // Time is spent per file across all threads, so it's per core speed
+      for (uint32_t i = 0; i < write->count; ++i) {
+        pak_wfile_t* wfile = &write->files[i];
+
+        printf("%s size: [%u] stored: [%u] time: [%.3f ms] speed: [%.2f "
+               "MB/s]\n",
+               wfile->name, wfile->size, wfile->stored_size, wfile->time,
+               throughput(wfile->size, wfile->time));
+
+        raw += wfile->size;
+        stored += wfile->stored_size;
+      }
+
+      printf("%llu -> %llu bytes in %.3f ms (%.2f MB/s, %u threads)\n",
+             (unsigned long long)raw, (unsigned long long)stored, elapsed,
+             throughput(raw, elapsed), threads);
+      printf("%u files, %u reused, %u shared (%llu bytes saved)\n",
+             write->count, write->reused, write->shared,
+             (unsigned long long)write->shared_bytes);
 
       pak_write_destroy(write);
+
+      if (update) {
+        remove(pak_file);
+        if (rename(temp_file, pak_file) != 0) {
+          printf("Unable to replace %s with %s\n", pak_file, temp_file);
+          return 1;
+        }
+      }
     } break;
     case CHECK: {
       pak = pak_open_file(pak_file);
@@ -106,20 +707,26 @@ int main(int argc, char** argv) {
       }
 
       int count = pak_count(pak);
-      printf("%s contains: %i files\n", argv[2], count);
+      printf("%s contains: %i files\n", pak_file, count);
 
-      if (argc == 3) {
+      if (argc == arg + 1) {
         for (int i = 0; i < pak_count(pak); ++i) {
-          printf("%s index: [%i] size: [%i] offset: [%i]\n", pak_name(pak, i),
-                 i, pak_size(pak, i), pak_offset(pak, i));
+          printf("%s index: [%i] size: [%i] stored: [%i] codec: [%s] offset: "
+                 "[%i]\n",
+                 pak_name(pak, i), i, pak_size(pak, i), pak_stored_size(pak, i),
+                 codec_name(pak, i), pak_offset(pak, i));
         }
       } else {
-        for (int i = 3; i < argc; ++i) {
+        for (int i = arg + 1; i < argc; ++i) {
           int32_t find = pak_find(pak, argv[i]);
 
           if (find > -1) {
-            printf("%s index: [%i] size: [%i] offset: [%i]\n", argv[i], find,
-                   pak_size(pak, find), pak_offset(pak, find));
+            printf("%s index: [%i] size: [%i] stored: [%i] codec: [%s] "
+                   "offset: [%i]\n",
+                   argv[i], find, pak_size(pak, find),
+                   pak_stored_size(pak, find),
+                   codec_name(pak, find),
+                   pak_offset(pak, find));
           } else {
             printf("No match for %s\n", argv[i]);
           }
@@ -134,7 +741,7 @@ int main(int argc, char** argv) {
         return 1;
       }
 
-      for (int i = 3; i < argc; ++i) {
+      for (int i = arg + 1; i < argc; ++i) {
         int find = pak_find(pak, argv[i]);
         if (find != -1) {
           unsigned char* data = pak_extract(pak, find, 0);
@@ -144,6 +751,17 @@ int main(int argc, char** argv) {
       }
 
     } break;
+    case TEXTURE: {
+      if (argc == arg + 1) {
+        printf("No images passed\n");
+        return 1;
+      }
+
+      if (!texture_make(pak_file, &argv[arg + 1], (uint32_t)(argc - arg - 1),
+                        &texture)) {
+        return 1;
+      }
+    } break;
     default:
       printf("How did you get here?");
       break;
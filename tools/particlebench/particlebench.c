@@ -0,0 +1,220 @@
+// Time particle updates & draws for large emitters at different fill ratios,
+// simulated on the CPU & on the GPU (transform feedback)
+// usage:
+// particlebench frames resources
+// Ex: particlebench 300 examples/resources
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <astera/asset.h>
+#include <astera/render.h>
+#include <astera/sys.h>
+
+#define BENCH_CAPACITY 100000
+#define BENCH_LIFE     1000.f
+#define BENCH_DELTA    16
+// MAX_BATCH_SIZE in particles.vert
+#define BENCH_UNIFORMS 32
+
+// Load a file from the resources directory
+static asset_t* bench_asset(const char* dir, const char* file) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", dir, file);
+
+  asset_t* asset = asset_get(path);
+  if (!asset) {
+    printf("Unable to load %s\n", path);
+  }
+
+  return asset;
+}
+
+static r_shader bench_shader(const char* dir) {
+  asset_t* vert   = bench_asset(dir, "shaders/particles.vert");
+  asset_t* frag   = bench_asset(dir, "shaders/particles.frag");
+  r_shader shader = 0;
+
+  if (vert && frag) {
+    shader = r_shader_create(vert->data, frag->data);
+  }
+
+  if (vert) {
+    asset_free(vert);
+  }
+
+  if (frag) {
+    asset_free(frag);
+  }
+
+  return shader;
+}
+
+// The transform feedback shader that advances GPU particles
+static r_shader bench_update_shader(const char* dir) {
+  asset_t*    vert        = bench_asset(dir, "shaders/particles_gpu.vert");
+  const char* varyings[2] = {"out_motion", "out_life"};
+  r_shader    shader      = 0;
+
+  if (vert) {
+    shader = r_shader_create_feedback(vert->data, varyings, 2);
+    asset_free(vert);
+  }
+
+  return shader;
+}
+
+// The shader that draws GPU particles
+static r_shader bench_draw_shader(const char* dir) {
+  asset_t* vert   = bench_asset(dir, "shaders/particles_gpu_draw.vert");
+  asset_t* frag   = bench_asset(dir, "shaders/particles.frag");
+  r_shader shader = 0;
+
+  if (vert && frag) {
+    shader = r_shader_create(vert->data, frag->data);
+  }
+
+  if (vert) {
+    asset_free(vert);
+  }
+
+  if (frag) {
+    asset_free(frag);
+  }
+
+  return shader;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("Usage: ./particlebench frames resources\n");
+    printf("Ex: ./particlebench 300 examples/resources\n");
+    return 0;
+  }
+
+  int frames = atoi(argv[1]);
+
+  if (frames <= 0) {
+    printf("Invalid frame count: %s\n", argv[1]);
+    return 1;
+  }
+
+  r_window_params params =
+      r_window_params_create(1280, 720, 0, 0, 0, 0, 60, "Particle Bench");
+  r_ctx* ctx = r_ctx_create(params, 1, 32, 4, 1);
+
+  if (!ctx) {
+    printf("Render context failed.\n");
+    return 1;
+  }
+
+  r_ctx_make_current(ctx);
+
+  r_shader shader     = bench_shader(argv[2]);
+  r_shader gpu_update = bench_update_shader(argv[2]);
+  r_shader gpu_draw   = bench_draw_shader(argv[2]);
+
+  if (!shader || !gpu_update || !gpu_draw) {
+    r_ctx_destroy(ctx);
+    return 1;
+  }
+
+  // Percent of the capacity alive once the emitter settles
+  uint32_t fills[]    = {1, 10, 25, 50, 75, 100};
+  uint32_t fill_count = sizeof(fills) / sizeof(uint32_t);
+
+  // Wider than the camera, so some of the particles are culled
+  vec2 size          = {2560.f, 720.f};
+  vec2 particle_size = {4.f, 4.f};
+  vec2 velocity      = {0.01f, 0.02f};
+  vec4 color         = {1.f, 1.f, 1.f, 1.f};
+
+  printf("%u particle capacity, %i frames per fill\n", BENCH_CAPACITY,
+         frames);
+  printf("%-8s %10s %10s %10s %10s %10s\n", "fill", "live", "update ms",
+         "draw ms", "gpu update", "gpu draw");
+
+  for (uint32_t f = 0; f < fill_count; ++f) {
+    uint32_t    rate      = BENCH_CAPACITY / 100 * fills[f];
+    r_particles particles = r_particles_create(
+        rate, BENCH_LIFE, BENCH_CAPACITY, 0, PARTICLE_COLORED, 1,
+        BENCH_UNIFORMS);
+
+    r_particles_set_size(&particles, size);
+    r_particles_set_particle(&particles, color, BENCH_LIFE, particle_size,
+                             velocity);
+    r_particles_start(&particles);
+
+    // Run a lifetime first so spawning & dying have evened out
+    for (uint32_t i = 0; i <= (uint32_t)BENCH_LIFE / BENCH_DELTA; ++i) {
+      r_particles_update(&particles, BENCH_DELTA);
+    }
+
+    time_s   update = 0.0, draw = 0.0;
+    uint64_t live   = 0;
+
+    for (int frame = 0; frame < frames; ++frame) {
+      r_window_clear();
+      r_ctx_update(ctx);
+
+      time_s start = s_get_time();
+      r_particles_update(&particles, BENCH_DELTA);
+      time_s updated = s_get_time();
+      r_particles_draw(ctx, &particles, shader);
+      time_s drawn = s_get_time();
+
+      update += updated - start;
+      draw += drawn - updated;
+      live += particles.count;
+
+      r_window_swap_buffers(ctx);
+    }
+
+    // The same emitter on the GPU, only its spawn settings are used
+    r_particles spawner = r_particles_create(
+        rate, BENCH_LIFE, 1, 0, PARTICLE_COLORED, 0, 0);
+
+    r_particles_set_size(&spawner, size);
+    r_particles_set_particle(&spawner, color, BENCH_LIFE, particle_size,
+                             velocity);
+    r_particles_start(&spawner);
+
+    r_particles_gpu gpu =
+        r_particles_gpu_create(ctx, &spawner, gpu_update, BENCH_CAPACITY);
+
+    for (uint32_t i = 0; i <= (uint32_t)BENCH_LIFE / BENCH_DELTA; ++i) {
+      r_particles_gpu_update(ctx, &gpu, BENCH_DELTA);
+    }
+
+    time_s gpu_update_time = 0.0, gpu_draw_time = 0.0;
+
+    for (int frame = 0; frame < frames; ++frame) {
+      r_window_clear();
+      r_ctx_update(ctx);
+
+      time_s start = s_get_time();
+      r_particles_gpu_update(ctx, &gpu, BENCH_DELTA);
+      time_s updated = s_get_time();
+      r_particles_gpu_draw(ctx, &gpu, gpu_draw);
+      time_s drawn = s_get_time();
+
+      gpu_update_time += updated - start;
+      gpu_draw_time += drawn - updated;
+
+      r_window_swap_buffers(ctx);
+    }
+
+    printf("%-7u%% %10llu %10.3f %10.3f %10.3f %10.3f\n", fills[f],
+           (unsigned long long)(live / (uint64_t)frames),
+           (double)update / frames, (double)draw / frames,
+           (double)gpu_update_time / frames, (double)gpu_draw_time / frames);
+
+    r_particles_gpu_destroy(&gpu);
+    r_particles_destroy(&spawner);
+    r_particles_destroy(&particles);
+  }
+
+  r_ctx_destroy(ctx);
+
+  return 0;
+}
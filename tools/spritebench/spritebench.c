@@ -0,0 +1,159 @@
+// Time sprite preparation (update, cull & queue) against worker thread counts
+// usage:
+// spritebench frames resources
+// Ex: spritebench 300 examples/resources
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <astera/asset.h>
+#include <astera/render.h>
+#include <astera/sys.h>
+
+#define BENCH_SPRITES 100000
+#define BENCH_WIDTH   400
+#define BENCH_BATCH   8192
+
+// Load a file from the resources directory
+static asset_t* bench_asset(const char* dir, const char* file) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", dir, file);
+
+  asset_t* asset = asset_get(path);
+  if (!asset) {
+    printf("Unable to load %s\n", path);
+  }
+
+  return asset;
+}
+
+static r_shader bench_shader(const char* dir) {
+  asset_t* vert   = bench_asset(dir, "shaders/batch_packed.vert");
+  asset_t* frag   = bench_asset(dir, "shaders/instanced.frag");
+  r_shader shader = 0;
+
+  if (vert && frag) {
+    shader = r_shader_create(vert->data, frag->data);
+  }
+
+  if (vert) {
+    asset_free(vert);
+  }
+
+  if (frag) {
+    asset_free(frag);
+  }
+
+  return shader;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("Usage: ./spritebench frames resources\n");
+    printf("Ex: ./spritebench 300 examples/resources\n");
+    return 0;
+  }
+
+  int frames = atoi(argv[1]);
+
+  if (frames <= 0) {
+    printf("Invalid frame count: %s\n", argv[1]);
+    return 1;
+  }
+
+  r_window_params params =
+      r_window_params_create(1280, 720, 0, 0, 0, 0, 60, "Sprite Bench");
+  r_ctx* ctx = r_ctx_create(params, 1, BENCH_BATCH, 4, 1);
+
+  if (!ctx) {
+    printf("Render context failed.\n");
+    return 1;
+  }
+
+  r_ctx_make_current(ctx);
+
+  r_shader shader     = bench_shader(argv[2]);
+  asset_t* sheet_data = bench_asset(argv[2], "textures/spritesheet.png");
+
+  if (!shader || !sheet_data) {
+    if (sheet_data) {
+      asset_free(sheet_data);
+    }
+
+    r_ctx_destroy(ctx);
+    return 1;
+  }
+
+  r_shader_cache(ctx, shader, "bench");
+
+  r_sheet sheet = r_sheet_create_tiled(sheet_data->data,
+                                       sheet_data->data_length, 16, 16, 0, 0);
+  asset_free(sheet_data);
+
+  uint32_t anim_frames[6] = {7, 8, 9, 10, 11, 12};
+  r_anim   anim           = r_anim_create_fixed(&sheet, anim_frames, 6, 18);
+  anim.loop               = 1;
+
+  // A grid larger than the camera, so some of the sprites are culled
+  r_sprite* sprites = (r_sprite*)calloc(BENCH_SPRITES, sizeof(r_sprite));
+  vec2      size    = {4.f, 4.f};
+
+  for (uint32_t i = 0; i < BENCH_SPRITES; ++i) {
+    vec2 pos = {4.f * (i % BENCH_WIDTH), 4.f * (i / BENCH_WIDTH)};
+
+    sprites[i]       = r_sprite_create(shader, pos, size);
+    sprites[i].layer = (uint8_t)(i % 4);
+
+    if (i % 2) {
+      r_sprite_set_anim(&sprites[i], &anim);
+      r_sprite_anim_play(&sprites[i]);
+    } else {
+      r_sprite_set_tex(&sprites[i], &sheet, i % 6);
+    }
+  }
+
+  uint32_t cpus = s_cpu_count();
+
+  printf("%u sprites, %i frames per run (threads includes the caller)\n",
+         BENCH_SPRITES, frames);
+  printf("%-8s %10s %10s %10s %10s\n", "threads", "update ms", "queue ms",
+         "prep ms", "draw ms");
+
+  // The calling thread prepares sprites as well, so stop at cpus - 1 workers
+  for (uint32_t threads = 0; threads < cpus; ++threads) {
+    if (!r_ctx_set_threads(ctx, threads)) {
+      break;
+    }
+
+    time_s update = 0.0, queue = 0.0, draw = 0.0;
+
+    for (int frame = 0; frame < frames; ++frame) {
+      r_window_clear();
+      r_ctx_update(ctx);
+
+      time_s start = s_get_time();
+      r_sprites_update(ctx, sprites, BENCH_SPRITES, 16);
+      time_s updated = s_get_time();
+      r_sprites_draw(ctx, sprites, BENCH_SPRITES);
+      time_s queued = s_get_time();
+      r_ctx_draw(ctx);
+      time_s drawn = s_get_time();
+
+      update += updated - start;
+      queue += queued - updated;
+      draw += drawn - queued;
+
+      r_window_swap_buffers(ctx);
+    }
+
+    printf("%-8u %10.3f %10.3f %10.3f %10.3f\n", threads + 1,
+           (double)update / frames, (double)queue / frames,
+           (double)(update + queue) / frames, (double)draw / frames);
+  }
+
+  free(sprites);
+  r_sheet_destroy(&sheet);
+  r_ctx_destroy(ctx);
+
+  return 0;
+}